@@ -24,6 +24,9 @@
 //  - It is intended to be connected to an LM32 verilog core
 //  - It supports segmented traces
 //  - Memory footprint is minimal
+//  - Trace can be formatted and written by a background thread
+//    (needs "trace_writer.h" and "trace_common.h" from ring_buffer)
+//  - Disassembly is done only for the text trace, and cached
 //
 // TODO:
 //  - Add support to custom instructions
@@ -33,6 +36,9 @@
 #include <stdlib.h>
 #include <stdio.h>
 
+// Disassembly cache entries (log2)
+#define DAC_LOG2     (10)
+
 enum
 {
     OP_SRUI = 0, // 0x00, I-Type : srui    rY,rX,#uimm5
@@ -193,6 +199,10 @@ LM32Trace::LM32Trace(vluint32_t reset_vect, vluint32_t except_base)
     // File handle set to STDOUT
     tname[0]    = (char)0;
     tfh         = stdout;
+    // No writer thread
+    twr         = (TraceWriter *)NULL;
+    async_on    = false;
+    cur_stamp   = (vluint64_t)0;
     // Internal variables cleared
     dasm_buf[0] = (char)0;
     prev_clk    = (vluint8_t)0;
@@ -205,11 +215,50 @@ LM32Trace::LM32Trace(vluint32_t reset_vect, vluint32_t except_base)
     ip_reg      = (vluint32_t)0;
     eba_reg     = except_base & 0xFFFFFF00;
     cc_reg      = (vluint32_t)4;
+    // Disassembly cache cleared
+    dac         = new TraceDasm<LM32Trace>(this, &LM32Trace::lm32_dasm, DAC_LOG2);
 }
 
 // Destructor
 LM32Trace::~LM32Trace()
 {
+    this->close();
+    
+    if (twr)
+    {
+        delete twr;
+        twr = (TraceWriter *)NULL;
+    }
+    delete dac;
+}
+
+// Format and write the trace on a background thread (before open)
+// buf_log2 : records buffer size (log2, 0 : no thread), policy : TRACE_WR_xxx
+// Mismatches are never dropped : with TRACE_WR_DROP, only fetch / memory
+// records are lost when the buffer is full
+int LM32Trace::setAsync(int buf_log2, int policy)
+{
+    // Trace file already open
+    if (tfh != stdout) return -1;
+
+    if (twr)
+    {
+        delete twr;
+        twr = (TraceWriter *)NULL;
+    }
+    if (buf_log2)
+    {
+        if (buf_log2 < 12) buf_log2 = 12;
+        twr = new TraceWriter(buf_log2, policy, &LM32Trace::async_fmt, (void *)this);
+    }
+    
+    return 0;
+}
+
+// Writer thread counters : records, dropped records, full buffer waits
+void LM32Trace::getAsyncStats(vluint64_t &records, vluint64_t &drops, vluint64_t &stalls)
+{
+    trace_get_stats(twr, records, drops, stalls);
 }
 
 // Open trace file
@@ -230,6 +279,7 @@ int LM32Trace::open(const char *name)
     {
         // Success
         tfh = fh;
+        if (twr) twr->start(tfh);
         return 0;
     }
     else
@@ -286,6 +336,7 @@ int LM32Trace::openNext(void)
     {
         // Success
         tfh = fh;
+        if (twr) twr->start(tfh);
         return 0;
     }
     else
@@ -301,6 +352,7 @@ void LM32Trace::close(void)
 {
     if (tfh != stdout)
     {
+        if (twr) twr->stop();
         fclose(tfh);
         tfh = stdout;
     }
@@ -334,67 +386,39 @@ void LM32Trace::dump
     // Rising edge on clock
     if (clk && !prev_clk)
     {
+        // Text formatted by the writer thread
+        async_on  = (twr) && (twr->is_on());
+        cur_stamp = stamp;
+        
         ip_reg = ip_reg | inr_ir_irq & im_reg;
         if (wb_ena)
         {
             if (wb_idx != reg_wb)
             {
-                fprintf(tfh, "!!! WRITEBACK INDEX MISMATCH !!!\n");
-                fprintf(tfh, "Verilog : %2d, C-Model : %2d\n", wb_idx, reg_wb);
+                mismatch(TRACE_MISM_WB_IDX, wb_idx, reg_wb);
             }
             else if (gp_regs[reg_wb] != wb_data)
             {
-                fprintf(tfh, "!!! WRITEBACK DATA MISMATCH !!!\n");
-                fprintf(tfh, "Verilog : %08X, C-Model : %08X\n", wb_data, gp_regs[reg_wb]);
+                mismatch(TRACE_MISM_WB_DATA, wb_data, gp_regs[reg_wb]);
             }
         }
         if (d_rd_ack)
         {
-            fprintf(tfh, "Memory read @ $%08X : %08X\n", d_address, d_rddata);
+            trace_mem(TRACE_REC_MEM_RD, d_address, d_rddata, 0);
             
             // Instruction simulation (memory/writeback)
             lm32_simu_rd(d_address, d_rddata);
         }
         if (d_wr_ack)
         {
-            char buf[10];
-            
-            memcpy(buf + 6, (d_byteena & 1) ? uhex_to_str(d_wrdata >>  0, 2) : "$XX", 3);
-            memcpy(buf + 4, (d_byteena & 2) ? uhex_to_str(d_wrdata >>  8, 2) : "$XX", 3);
-            memcpy(buf + 2, (d_byteena & 4) ? uhex_to_str(d_wrdata >> 16, 2) : "$XX", 3);
-            memcpy(buf + 0, (d_byteena & 8) ? uhex_to_str(d_wrdata >> 24, 2) : "$XX", 3);
-            buf[9] = (char)0;
-            
-            fprintf(tfh, "Memory write @ $%08X : %s\n", d_address, buf);
+            trace_mem(TRACE_REC_MEM_WR, d_address, d_wrdata, d_byteena);
             
             // Instruction simulation (memory)
             lm32_simu_wr(d_address, d_wrdata, d_byteena);
         }
         if (i_rd_ack)
         {
-            char buf[80];
-            
-            // CPU registers
-            fprintf(tfh, "R0 =%08X %08X %08X %08X %08X %08X %08X %08X\n",
-                    gp_regs[ 0], gp_regs[ 1], gp_regs[ 2], gp_regs[ 3],
-                    gp_regs[ 4], gp_regs[ 5], gp_regs[ 6], gp_regs[ 7]
-                   );
-            fprintf(tfh, "R8 =%08X %08X %08X %08X %08X %08X %08X %08X\n",
-                    gp_regs[ 8], gp_regs[ 9], gp_regs[10], gp_regs[11],
-                    gp_regs[12], gp_regs[13], gp_regs[14], gp_regs[15]
-                   );
-            fprintf(tfh, "R16=%08X %08X %08X %08X %08X %08X %08X %08X\n",
-                    gp_regs[16], gp_regs[17], gp_regs[18], gp_regs[19],
-                    gp_regs[20], gp_regs[21], gp_regs[22], gp_regs[23]
-                   );
-            fprintf(tfh, "R24=%08X %08X %08X %08X %08X %08X %08X %08X\n\n",
-                    gp_regs[24], gp_regs[25], gp_regs[26], gp_regs[27],
-                    gp_regs[28], gp_regs[29], gp_regs[30], gp_regs[31]
-                   );
-                   
-            // Disassemble instruction being fetched
-            lm32_dasm(buf, i_rddata, pc_reg);
-            fprintf(tfh, "(%14llu ps) %08X : %08X %s\n", stamp, i_address, i_rddata, buf);
+            trace_fetch(i_address, i_rddata);
             
             // Instruction simulation (fetch/decode/execute/writeback)
             lm32_simu_if(i_address, i_rddata);
@@ -403,6 +427,105 @@ void LM32Trace::dump
     prev_clk = clk;
 }
 
+// Trace an instruction fetch
+void LM32Trace::trace_fetch(vluint32_t i_address, vluint32_t i_rddata)
+{
+    if (async_on)
+    {
+        trace_put_fetch(twr, cur_stamp, i_address, i_rddata, pc_reg, gp_regs);
+    }
+    else
+    {
+        print_fetch(tfh, cur_stamp, i_address, i_rddata, pc_reg, gp_regs);
+    }
+}
+
+// Trace a memory read or write
+void LM32Trace::trace_mem(int type, vluint32_t addr, vluint32_t data, vluint8_t mask)
+{
+    if (async_on)
+    {
+        trace_put_mem(twr, type, addr, data, mask);
+    }
+    else
+    {
+        trace_print_mem(tfh, type, addr, data, mask);
+    }
+}
+
+// Trace / simulation mismatch, everything up to it is on the disk
+void LM32Trace::mismatch(int kind, vluint32_t v_val, vluint32_t c_val)
+{
+    if (async_on)
+    {
+        trace_put_mism(twr, kind, v_val, c_val);
+        twr->flush();
+    }
+    else
+    {
+        trace_print_mism(tfh, kind, v_val, c_val);
+        fflush(tfh);
+    }
+}
+
+// Text trace : registers and disassembled instruction
+void LM32Trace::print_fetch(FILE *fh, vluint64_t stamp, vluint32_t i_address, vluint32_t i_rddata,
+                            vluint32_t pc, const vluint32_t *regs)
+{
+    char buf[80];
+    
+    // CPU registers
+    fprintf(fh, "R0 =%08X %08X %08X %08X %08X %08X %08X %08X\n",
+            regs[ 0], regs[ 1], regs[ 2], regs[ 3],
+            regs[ 4], regs[ 5], regs[ 6], regs[ 7]
+           );
+    fprintf(fh, "R8 =%08X %08X %08X %08X %08X %08X %08X %08X\n",
+            regs[ 8], regs[ 9], regs[10], regs[11],
+            regs[12], regs[13], regs[14], regs[15]
+           );
+    fprintf(fh, "R16=%08X %08X %08X %08X %08X %08X %08X %08X\n",
+            regs[16], regs[17], regs[18], regs[19],
+            regs[20], regs[21], regs[22], regs[23]
+           );
+    fprintf(fh, "R24=%08X %08X %08X %08X %08X %08X %08X %08X\n\n",
+            regs[24], regs[25], regs[26], regs[27],
+            regs[28], regs[29], regs[30], regs[31]
+           );
+           
+    // Disassemble instruction being fetched
+    fprintf(fh, "(%14llu ps) %08X : %08X %s\n", stamp, i_address, i_rddata, dac->get(buf, i_rddata, pc));
+}
+
+// Writer thread : record formatting
+void LM32Trace::async_fmt(void *ctx, FILE *fh, int type, const vluint8_t *rec, int len)
+{
+    LM32Trace        *trc = (LM32Trace *)ctx;
+    const vluint32_t *val = (const vluint32_t *)rec;
+    
+    (void)len;
+    
+    switch (type)
+    {
+        case TRACE_REC_FETCH :
+        {
+            const trace_fetch_t *f = (const trace_fetch_t *)rec;
+            
+            trc->print_fetch(fh, f->stamp, f->addr, f->inst, f->pc, f->regs);
+            break;
+        }
+        case TRACE_REC_MEM_RD :
+        case TRACE_REC_MEM_WR :
+        {
+            trace_print_mem(fh, type, val[0], val[1], (vluint8_t)val[2]);
+            break;
+        }
+        default :
+        {
+            trace_print_mism(fh, (int)val[0], val[1], val[2]);
+        }
+    }
+}
+
 // Disassemble one instruction
 char LM32Trace::disasm(vluint32_t inst, vluint32_t pc, int idx)
 {
@@ -424,7 +547,7 @@ char LM32Trace::disasm(vluint32_t inst, vluint32_t pc, int idx)
 
 char *LM32Trace::uhex_to_str(vluint32_t val, int dig)
 {
-    static char buf[12];
+    static thread_local char buf[12];
     char *p;
     
     dig <<= 2;
@@ -452,7 +575,7 @@ char *LM32Trace::uhex_to_str(vluint32_t val, int dig)
 
 char *LM32Trace::shex_to_str(vluint32_t val, int dig)
 {
-    static char buf[12];
+    static thread_local char buf[12];
     char *p;
     vluint32_t msk;
     
@@ -718,8 +841,7 @@ void LM32Trace::lm32_simu_if(vluint32_t addr, vluint32_t inst)
     
     if (addr != pc_reg)
     {
-        fprintf(tfh, "!!! INST ADDRESS MISMATCH !!!\n");
-        fprintf(tfh, "Verilog : %08X, C-Model : %08X\n", addr, pc_reg);
+        mismatch(TRACE_MISM_INST_ADDR, addr, pc_reg);
     }
     
     opc    = (inst >> 26) & 0x3F;
@@ -1434,8 +1556,7 @@ void LM32Trace::lm32_simu_rd(vluint32_t addr, vluint32_t data)
 {
     if (addr != (mem_addr & 0xFFFFFFFC))
     {
-        fprintf(tfh, "!!! DATA ADDRESS MISMATCH !!!\n");
-        fprintf(tfh, "Verilog : %08X, C-Model : %08X\n", addr, (mem_addr & 0xFFFFFFFC));
+        mismatch(TRACE_MISM_DATA_ADDR, addr, (mem_addr & 0xFFFFFFFC));
     }
     
     switch (mem_xfer)
@@ -1501,7 +1622,7 @@ void LM32Trace::lm32_simu_rd(vluint32_t addr, vluint32_t data)
         }
         default:
         {
-            fprintf(tfh, "!!! DATA TRANSFER TYPE MISMATCH !!!\n");
+            mismatch(TRACE_MISM_DATA_TYPE, 0, 0);
         }
     }
     mem_xfer = XFER_NONE;
@@ -1512,20 +1633,17 @@ void LM32Trace::lm32_simu_wr(vluint32_t addr, vluint32_t data, vluint8_t mask)
     
     if (addr != (mem_addr & 0xFFFFFFFC))
     {
-        fprintf(tfh, "!!! DATA ADDRESS MISMATCH !!!\n");
-        fprintf(tfh, "Verilog : %08X, C-Model : %08X\n", addr, (mem_addr & 0xFFFFFFFC));
+        mismatch(TRACE_MISM_DATA_ADDR, addr, (mem_addr & 0xFFFFFFFC));
     }
     
     if (data != mem_data)
     {
-        fprintf(tfh, "!!! DATA VALUE MISMATCH !!!\n");
-        fprintf(tfh, "Verilog : %08X, C-Model : %08X\n", data, mem_data);
+        mismatch(TRACE_MISM_DATA_VAL, data, mem_data);
     }
     
     if (mask != mem_mask)
     {
-        fprintf(tfh, "!!! DATA MASK MISMATCH !!!\n");
-        fprintf(tfh, "Verilog : %1X, C-Model : %1X\n", mask, mem_mask);
+        mismatch(TRACE_MISM_DATA_MASK, mask, mem_mask);
     }
     mem_xfer = XFER_NONE;
 }
\ No newline at end of file
@@ -24,6 +24,9 @@
 //  - It is intended to be connected to an LM32 verilog core
 //  - It supports segmented traces
 //  - Memory footprint is minimal
+//  - Trace can be formatted and written by a background thread
+//    (needs "trace_writer.h" and "trace_common.h" from ring_buffer)
+//  - Disassembly is done only for the text trace, and cached
 //
 // TODO:
 //  - Add support to custom instructions
@@ -32,6 +35,7 @@
 #define _LM32_TRACE_H_
 
 #include "verilated.h"
+#include "trace_common.h"
 #include <stdlib.h>
 #include <stdio.h>
 
@@ -45,6 +49,8 @@ class LM32Trace
         int  open(const char *name);
         int  openNext(void);
         void close(void);
+        int  setAsync(int buf_log2, int policy);
+        void getAsyncStats(vluint64_t &records, vluint64_t &drops, vluint64_t &stalls);
         void dump(vluint64_t stamp,     vluint8_t  clk,
                   vluint8_t  i_rd_ack,  vluint32_t i_address, vluint32_t i_rddata,
                   vluint8_t  d_rd_ack,  vluint8_t  d_wr_ack,  vluint32_t d_address,
@@ -56,8 +62,18 @@ class LM32Trace
         // Utility functions
         char       *uhex_to_str(vluint32_t val, int dig);
         char       *shex_to_str(vluint32_t val, int dig);
+        // Trace / simulation mismatch
+        void        mismatch(int kind, vluint32_t v_val, vluint32_t c_val);
+        // Trace records (text or writer thread)
+        void        trace_fetch(vluint32_t i_address, vluint32_t i_rddata);
+        void        trace_mem(int type, vluint32_t addr, vluint32_t data, vluint8_t mask);
+        // Text trace
+        void        print_fetch(FILE *fh, vluint64_t stamp, vluint32_t i_address, vluint32_t i_rddata,
+                                vluint32_t pc, const vluint32_t *regs);
+        static void async_fmt(void *ctx, FILE *fh, int type, const vluint8_t *rec, int len);
         // Mico32 disassembler
         void        lm32_dasm(char *buf, vluint32_t inst, vluint32_t pc);
+        TraceDasm<LM32Trace> *dac;
         // Mico32 simulator
         void        lm32_simu_if(vluint32_t addr, vluint32_t inst);
         void        lm32_simu_rd(vluint32_t addr, vluint32_t data);
@@ -79,6 +95,10 @@ class LM32Trace
         // Trace file handle
         char        tname[256];
         FILE       *tfh;
+        // Writer thread
+        TraceWriter *twr;
+        bool        async_on;
+        vluint64_t  cur_stamp;
         // Previous clock state
         vluint8_t   prev_clk;
         // Register writeback
@@ -0,0 +1,214 @@
+// Copyright 2019-2023 Frederic Requin
+//
+// License: BSD
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//   - Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//   - Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer
+//     in the documentation and/or other materials provided with the
+//     distribution.
+//   - Neither the name of the author nor the names of its contributors
+//     may be used to endorse or promote products derived from this
+//     software without specific prior written permission.
+//
+// CPU traces common parts:
+// ------------------------
+//  - Used by the RISC-V and LM32 traces
+//  - Mismatch kinds and messages
+//  - Writer thread records (see trace_writer.h) and their text format
+//  - Disassembly cache for the text traces
+
+#ifndef _TRACE_COMMON_H_
+#define _TRACE_COMMON_H_
+
+#include "verilated.h"
+#include "trace_writer.h"
+#include <stdio.h>
+#include <string.h>
+
+// Writer thread records (same values as the RISC-V binary trace records)
+#define TRACE_REC_FETCH     (0)      // Instruction fetch + registers
+#define TRACE_REC_MEM_RD    (1)      // Memory read
+#define TRACE_REC_MEM_WR    (2)      // Memory write
+#define TRACE_REC_MISM      (3)      // Trace / simulation mismatch
+
+// Mismatch kinds
+#define TRACE_MISM_WB_IDX    (0)
+#define TRACE_MISM_WB_DATA   (1)
+#define TRACE_MISM_INST_ADDR (2)
+#define TRACE_MISM_DATA_ADDR (3)
+#define TRACE_MISM_DATA_TYPE (4)
+#define TRACE_MISM_DATA_VAL  (5)
+#define TRACE_MISM_DATA_MASK (6)
+
+// Mismatch messages, values format : NULL = none
+static const struct
+{
+    const char *title;
+    const char *fmt;
+} trace_mism_str[7] =
+{
+    { "!!! WRITEBACK INDEX MISMATCH !!!\n",    "Verilog : %2d, C-Model : %2d\n"     },
+    { "!!! WRITEBACK DATA MISMATCH !!!\n",     "Verilog : %08X, C-Model : %08X\n"   },
+    { "!!! INST ADDRESS MISMATCH !!!\n",       "Verilog : %08X, C-Model : %08X\n"   },
+    { "!!! DATA ADDRESS MISMATCH !!!\n",       "Verilog : %08X, C-Model : %08X\n"   },
+    { "!!! DATA TRANSFER TYPE MISMATCH !!!\n", NULL                                 },
+    { "!!! DATA VALUE MISMATCH !!!\n",         "Verilog : %08X, C-Model : %08X\n"   },
+    { "!!! DATA MASK MISMATCH !!!\n",          "Verilog : %1X, C-Model : %1X\n"     }
+};
+
+// Writer thread record : instruction fetch
+typedef struct
+{
+    vluint64_t stamp;
+    vluint32_t addr;
+    vluint32_t inst;
+    vluint32_t pc;
+    vluint32_t regs[32];
+} trace_fetch_t;
+
+// Writer thread : instruction fetch record (dropped when the FIFO is full)
+static inline void trace_put_fetch(TraceWriter *twr, vluint64_t stamp, vluint32_t addr, vluint32_t inst,
+                                   vluint32_t pc, const vluint32_t *regs)
+{
+    trace_fetch_t *rec = (trace_fetch_t *)twr->alloc(TRACE_REC_FETCH, sizeof(trace_fetch_t));
+
+    if (rec)
+    {
+        rec->stamp = stamp;
+        rec->addr  = addr;
+        rec->inst  = inst;
+        rec->pc    = pc;
+        memcpy((void *)rec->regs, (const void *)regs, sizeof(rec->regs));
+        twr->commit();
+    }
+}
+
+// Writer thread : memory read or write record (dropped when the FIFO is full)
+static inline void trace_put_mem(TraceWriter *twr, int type, vluint32_t addr, vluint32_t data, vluint8_t mask)
+{
+    vluint32_t *rec = (vluint32_t *)twr->alloc(type, 12);
+
+    if (rec)
+    {
+        rec[0] = addr;
+        rec[1] = data;
+        rec[2] = mask;
+        twr->commit();
+    }
+}
+
+// Writer thread : mismatch record (never dropped)
+static inline void trace_put_mism(TraceWriter *twr, int kind, vluint32_t v_val, vluint32_t c_val)
+{
+    vluint32_t *rec = (vluint32_t *)twr->alloc(TRACE_REC_MISM, 12, true);
+
+    rec[0] = (vluint32_t)kind;
+    rec[1] = v_val;
+    rec[2] = c_val;
+    twr->commit();
+}
+
+// Writer thread counters : records, dropped records, full buffer waits
+static inline void trace_get_stats(TraceWriter *twr, vluint64_t &records, vluint64_t &drops, vluint64_t &stalls)
+{
+    records = (twr) ? twr->get_records() : 0;
+    drops   = (twr) ? twr->get_drops()   : 0;
+    stalls  = (twr) ? twr->get_stalls()  : 0;
+}
+
+// Text trace : memory read or write (unwritten bytes shown as "XX")
+static inline void trace_print_mem(FILE *fh, int type, vluint32_t addr, vluint32_t data, vluint8_t mask)
+{
+    static const char hex[] = "0123456789ABCDEF";
+
+    if (type == TRACE_REC_MEM_RD)
+    {
+        fprintf(fh, "Memory read @ $%08X : %08X\n", addr, data);
+    }
+    else
+    {
+        char buf[10];
+
+        // "$HH" per byte, LSB first : each one overlaps the '$' of the previous one
+        for (int i = 0; i < 4; i++)
+        {
+            char *p = buf + 6 - (i << 1);
+
+            p[0] = '$';
+            p[1] = (mask & (1 << i)) ? hex[(data >> (i * 8 + 4)) & 15] : 'X';
+            p[2] = (mask & (1 << i)) ? hex[(data >> (i * 8))     & 15] : 'X';
+        }
+        buf[9] = (char)0;
+
+        fprintf(fh, "Memory write @ $%08X : %s\n", addr, buf);
+    }
+}
+
+// Text trace : mismatch
+static inline void trace_print_mism(FILE *fh, int kind, vluint32_t v_val, vluint32_t c_val)
+{
+    fputs(trace_mism_str[kind].title, fh);
+    if (trace_mism_str[kind].fmt) fprintf(fh, trace_mism_str[kind].fmt, v_val, c_val);
+}
+
+// Disassembly cache for the text traces : loops fetch the same words again and again
+// (direct mapped on the PC, keyed by PC and word : branch targets depend on the PC)
+template <class T> class TraceDasm
+{
+    public:
+        // Disassembler : T member function
+        typedef void (T::*dasm_t)(char *buf, vluint32_t inst, vluint32_t pc);
+        // Constructor and destructor (log2 : number of entries)
+        TraceDasm(T *obj, dasm_t fn, int log2) :
+            m_obj  { obj },
+            m_fn   { fn },
+            m_mask { ((vluint32_t)1 << log2) - 1 }
+        {
+            m_ent = new ent_t[m_mask + 1];
+            for (vluint32_t i = 0; i <= m_mask; i++)
+            {
+                m_ent[i].pc = FREE_PC;
+            }
+        }
+        ~TraceDasm()
+        {
+            delete [] m_ent;
+        }
+        // Disassembled instruction, "buf" holds a text too long to be cached
+        const char *get(char *buf, vluint32_t inst, vluint32_t pc)
+        {
+            ent_t *ent = &m_ent[(pc >> 2) & m_mask];
+
+            if ((ent->pc == pc) && (ent->inst == inst)) return ent->text;
+
+            (m_obj->*m_fn)(buf, inst, pc);
+            if (strlen(buf) < sizeof(ent->text))
+            {
+                strcpy(ent->text, buf);
+                ent->pc   = pc;
+                ent->inst = inst;
+            }
+
+            return buf;
+        }
+    private:
+        // Free entry (not a valid fetch address)
+        static const vluint32_t FREE_PC = 0xFFFFFFFF;
+        typedef struct
+        {
+            vluint32_t pc;
+            vluint32_t inst;
+            char       text[56];
+        } ent_t;
+        T         *m_obj;
+        dasm_t     m_fn;
+        vluint32_t m_mask;
+        ent_t     *m_ent;
+};
+
+#endif /* _TRACE_COMMON_H_ */
@@ -0,0 +1,246 @@
+// Copyright 2019-2023 Frederic Requin
+//
+// License: BSD
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions 
+// are met:
+//   - Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//   - Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer 
+//     in the documentation and/or other materials provided with the 
+//     distribution.
+//   - Neither the name of the author nor the names of its contributors 
+//     may be used to endorse or promote products derived from this 
+//     software without specific prior written permission.
+//
+// Trace writer:
+// -------------
+//  - Single producer / single consumer byte FIFO, lock-free (std::atomic)
+//  - Variable size records, formatted and written by a background thread
+//  - Output goes through a large stdio buffer : written in big blocks
+//  - Full FIFO policy : the simulation waits, or the records are dropped
+//    (records flagged as "keep" always wait)
+//  - Flush : waits until every pending record is formatted and on the disk
+//  - Buffer size is a power of 2, memory footprint is bounded
+
+#ifndef _TRACE_WRITER_H_
+#define _TRACE_WRITER_H_
+
+#include "verilated.h"
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+// Full FIFO policy
+#define TRACE_WR_BLOCK (0)   // Simulation waits for the writer thread
+#define TRACE_WR_DROP  (1)   // New records are dropped (and counted)
+
+// Record formatting, called by the writer thread
+typedef void (*trace_fmt_t)(void *ctx, FILE *fh, int type, const vluint8_t *rec, int len);
+
+class TraceWriter
+{
+    public:
+        // Constructor
+        TraceWriter(int log2, int policy, trace_fmt_t fmt, void *ctx) :
+            m_size   { (vluint64_t)1 << (log2 & 63) },
+            m_policy { policy },
+            m_fmt    { fmt },
+            m_ctx    { ctx },
+            m_fh     { (FILE *)NULL },
+            m_thr    { (std::thread *)NULL }
+        {
+            m_array = new vluint8_t[m_size];
+            m_fbuf  = new char[FILE_BUF_LEN];
+            m_wr    = 0;
+            m_rd    = 0;
+            m_rd_lc = 0;
+            m_next  = 0;
+            m_stop  = false;
+            m_f_req = 0;
+            m_f_ack = 0;
+            m_recs  = 0;
+            m_drops = 0;
+            m_stall = 0;
+        }
+        // Destructor
+        ~TraceWriter()
+        {
+            stop();
+            delete [] m_array;
+            delete [] m_fbuf;
+        }
+        // Start the writer thread on an open file
+        void start(FILE *fh)
+        {
+            stop();
+            setvbuf(fh, m_fbuf, _IOFBF, FILE_BUF_LEN);
+            m_fh   = fh;
+            m_stop = false;
+            m_thr  = new std::thread(&TraceWriter::thread, this);
+        }
+        // Write the pending records and stop the writer thread
+        void stop(void)
+        {
+            if (!m_thr) return;
+
+            m_stop.store(true);
+            m_thr->join();
+            delete m_thr;
+            m_thr = (std::thread *)NULL;
+            fflush(m_fh);
+            m_fh  = (FILE *)NULL;
+        }
+        // Is the writer thread running ?
+        inline bool is_on(void)
+        {
+            return (m_thr != NULL);
+        }
+        // Reserve a record (NULL : dropped)
+        // keep : never dropped, waits for room even with the DROP policy
+        vluint8_t *alloc(int type, int len, bool keep = false)
+        {
+            vluint64_t wr   = m_wr.load(std::memory_order_relaxed);
+            vluint64_t pos  = wr & (m_size - 1);
+            vluint64_t need = (vluint64_t)(HDR_LEN + ((len + 7) & ~7));
+            vluint32_t *hdr;
+
+            // Record larger than the FIFO
+            if (need > m_size)
+            {
+                m_drops++;
+                return (vluint8_t *)NULL;
+            }
+            // Not enough room before the end : padding record, published
+            // on its own so that the record can wait for room at offset 0
+            if (pos + need > m_size)
+            {
+                if (!wait_room(wr, m_size - pos, keep)) return (vluint8_t *)NULL;
+                hdr    = (vluint32_t *)(m_array + pos);
+                hdr[0] = PAD_REC;
+                wr    += m_size - pos;
+                pos    = 0;
+                m_wr.store(wr, std::memory_order_release);
+            }
+            if (!wait_room(wr, need, keep)) return (vluint8_t *)NULL;
+
+            hdr     = (vluint32_t *)(m_array + pos);
+            hdr[0]  = (vluint32_t)len;
+            hdr[1]  = (vluint32_t)type;
+            m_next  = wr + need;
+            m_recs++;
+
+            return m_array + pos + HDR_LEN;
+        }
+        // Hand the reserved record over to the writer thread
+        inline void commit(void)
+        {
+            m_wr.store(m_next, std::memory_order_release);
+        }
+        // Wait until every committed record is written to the disk
+        void flush(void)
+        {
+            vluint64_t req;
+
+            if (!m_thr) return;
+
+            req = m_f_req.fetch_add(1) + 1;
+            while (m_f_ack.load(std::memory_order_acquire) < req)
+            {
+                std::this_thread::yield();
+            }
+        }
+        // Counters : records, dropped records, full FIFO waits
+        inline vluint64_t get_records(void) { return m_recs;  }
+        inline vluint64_t get_drops(void)   { return m_drops; }
+        inline vluint64_t get_stalls(void)  { return m_stall; }
+    private:
+        static const int        HDR_LEN      = 8;          // Length, type
+        static const vluint32_t PAD_REC      = 0xFFFFFFFF; // Skip to the buffer start
+        static const int        FILE_BUF_LEN = 1 << 20;    // stdio buffer
+        // Wait for, or drop when there is not enough room for len bytes at wr
+        bool wait_room(vluint64_t wr, vluint64_t len, bool keep)
+        {
+            while (wr + len - m_rd_lc > m_size)
+            {
+                m_rd_lc = m_rd.load(std::memory_order_acquire);
+                if (wr + len - m_rd_lc <= m_size) break;
+                if ((m_policy == TRACE_WR_DROP) && (!keep))
+                {
+                    m_drops++;
+                    return false;
+                }
+                m_stall++;
+                std::this_thread::yield();
+            }
+            return true;
+        }
+        // Writer thread
+        void thread(void)
+        {
+            vluint64_t rd = m_rd.load(std::memory_order_relaxed);
+
+            for (;;)
+            {
+                vluint64_t wr = m_wr.load(std::memory_order_acquire);
+
+                if (rd == wr)
+                {
+                    // Flush request : seen before the last records check
+                    vluint64_t req = m_f_req.load();
+                    bool       end = m_stop.load();
+
+                    if (rd != m_wr.load(std::memory_order_acquire)) continue;
+                    if (req != m_f_ack.load(std::memory_order_relaxed))
+                    {
+                        fflush(m_fh);
+                        m_f_ack.store(req, std::memory_order_release);
+                    }
+                    if (end) break;
+                    std::this_thread::sleep_for(std::chrono::microseconds(50));
+                    continue;
+                }
+                while (rd != wr)
+                {
+                    vluint64_t pos = rd & (m_size - 1);
+                    vluint32_t *hdr = (vluint32_t *)(m_array + pos);
+
+                    if (hdr[0] == PAD_REC)
+                    {
+                        rd += m_size - pos;
+                    }
+                    else
+                    {
+                        m_fmt(m_ctx, m_fh, (int)hdr[1], m_array + pos + HDR_LEN, (int)hdr[0]);
+                        rd += HDR_LEN + ((hdr[0] + 7) & ~7);
+                    }
+                    m_rd.store(rd, std::memory_order_release);
+                }
+            }
+        }
+        const vluint64_t         m_size;
+        const int                m_policy;
+        const trace_fmt_t        m_fmt;
+        void * const             m_ctx;
+        vluint8_t               *m_array;
+        char                    *m_fbuf;
+        FILE                    *m_fh;
+        std::thread             *m_thr;
+        // Producer side
+        std::atomic<vluint64_t>  m_wr;    // Committed write index
+        vluint64_t               m_rd_lc; // Last read index seen
+        vluint64_t               m_next;  // Write index after the reserved record
+        vluint64_t               m_recs;
+        vluint64_t               m_drops;
+        vluint64_t               m_stall;
+        // Consumer side
+        std::atomic<vluint64_t>  m_rd;    // Read index
+        std::atomic<bool>        m_stop;
+        std::atomic<vluint64_t>  m_f_req; // Flush requests
+        std::atomic<vluint64_t>  m_f_ack; // Flush done
+};
+
+#endif /* _TRACE_WRITER_H_ */
@@ -0,0 +1,117 @@
+// Copyright 2018-2022 Frederic Requin
+//
+// License: BSD
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions 
+// are met:
+//   - Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//   - Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer 
+//     in the documentation and/or other materials provided with the 
+//     distribution.
+//   - Neither the name of the author nor the names of its contributors 
+//     may be used to endorse or promote products derived from this 
+//     software without specific prior written permission.
+//
+// RISC-V binary trace format:
+// ---------------------------
+//  - One header followed by variable-size records, in host byte order
+//  - Written by the RISC-V trace (open with bin = true), read by "riscv_logdec"
+//  - Every field is delta-encoded against the previous record and stored as
+//    a LEB128 varint (signed deltas are zigzag-encoded)
+//  - Does not depend on Verilator, to be included by offline tools
+//
+// Record layout:
+//   tag (1 byte)      : bits 0-3 : record type, bits 4-7 : type specific
+//   ts delta (varint) : time elapsed since the previous record (ps)
+//   FETCH   : PC delta (zigzag, from previous PC + 4), instruction word,
+//             [model PC] when RISCV_LOG_DPC is set, then the registers that
+//             changed since the previous fetch : index (1 byte), XOR (varint)
+//             bits 4-6 of the tag hold the number of registers (7 : escape,
+//             the count follows as a varint)
+//   MEM_RD  : address delta (zigzag), data
+//   MEM_WR  : address delta (zigzag), data, bits 4-7 of the tag : byte enables
+//   MISM    : Verilog value, C-model value, bits 4-7 of the tag : mismatch kind
+
+#ifndef _RISCV_LOG_H_
+#define _RISCV_LOG_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define RISCV_LOG_MAGIC   (0x42545652) // "RVTB"
+#define RISCV_LOG_VERSION (1)
+
+// Record types (same values as TRACE_REC_xxx in trace_common.h)
+#define RISCV_LOG_FETCH   (0)          // Instruction fetch + registers
+#define RISCV_LOG_MEM_RD  (1)          // Memory read
+#define RISCV_LOG_MEM_WR  (2)          // Memory write
+#define RISCV_LOG_MISM    (3)          // Trace / simulation mismatch
+
+// Mismatch kinds (MISM), same values as TRACE_MISM_xxx in trace_common.h
+#define RISCV_MISM_WB_IDX    (0)
+#define RISCV_MISM_WB_DATA   (1)
+#define RISCV_MISM_INST_ADDR (2)
+#define RISCV_MISM_DATA_ADDR (3)
+#define RISCV_MISM_DATA_TYPE (4)
+#define RISCV_MISM_DATA_VAL  (5)
+#define RISCV_MISM_DATA_MASK (6)
+
+// Tag flags (FETCH)
+#define RISCV_LOG_DPC     (0x80)       // Model PC differs from fetch address
+#define RISCV_LOG_REGS_ESC (7)         // Register count follows as a varint
+
+// Largest record : tag, ts, PC, inst, model PC, count, 32 x (index, XOR)
+#define RISCV_LOG_REC_MAX (1 + 10 + 5 + 5 + 5 + 1 + 32 * 6)
+
+typedef struct
+{
+    uint32_t magic;     // RISCV_LOG_MAGIC
+    uint16_t version;   // RISCV_LOG_VERSION
+    uint16_t rsvd;
+} riscv_log_hdr_t;
+
+// Unsigned varint
+static inline uint8_t *riscv_log_put(uint8_t *p, uint64_t val)
+{
+    while (val >= 0x80)
+    {
+        *p++ = (uint8_t)val | 0x80;
+        val >>= 7;
+    }
+    *p++ = (uint8_t)val;
+
+    return p;
+}
+
+// Signed 32-bit delta, zigzag-encoded
+static inline uint8_t *riscv_log_put_s(uint8_t *p, int32_t val)
+{
+    return riscv_log_put(p, ((uint32_t)val << 1) ^ (uint32_t)(val >> 31));
+}
+
+static inline uint64_t riscv_log_get(const uint8_t *&p)
+{
+    uint64_t val = 0;
+    int      sh  = 0;
+
+    while ((*p & 0x80) && (sh < 63))
+    {
+        val |= (uint64_t)(*p++ & 0x7F) << sh;
+        sh  += 7;
+    }
+    val |= (uint64_t)(*p++) << sh;
+
+    return val;
+}
+
+static inline int32_t riscv_log_get_s(const uint8_t *&p)
+{
+    uint32_t val = (uint32_t)riscv_log_get(p);
+
+    return (int32_t)(val >> 1) ^ -(int32_t)(val & 1);
+}
+
+#endif /* _RISCV_LOG_H_ */
@@ -0,0 +1,257 @@
+// Copyright 2018-2022 Frederic Requin
+//
+// License: BSD
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions 
+// are met:
+//   - Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//   - Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer 
+//     in the documentation and/or other materials provided with the 
+//     distribution.
+//   - Neither the name of the author nor the names of its contributors 
+//     may be used to endorse or promote products derived from this 
+//     software without specific prior written permission.
+//
+// RISC-V binary trace decoder:
+// ----------------------------
+//  - Converts a binary trace (RISCVTrace::open(name, true)) to the text format
+//  - Instructions are disassembled offline by the RISC-V trace disassembler
+//    (only the displayed ones, cached by PC and instruction word)
+//  - Filters : fetch address range and time window
+//  - Build : g++ -O2 -I$VERILATOR_ROOT/include -I../ring_buffer -o riscv_logdec riscv_logdec.cpp riscv_trace.cpp -lpthread
+//
+// Usage : riscv_logdec [-p lo:hi] [-t t0:t1] trace.bin32 [trace.out32]
+//
+
+#include "verilated.h"
+#include "riscv_trace.h"
+#include "riscv_log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define REC_BUF_LEN (1 << 20)
+// Disassembly cache entries (log2)
+#define DAC_LOG2    (12)
+
+// Filters
+static uint64_t f_pc_lo = 0;
+static uint64_t f_pc_hi = ~0ULL;
+static uint64_t f_ts_lo = 0;
+static uint64_t f_ts_hi = ~0ULL;
+
+static void usage(void)
+{
+    printf("Usage : riscv_logdec [-p lo:hi] [-t t0:t1] trace.bin32 [trace.out32]\n");
+    printf("  -p lo:hi : only the instructions fetched in [lo, hi[ (and their loads/stores)\n");
+    printf("  -t t0:t1 : only the records in [t0, t1[ (ps)\n");
+    exit(1);
+}
+
+static void parse_range(const char *arg, uint64_t &lo, uint64_t &hi)
+{
+    const char *sep = strchr(arg, ':');
+
+    if (!sep) usage();
+    lo = strtoull(arg, NULL, 0);
+    hi = (sep[1]) ? strtoull(sep + 1, NULL, 0) : ~0ULL;
+}
+
+int main(int argc, char **argv)
+{
+    const char      *in_name  = NULL;
+    const char      *out_name = NULL;
+    FILE            *fh_in;
+    FILE            *fh_out;
+    riscv_log_hdr_t  hdr;
+    uint8_t         *recs;
+    const uint8_t   *p;
+    size_t           len;
+    bool             eof      = false;
+    // Decoder state
+    uint64_t         ts       = 0;
+    uint32_t         pc       = 0;     // Next sequential fetch address
+    uint32_t         addr     = 0;     // Last load/store address
+    uint32_t         regs[32];
+    bool             pc_on    = true;  // Last fetched instruction is displayed
+    // Disassembler only
+    RISCVTrace      *dasm     = new RISCVTrace(0, 0, 0);
+    TraceDasm<RISCVTrace> dac(dasm, &RISCVTrace::disasm, DAC_LOG2);
+
+    // Command line
+    for (int i = 1; i < argc; i++)
+    {
+        if ((!strcmp(argv[i], "-p")) && (i + 1 < argc))
+        {
+            parse_range(argv[++i], f_pc_lo, f_pc_hi);
+            pc_on = false;
+        }
+        else if ((!strcmp(argv[i], "-t")) && (i + 1 < argc))
+        {
+            parse_range(argv[++i], f_ts_lo, f_ts_hi);
+        }
+        else if (argv[i][0] == '-')
+        {
+            usage();
+        }
+        else if (!in_name)
+        {
+            in_name = argv[i];
+        }
+        else
+        {
+            out_name = argv[i];
+        }
+    }
+    if (!in_name) usage();
+
+    fh_in = fopen(in_name, "rb");
+    if (!fh_in)
+    {
+        printf("Cannot open binary trace file \"%s\" !!\n", in_name);
+        return 1;
+    }
+    if ((fread((void *)&hdr, sizeof(hdr), 1, fh_in) != 1) ||
+        (hdr.magic != RISCV_LOG_MAGIC) || (hdr.version != RISCV_LOG_VERSION))
+    {
+        printf("\"%s\" is not a RISC-V binary trace file !!\n", in_name);
+        fclose(fh_in);
+        return 1;
+    }
+    fh_out = (out_name) ? fopen(out_name, "w") : stdout;
+    if (!fh_out)
+    {
+        printf("Cannot create text trace file \"%s\" !!\n", out_name);
+        fclose(fh_in);
+        return 1;
+    }
+
+    memset((void *)regs, 0, sizeof(regs));
+
+    // Records buffer, zero padded : a truncated record cannot be read past the end
+    recs = new uint8_t[REC_BUF_LEN + RISCV_LOG_REC_MAX];
+    len  = 0;
+    p    = recs;
+    for (;;)
+    {
+        // Refill the buffer when less than one full record is left
+        if ((!eof) && (p + RISCV_LOG_REC_MAX > recs + len))
+        {
+            size_t left = len - (size_t)(p - recs);
+
+            memmove((void *)recs, (const void *)p, left);
+            len = left + fread((void *)(recs + left), 1, REC_BUF_LEN - left, fh_in);
+            eof = (len < REC_BUF_LEN);
+            memset((void *)(recs + len), 0, RISCV_LOG_REC_MAX);
+            p   = recs;
+        }
+        if (p >= recs + len) break;
+
+        uint8_t tag     = *p++;
+        bool    in_time;
+
+        ts     += riscv_log_get(p);
+        in_time = (ts >= f_ts_lo) && (ts < f_ts_hi);
+
+        switch (tag & 15)
+        {
+            case RISCV_LOG_FETCH :
+            {
+                uint32_t i_address = pc + (uint32_t)riscv_log_get_s(p);
+                uint32_t i_rddata  = (uint32_t)riscv_log_get(p);
+                uint32_t pc_reg    = (tag & RISCV_LOG_DPC) ? (uint32_t)riscv_log_get(p) : i_address;
+                int      cnt       = (tag >> 4) & 7;
+
+                if (cnt == RISCV_LOG_REGS_ESC) cnt = (int)riscv_log_get(p);
+                while (cnt--)
+                {
+                    uint8_t idx = *p++;
+
+                    regs[idx & 31] ^= (uint32_t)riscv_log_get(p);
+                }
+                pc    = i_address + 4;
+                pc_on = (i_address >= f_pc_lo) && (i_address < f_pc_hi);
+                if ((!in_time) || (!pc_on)) break;
+
+                // CPU registers
+                fprintf(fh_out, " x0 : %08X %08X %08X %08X %08X %08X %08X %08X\n",
+                        regs[ 0], regs[ 1], regs[ 2], regs[ 3], regs[ 4], regs[ 5], regs[ 6], regs[ 7]);
+                fprintf(fh_out, " x8 : %08X %08X %08X %08X %08X %08X %08X %08X\n",
+                        regs[ 8], regs[ 9], regs[10], regs[11], regs[12], regs[13], regs[14], regs[15]);
+                fprintf(fh_out, "x16 : %08X %08X %08X %08X %08X %08X %08X %08X\n",
+                        regs[16], regs[17], regs[18], regs[19], regs[20], regs[21], regs[22], regs[23]);
+                fprintf(fh_out, "x24 : %08X %08X %08X %08X %08X %08X %08X %08X\n\n",
+                        regs[24], regs[25], regs[26], regs[27], regs[28], regs[29], regs[30], regs[31]);
+
+                // Disassembled instruction
+                {
+                    char buf[80];
+
+                    fprintf(fh_out, "(%14llu ps) %08X : %08X %s\n", (unsigned long long)ts,
+                            i_address, i_rddata, dac.get(buf, i_rddata, pc_reg));
+                }
+                break;
+            }
+            case RISCV_LOG_MEM_RD :
+            case RISCV_LOG_MEM_WR :
+            {
+                uint32_t data;
+
+                addr += (uint32_t)riscv_log_get_s(p);
+                data  = (uint32_t)riscv_log_get(p);
+                if ((!in_time) || (!pc_on)) break;
+
+                if ((tag & 15) == RISCV_LOG_MEM_RD)
+                {
+                    fprintf(fh_out, "Memory read @ $%08X : %08X\n", addr, data);
+                }
+                else
+                {
+                    fprintf(fh_out, "Memory write @ $%08X : $", addr);
+                    for (int l = 3; l >= 0; l--)
+                    {
+                        if ((tag >> (4 + l)) & 1)
+                            fprintf(fh_out, "%02X", (data >> (l * 8)) & 0xFF);
+                        else
+                            fputs("XX", fh_out);
+                    }
+                    fputc('\n', fh_out);
+                }
+                break;
+            }
+            case RISCV_LOG_MISM :
+            {
+                int      kind  = (tag >> 4) & 15;
+                uint32_t v_val = (uint32_t)riscv_log_get(p);
+                uint32_t c_val = (uint32_t)riscv_log_get(p);
+
+                if ((!in_time) || (!pc_on) || (kind > RISCV_MISM_DATA_MASK)) break;
+
+                trace_print_mism(fh_out, kind, v_val, c_val);
+                break;
+            }
+            default :
+            {
+                printf("Unknown record type %d in \"%s\" !!\n", tag & 15, in_name);
+                eof = true;
+                len = 0;
+                p   = recs;
+            }
+        }
+        if (p > recs + len)
+        {
+            printf("Truncated binary trace file \"%s\" !!\n", in_name);
+            break;
+        }
+    }
+
+    delete[] recs;
+    delete dasm;
+    fclose(fh_in);
+    if (fh_out != stdout) fclose(fh_out);
+
+    return 0;
+}
@@ -24,12 +24,46 @@
 //  - It is intended to be connected to a RISC-V verilog core
 //  - It supports segmented traces
 //  - Memory footprint is minimal
+//  - It can write a compact binary trace instead of text (see riscv_log.h)
+//  - Binary traces are converted back to text offline by "riscv_logdec"
 
 #include "verilated.h"
 #include "riscv_trace.h"
 #include <stdlib.h>
 #include <stdio.h>
 
+// Binary trace buffer size (bytes)
+#define BIN_BUF_LEN (65536)
+
+// Writer thread record : binary trace block
+#define ASYNC_RAW   (15)
+
+// Instruction history : register written (addr : index, data : value)
+#define HIST_REG    (14)
+
+// Predecode cache entries (direct mapped on the PC)
+#define PDC_SIZE    (4096)
+
+// Disassembly cache entries (log2)
+#define DAC_LOG2    (10)
+
+// Predecoded operations
+enum
+{
+    EX_ILLEGAL = 0, // Must be 0 : a cleared entry decodes the word 0x00000000
+    EX_NONE,
+    EX_NOP,
+    EX_LB,    EX_LH,    EX_LW,    EX_LD_ILL,
+    EX_SB,    EX_SH,    EX_SW,    EX_ST_ILL,
+    EX_ADDI,  EX_SLLI,  EX_SLTI,  EX_SLTIU, EX_XORI,  EX_SRLI,  EX_SRAI,  EX_ORI,   EX_ANDI,
+    EX_ADD,   EX_SUB,   EX_SLL,   EX_SLT,   EX_SLTU,  EX_XOR,   EX_SRL,   EX_SRA,   EX_OR,    EX_AND,
+    EX_LUI,   EX_AUIPC,
+    EX_BEQ,   EX_BNE,   EX_BLT,   EX_BGE,   EX_BLTU,  EX_BGEU,
+    EX_JALR,  EX_JAL,
+    EX_ECALL, EX_EBREAK, EX_MRET,
+    EX_CSRRW, EX_CSRRS, EX_CSRRC, EX_CSRRWI, EX_CSRRSI, EX_CSRRCI
+};
+
 enum
 {
     OPC_LOAD      = 0x03,
@@ -253,6 +287,21 @@ RISCVTrace::RISCVTrace(vluint32_t reset_vect, vluint32_t comp_data_beg, vluint32
     oname[0]    = (char)0;
     tfh         = stdout;
     ofh         = stdout;
+    // No binary trace
+    bin_mode    = false;
+    bin_on      = false;
+    bin_now     = (vluint64_t)0;
+    // No writer thread
+    twr         = (TraceWriter *)NULL;
+    async_on    = false;
+    // Everything is traced
+    hist_buf    = (hist_rec_t *)NULL;
+    hist_size   = 0;
+    hist_depth  = 0;
+    hist_post   = 0;
+    hist_after  = 0;
+    bin_buf     = NULL;
+    bin_len     = 0;
     // Internal variables cleared
     dasm_buf[0] = (char)0;
     prev_clk    = (vluint8_t)0;
@@ -260,6 +309,11 @@ RISCVTrace::RISCVTrace(vluint32_t reset_vect, vluint32_t comp_data_beg, vluint32
     mem_xfer    = XFER_NONE;
     mem_mask    = (vluint8_t)0xF;
     mem_addr    = (vluint32_t)0x00000000;
+    // Predecode cache cleared
+    pdc_buf     = new pdc_ent_t[PDC_SIZE];
+    memset((void *)pdc_buf, 0, sizeof(pdc_ent_t) * PDC_SIZE);
+    // Disassembly cache cleared
+    dac         = new TraceDasm<RISCVTrace>(this, &RISCVTrace::riscv_dasm, DAC_LOG2);
     // Compliance testing
     test_start  = comp_data_beg;
     test_stop   = comp_data_end;
@@ -284,10 +338,79 @@ RISCVTrace::~RISCVTrace()
         delete[] test_ptr;
         test_ptr = NULL;
     }
+    if (bin_buf)
+    {
+        delete[] bin_buf;
+        bin_buf = NULL;
+    }
+    if (twr)
+    {
+        delete twr;
+        twr = (TraceWriter *)NULL;
+    }
+    if (hist_buf)
+    {
+        delete[] hist_buf;
+        hist_buf = (hist_rec_t *)NULL;
+    }
+    delete[] pdc_buf;
+    delete dac;
+}
+
+// Format and write the trace on a background thread (before open)
+// buf_log2 : records buffer size (log2, 0 : no thread), policy : TRACE_WR_xxx
+// Binary trace blocks and mismatches are never dropped : with TRACE_WR_DROP,
+// only text fetch / memory records are lost when the buffer is full
+int RISCVTrace::setAsync(int buf_log2, int policy)
+{
+    // Trace file already open
+    if (tfh != stdout) return -1;
+
+    if (twr)
+    {
+        delete twr;
+        twr = (TraceWriter *)NULL;
+    }
+    if (buf_log2)
+    {
+        // Room for a binary trace block
+        if (buf_log2 < 17) buf_log2 = 17;
+        twr = new TraceWriter(buf_log2, policy, &RISCVTrace::async_fmt, (void *)this);
+    }
+    
+    return 0;
+}
+
+// Mismatch-only trace : the last "depth" instructions are kept in memory
+// and written out on a mismatch, followed by the next "after" instructions
+// depth : history window (instructions, 0 : everything is traced)
+void RISCVTrace::setHistory(int depth, int after)
+{
+    if (hist_buf)
+    {
+        delete[] hist_buf;
+        hist_buf = (hist_rec_t *)NULL;
+    }
+    hist_depth = (depth > 0) ? depth : 0;
+    hist_post  = (after > 0) ? after : 0;
+    hist_after = 0;
+    if (hist_depth)
+    {
+        // Room for a fetch, a few register writes and loads/stores per instruction
+        for (hist_size = 64; hist_size < (vluint64_t)hist_depth * 8; hist_size <<= 1);
+        hist_buf = new hist_rec_t[hist_size];
+        hist_reset();
+    }
+}
+
+// Writer thread counters : records, dropped records, full buffer waits
+void RISCVTrace::getAsyncStats(vluint64_t &records, vluint64_t &drops, vluint64_t &stalls)
+{
+    trace_get_stats(twr, records, drops, stalls);
 }
 
 // Open trace file
-int RISCVTrace::open(const char *name)
+int RISCVTrace::open(const char *name, bool bin)
 {
     FILE *fh;
     
@@ -298,10 +421,10 @@ int RISCVTrace::open(const char *name)
     //strncpy(tname, name, 246);
     //strcat(tname, "_0000.trc");
     strncpy(tname, name, 249);
-    strcat(tname, ".out32");
+    strcat(tname, (bin) ? ".bin32" : ".out32");
     
     // Try to open the trace file for writing
-    fh = fopen(tname, "w");
+    fh = fopen(tname, (bin) ? "wb" : "w");
     if (!fh)
     {
         // Failure
@@ -310,6 +433,13 @@ int RISCVTrace::open(const char *name)
     }
     // Success
     tfh = fh;
+    bin_mode = bin;
+    if (twr) twr->start(tfh);
+    if (bin_mode)
+    {
+        if (!bin_buf) bin_buf = new vluint8_t[BIN_BUF_LEN];
+        bin_start();
+    }
     
     // Complete the output file name
     //strncpy(oname, name, 246);
@@ -374,7 +504,7 @@ int RISCVTrace::openNext(void)
     */
     
     // Try to open the trace file for writing
-    fh = fopen(tname, "w");
+    fh = fopen(tname, (bin_mode) ? "wb" : "w");
     if (!fh)
     {
         // Failure
@@ -383,6 +513,8 @@ int RISCVTrace::openNext(void)
     }
     // Success
     tfh = fh;
+    if (twr) twr->start(tfh);
+    if (bin_mode) bin_start();
     
     // Increment the output file name
     /*
@@ -411,6 +543,8 @@ void RISCVTrace::close(void)
 {
     if (tfh != stdout)
     {
+        if (bin_mode) bin_flush();
+        if (twr) twr->stop();
         fclose(tfh);
         tfh = stdout;
     }
@@ -469,38 +603,33 @@ void RISCVTrace::dump
     // Rising edge on clock
     if (clk && !prev_clk)
     {
+        // Binary records instead of text, text formatted by the writer thread
+        bin_on   = (bin_mode) && (tfh != stdout);
+        async_on = (twr) && (twr->is_on());
+        bin_now  = stamp;
+
         //ip_reg = ip_reg | inr_ir_irq & im_reg;
         if (wb_ena)
         {
             if (wb_idx != rd_idx)
             {
-                fprintf(tfh, "!!! WRITEBACK INDEX MISMATCH !!!\n");
-                fprintf(tfh, "Verilog : %2d, C-Model : %2d\n", wb_idx, rd_idx);
+                mismatch(RISCV_MISM_WB_IDX, wb_idx, rd_idx);
             }
             else if ((gp_regs[rd_idx] != wb_data) && (rd_idx))
             {
-                fprintf(tfh, "!!! WRITEBACK DATA MISMATCH !!!\n");
-                fprintf(tfh, "Verilog : %08X, C-Model : %08X\n", wb_data, gp_regs[rd_idx]);
+                mismatch(RISCV_MISM_WB_DATA, wb_data, gp_regs[rd_idx]);
             }
         }
         if (d_rd_ack)
         {
-            fprintf(tfh, "Memory read @ $%08X : %08X\n", d_address, d_rddata);
+            trace_mem(RISCV_LOG_MEM_RD, d_address, d_rddata, 0);
             
             // Instruction simulation (memory/writeback)
             riscv_simu_rd(d_address, d_rddata);
         }
         if (d_wr_ack)
         {
-            char buf[10];
-            
-            memcpy(buf + 6, (d_byteena & 1) ? uhex_to_str(d_wrdata >>  0, 2) : "$XX", 3);
-            memcpy(buf + 4, (d_byteena & 2) ? uhex_to_str(d_wrdata >>  8, 2) : "$XX", 3);
-            memcpy(buf + 2, (d_byteena & 4) ? uhex_to_str(d_wrdata >> 16, 2) : "$XX", 3);
-            memcpy(buf + 0, (d_byteena & 8) ? uhex_to_str(d_wrdata >> 24, 2) : "$XX", 3);
-            buf[9] = (char)0;
-            
-            fprintf(tfh, "Memory write @ $%08X : %s\n", d_address, buf);
+            trace_mem(RISCV_LOG_MEM_WR, d_address, d_wrdata, d_byteena);
             
             if ((test_ptr) && (d_address >= test_start) && (d_address < test_stop))
             {
@@ -516,29 +645,7 @@ void RISCVTrace::dump
         }
         if (i_rd_ack)
         {
-            char buf[80];
-            
-            // CPU registers
-            fprintf(tfh, " x0 : %08X %08X %08X %08X %08X %08X %08X %08X\n",
-                    gp_regs[ 0], gp_regs[ 1], gp_regs[ 2], gp_regs[ 3],
-                    gp_regs[ 4], gp_regs[ 5], gp_regs[ 6], gp_regs[ 7]
-                   );
-            fprintf(tfh, " x8 : %08X %08X %08X %08X %08X %08X %08X %08X\n",
-                    gp_regs[ 8], gp_regs[ 9], gp_regs[10], gp_regs[11],
-                    gp_regs[12], gp_regs[13], gp_regs[14], gp_regs[15]
-                   );
-            fprintf(tfh, "x16 : %08X %08X %08X %08X %08X %08X %08X %08X\n",
-                    gp_regs[16], gp_regs[17], gp_regs[18], gp_regs[19],
-                    gp_regs[20], gp_regs[21], gp_regs[22], gp_regs[23]
-                   );
-            fprintf(tfh, "x24 : %08X %08X %08X %08X %08X %08X %08X %08X\n\n",
-                    gp_regs[24], gp_regs[25], gp_regs[26], gp_regs[27],
-                    gp_regs[28], gp_regs[29], gp_regs[30], gp_regs[31]
-                   );
-                   
-            // Disassemble instruction being fetched
-            riscv_dasm(buf, i_rddata, pc_reg);
-            fprintf(tfh, "(%14llu ps) %08X : %08X %s\n", stamp, i_address, i_rddata, buf);
+            trace_fetch(i_address, i_rddata);
             
             // Instruction simulation (fetch/decode/execute/writeback)
             riscv_simu_if(i_address, i_rddata);
@@ -547,6 +654,381 @@ void RISCVTrace::dump
     prev_clk = clk;
 }
 
+// Trace an instruction fetch
+void RISCVTrace::trace_fetch(vluint32_t i_address, vluint32_t i_rddata)
+{
+    if (hist_depth)
+    {
+        // Following instructions after a mismatch
+        if (hist_after)
+        {
+            out_fetch(bin_now, i_address, i_rddata, pc_reg, gp_regs);
+            hist_after--;
+            return;
+        }
+        hist_fetch(i_address, i_rddata);
+    }
+    else
+    {
+        out_fetch(bin_now, i_address, i_rddata, pc_reg, gp_regs);
+    }
+}
+
+// Trace a memory read or write
+void RISCVTrace::trace_mem(int type, vluint32_t addr, vluint32_t data, vluint8_t mask)
+{
+    if ((hist_depth) && (!hist_after))
+    {
+        hist_put(type, addr, data, mask);
+    }
+    else
+    {
+        out_mem(bin_now, type, addr, data, mask);
+    }
+}
+
+// Write an instruction fetch (binary, writer thread or text)
+void RISCVTrace::out_fetch(vluint64_t stamp, vluint32_t i_address, vluint32_t i_rddata,
+                           vluint32_t pc, const vluint32_t *regs)
+{
+    if (bin_on)
+    {
+        // Registers changes, PC and instruction word
+        bin_fetch(stamp, i_address, i_rddata, pc, regs);
+    }
+    else if (async_on)
+    {
+        trace_put_fetch(twr, stamp, i_address, i_rddata, pc, regs);
+    }
+    else
+    {
+        print_fetch(tfh, stamp, i_address, i_rddata, pc, regs);
+    }
+}
+
+// Write a memory read or write (binary, writer thread or text)
+void RISCVTrace::out_mem(vluint64_t stamp, int type, vluint32_t addr, vluint32_t data, vluint8_t mask)
+{
+    if (bin_on)
+    {
+        bin_mem(stamp, type, addr, data, mask);
+    }
+    else if (async_on)
+    {
+        trace_put_mem(twr, type, addr, data, mask);
+    }
+    else
+    {
+        trace_print_mem(tfh, type, addr, data, mask);
+    }
+}
+
+// Instruction history : clear, starting from the current registers
+void RISCVTrace::hist_reset(void)
+{
+    hist_rd  = 0;
+    hist_wr  = 0;
+    hist_cnt = 0;
+    memcpy((void *)hist_base, (const void *)gp_regs, sizeof(gp_regs));
+    memcpy((void *)hist_regs, (const void *)gp_regs, sizeof(gp_regs));
+}
+
+// Instruction history : drop the oldest instruction (registers, fetch, loads/stores)
+void RISCVTrace::hist_evict(void)
+{
+    bool fetch = false;
+
+    while (hist_rd != hist_wr)
+    {
+        hist_rec_t &rec = hist_buf[hist_rd & (hist_size - 1)];
+
+        if ((rec.type == HIST_REG) || (rec.type == RISCV_LOG_FETCH))
+        {
+            // Next instruction reached
+            if (fetch) break;
+            if (rec.type == RISCV_LOG_FETCH)
+            {
+                fetch = true;
+                hist_cnt--;
+            }
+            else
+            {
+                hist_base[rec.addr] = rec.data;
+            }
+        }
+        hist_rd++;
+    }
+}
+
+// Instruction history : add one record
+void RISCVTrace::hist_put(int type, vluint32_t addr, vluint32_t data, vluint8_t mask)
+{
+    hist_rec_t *rec;
+
+    if (hist_wr - hist_rd == hist_size) hist_evict();
+
+    rec = &hist_buf[hist_wr & (hist_size - 1)];
+    rec->stamp = bin_now;
+    rec->addr  = addr;
+    rec->data  = data;
+    rec->pc    = pc_reg;
+    rec->type  = (vluint8_t)type;
+    rec->mask  = mask;
+    hist_wr++;
+}
+
+// Instruction history : registers written since the previous fetch, then the fetch
+void RISCVTrace::hist_fetch(vluint32_t i_address, vluint32_t i_rddata)
+{
+    if (hist_cnt == hist_depth) hist_evict();
+
+    for (int i = 0; i < 32; i++)
+    {
+        if (gp_regs[i] != hist_regs[i])
+        {
+            hist_put(HIST_REG, i, gp_regs[i], 0);
+            hist_regs[i] = gp_regs[i];
+        }
+    }
+    hist_put(RISCV_LOG_FETCH, i_address, i_rddata, 0);
+    hist_cnt++;
+}
+
+// Instruction history : write it out, the following instructions are traced
+void RISCVTrace::hist_dump(void)
+{
+    vluint32_t regs[32];
+
+    memcpy((void *)regs, (const void *)hist_base, sizeof(regs));
+    for (vluint64_t i = hist_rd; i != hist_wr; i++)
+    {
+        hist_rec_t &rec = hist_buf[i & (hist_size - 1)];
+
+        switch (rec.type)
+        {
+            case HIST_REG :
+                regs[rec.addr] = rec.data;
+                break;
+            case RISCV_LOG_FETCH :
+                out_fetch(rec.stamp, rec.addr, rec.data, rec.pc, regs);
+                break;
+            default :
+                out_mem(rec.stamp, rec.type, rec.addr, rec.data, rec.mask);
+        }
+    }
+    hist_reset();
+}
+
+// Text trace : registers and disassembled instruction
+void RISCVTrace::print_fetch(FILE *fh, vluint64_t stamp, vluint32_t i_address, vluint32_t i_rddata,
+                             vluint32_t pc, const vluint32_t *regs)
+{
+    char buf[80];
+    
+    // CPU registers
+    fprintf(fh, " x0 : %08X %08X %08X %08X %08X %08X %08X %08X\n",
+            regs[ 0], regs[ 1], regs[ 2], regs[ 3],
+            regs[ 4], regs[ 5], regs[ 6], regs[ 7]
+           );
+    fprintf(fh, " x8 : %08X %08X %08X %08X %08X %08X %08X %08X\n",
+            regs[ 8], regs[ 9], regs[10], regs[11],
+            regs[12], regs[13], regs[14], regs[15]
+           );
+    fprintf(fh, "x16 : %08X %08X %08X %08X %08X %08X %08X %08X\n",
+            regs[16], regs[17], regs[18], regs[19],
+            regs[20], regs[21], regs[22], regs[23]
+           );
+    fprintf(fh, "x24 : %08X %08X %08X %08X %08X %08X %08X %08X\n\n",
+            regs[24], regs[25], regs[26], regs[27],
+            regs[28], regs[29], regs[30], regs[31]
+           );
+           
+    // Disassemble instruction being fetched
+    fprintf(fh, "(%14llu ps) %08X : %08X %s\n", stamp, i_address, i_rddata, dac->get(buf, i_rddata, pc));
+}
+
+// Writer thread : record formatting
+void RISCVTrace::async_fmt(void *ctx, FILE *fh, int type, const vluint8_t *rec, int len)
+{
+    RISCVTrace       *trc = (RISCVTrace *)ctx;
+    const vluint32_t *val = (const vluint32_t *)rec;
+    
+    switch (type)
+    {
+        case TRACE_REC_FETCH :
+        {
+            const trace_fetch_t *f = (const trace_fetch_t *)rec;
+            
+            trc->print_fetch(fh, f->stamp, f->addr, f->inst, f->pc, f->regs);
+            break;
+        }
+        case TRACE_REC_MEM_RD :
+        case TRACE_REC_MEM_WR :
+        {
+            trace_print_mem(fh, type, val[0], val[1], (vluint8_t)val[2]);
+            break;
+        }
+        case TRACE_REC_MISM :
+        {
+            trace_print_mism(fh, (int)val[0], val[1], val[2]);
+            break;
+        }
+        default :
+        {
+            // Binary trace block
+            fwrite((const void *)rec, 1, len, fh);
+        }
+    }
+}
+
+// Start a binary trace : header and cleared encoder state
+void RISCVTrace::bin_start(void)
+{
+    riscv_log_hdr_t hdr;
+
+    memset((void *)&hdr, 0, sizeof(hdr));
+    hdr.magic   = RISCV_LOG_MAGIC;
+    hdr.version = RISCV_LOG_VERSION;
+    fwrite((void *)&hdr, sizeof(hdr), 1, tfh);
+
+    bin_len  = 0;
+    bin_ts   = (vluint64_t)0;
+    bin_pc   = (vluint32_t)0;
+    bin_addr = (vluint32_t)0;
+    memset((void *)bin_regs, 0, sizeof(bin_regs));
+}
+
+// Write the binary records buffer
+void RISCVTrace::bin_flush(void)
+{
+    if (!bin_len) return;
+
+    if ((twr) && (twr->is_on()))
+    {
+        // Delta encoded : a dropped block would corrupt the rest of the trace
+        vluint8_t *rec = twr->alloc(ASYNC_RAW, bin_len, true);
+        
+        memcpy((void *)rec, (const void *)bin_buf, bin_len);
+        twr->commit();
+    }
+    else
+    {
+        fwrite((void *)bin_buf, 1, bin_len, tfh);
+    }
+    bin_len = 0;
+}
+
+// Binary record : instruction fetch
+void RISCVTrace::bin_fetch(vluint64_t stamp, vluint32_t i_address, vluint32_t i_rddata,
+                           vluint32_t pc, const vluint32_t *regs)
+{
+    vluint8_t *tag;
+    vluint8_t *p;
+    vluint32_t diff;
+    int        cnt;
+
+    if (bin_len > BIN_BUF_LEN - RISCV_LOG_REC_MAX) bin_flush();
+
+    tag = bin_buf + bin_len;
+    p   = riscv_log_put(tag + 1, stamp - bin_ts);
+    p   = riscv_log_put_s(p, (int32_t)(i_address - bin_pc));
+    p   = riscv_log_put(p, i_rddata);
+    *tag = (vluint8_t)RISCV_LOG_FETCH;
+    if (pc != i_address)
+    {
+        p = riscv_log_put(p, pc);
+        *tag |= (vluint8_t)RISCV_LOG_DPC;
+    }
+    bin_ts = stamp;
+    bin_pc = i_address + 4;
+
+    // Registers written since the previous fetch
+    cnt = 0;
+    for (int i = 0; i < 32; i++)
+    {
+        cnt += (regs[i] != bin_regs[i]) ? 1 : 0;
+    }
+    if (cnt < RISCV_LOG_REGS_ESC)
+    {
+        *tag |= (vluint8_t)(cnt << 4);
+    }
+    else
+    {
+        *tag |= (vluint8_t)(RISCV_LOG_REGS_ESC << 4);
+        p = riscv_log_put(p, cnt);
+    }
+    for (int i = 0; (i < 32) && (cnt); i++)
+    {
+        diff = regs[i] ^ bin_regs[i];
+        if (diff)
+        {
+            *p++ = (vluint8_t)i;
+            p = riscv_log_put(p, diff);
+            bin_regs[i] = regs[i];
+            cnt--;
+        }
+    }
+    bin_len = (int)(p - bin_buf);
+}
+
+// Binary record : memory read or write
+void RISCVTrace::bin_mem(vluint64_t stamp, int type, vluint32_t addr, vluint32_t data, vluint8_t mask)
+{
+    vluint8_t *p;
+
+    if (bin_len > BIN_BUF_LEN - RISCV_LOG_REC_MAX) bin_flush();
+
+    p = bin_buf + bin_len;
+    *p++ = (vluint8_t)(type | ((mask & 15) << 4));
+    p = riscv_log_put(p, stamp - bin_ts);
+    p = riscv_log_put_s(p, (int32_t)(addr - bin_addr));
+    p = riscv_log_put(p, data);
+    bin_ts   = stamp;
+    bin_addr = addr;
+    bin_len  = (int)(p - bin_buf);
+}
+
+// Trace / simulation mismatch
+void RISCVTrace::mismatch(int kind, vluint32_t v_val, vluint32_t c_val)
+{
+    // Mismatch-only trace : history window, then the following instructions
+    if (hist_depth)
+    {
+        if (!hist_after) hist_dump();
+        hist_after = hist_post;
+    }
+    
+    if (bin_on)
+    {
+        vluint8_t *p;
+
+        if (bin_len > BIN_BUF_LEN - RISCV_LOG_REC_MAX) bin_flush();
+
+        p = bin_buf + bin_len;
+        *p++ = (vluint8_t)(RISCV_LOG_MISM | (kind << 4));
+        p = riscv_log_put(p, bin_now - bin_ts);
+        p = riscv_log_put(p, v_val);
+        p = riscv_log_put(p, c_val);
+        bin_ts  = bin_now;
+        bin_len = (int)(p - bin_buf);
+        bin_flush();
+    }
+    else if (async_on)
+    {
+        trace_put_mism(twr, kind, v_val, c_val);
+    }
+    else
+    {
+        trace_print_mism(tfh, kind, v_val, c_val);
+    }
+    
+    // Everything up to the mismatch is on the disk
+    if (async_on)
+        twr->flush();
+    else
+        fflush(tfh);
+}
+
 // Disassemble one instruction
 char RISCVTrace::disasm(vluint32_t inst, vluint32_t pc, int idx)
 {
@@ -558,6 +1040,12 @@ char RISCVTrace::disasm(vluint32_t inst, vluint32_t pc, int idx)
     return dasm_buf[idx & 31];
 }
 
+// Disassemble one instruction into a buffer (80 characters)
+void RISCVTrace::disasm(char *buf, vluint32_t inst, vluint32_t pc)
+{
+    riscv_dasm(buf, inst, pc);
+}
+
 /******************************************************************************/
 /** uhex_to_str()                                                            **/
 /** ------------------------------------------------------------------------ **/
@@ -568,7 +1056,7 @@ char RISCVTrace::disasm(vluint32_t inst, vluint32_t pc, int idx)
 
 char *RISCVTrace::uhex_to_str(vluint32_t val, int dig)
 {
-    static char buf[12];
+    static thread_local char buf[12];
     char *p;
     
     dig <<= 2;
@@ -596,7 +1084,7 @@ char *RISCVTrace::uhex_to_str(vluint32_t val, int dig)
 
 char *RISCVTrace::shex_to_str(vluint32_t val, int dig)
 {
-    static char buf[12];
+    static thread_local char buf[12];
     char *p;
     vluint32_t msk;
     
@@ -626,7 +1114,7 @@ char *RISCVTrace::shex_to_str(vluint32_t val, int dig)
 
 char *RISCVTrace::get_csr_str(int csr)
 {
-    static char buf[8];
+    static thread_local char buf[8];
     
     buf[0] = 0;
     switch (csr >> 3)
@@ -904,127 +1392,42 @@ void RISCVTrace::riscv_dasm(char *buf, vluint32_t inst, vluint32_t pc)
     }
 }
 
-void RISCVTrace::riscv_simu_if(vluint32_t addr, vluint32_t inst)
+// Predecode one instruction : operation, register indexes and the immediate it uses
+void RISCVTrace::riscv_decode(vluint32_t addr, vluint32_t inst, pdc_ent_t *ent)
 {
-    vluint8_t func7;
-    vluint8_t func3;
-    vluint8_t rs1_idx;
-    vluint8_t rs2_idx;
-    
+    vluint8_t  func3 = (inst >> 12) & 0x07;
+    vluint32_t sign  = (GET_BIT(inst,31)) ? 0xFFFFFFFF : 0x00000000;
     vluint32_t i_immed;
-    vluint32_t s_immed;
-    vluint32_t u_immed;
-    vluint32_t b_immed;
-    vluint32_t j_immed;
-    vluint32_t z_immed;
-    
-    vluint32_t jmp_addr;
-    
-    unsigned long uns_imm;
-    signed   long sig_imm;
-    unsigned long uns_rs1;
-    signed   long sig_rs1;
-    unsigned long uns_rs2;
-    signed   long sig_rs2;
-    
-    if (addr != pc_reg)
-    {
-        fprintf(tfh, "!!! INST ADDRESS MISMATCH !!!\n");
-        fprintf(tfh, "Verilog : %08X, C-Model : %08X\n", addr, pc_reg);
-    }
     
-    func7   =  inst        & 0x7F;
-    rd_idx  = (inst >>  7) & 0x1F;
-    func3   = (inst >> 12) & 0x07;
-    rs1_idx = (inst >> 15) & 0x1F;
-    rs2_idx = (inst >> 20) & 0x1F;
+    ent->addr  = addr;
+    ent->inst  = inst;
+    ent->rd    = (inst >>  7) & 0x1F;
+    ent->rs1   = (inst >> 15) & 0x1F;
+    ent->rs2   = (inst >> 20) & 0x1F;
+    ent->func3 = func3;
+    ent->op    = EX_ILLEGAL;
+    ent->imm   = (vluint32_t)0;
     
-    i_immed =  (inst >> 20) & 0x00000FFF;
-    s_immed = ((inst >> 20) & 0x00000FE0)
-            | ((inst >>  7) & 0x0000001F);
-    u_immed =   inst        & 0xFFFFF000;
-    b_immed = ((inst >> 19) & 0x00001000)
-            | ((inst >> 20) & 0x000007E0)
-            | ((inst >>  7) & 0x0000001E)
-            | ((inst <<  4) & 0x00000800);
-    j_immed = ((inst >> 11) & 0x00100000)
-            | ((inst >> 20) & 0x000007FE)
-            | ((inst >>  9) & 0x00000800)
-            |  (inst        & 0x000FF000);
-    z_immed =  (inst >> 15) & 0x0000001F;
+    i_immed = ((inst >> 20) & 0x00000FFF) | (sign & 0xFFFFF000);
     
-    if (GET_BIT(inst,31))
-    {
-        i_immed |= 0xFFFFF000;
-        s_immed |= 0xFFFFF000;
-        b_immed |= 0xFFFFE000;
-        j_immed |= 0xFFE00000;
-    }
-    
-    // Signed / unsigned value (for compare / branch)
-    uns_imm = (unsigned long)i_immed;
-    sig_imm = (uns_imm & 0x80000000) ? -((uns_imm ^ 0xFFFFFFFF) + 1) : uns_imm;
-    uns_rs1 = (unsigned long)gp_regs[rs1_idx];
-    sig_rs1 = (uns_rs1 & 0x80000000) ? -((uns_rs1 ^ 0xFFFFFFFF) + 1) : uns_rs1;
-    uns_rs2 = (unsigned long)gp_regs[rs2_idx];
-    sig_rs2 = (uns_rs2 & 0x80000000) ? -((uns_rs2 ^ 0xFFFFFFFF) + 1) : uns_rs2;
-    
-    switch (func7)
+    switch (inst & 0x7F)
     {
         // 0x03
         case OPC_LOAD:
         {
-            mem_addr = uns_rs1 + i_immed;
-            mem_xfer = func3;
+            ent->imm = i_immed;
             switch (func3)
             {
                 case 0: // LB
                 case 4: // LBU
-                {
-                    mem_mask = (vluint8_t)0x1 << (mem_addr & 3);
-                    pc_reg += 4;
-                    break;
-                }
+                    ent->op = EX_LB;   break;
                 case 1: // LH
                 case 5: // LHU
-                {
-                    if (mem_addr & 1)
-                    {
-                        // Unaligned address
-                        mem_xfer = XFER_NONE;
-                        mem_mask = (vluint8_t)0x0;
-                        except_nr = RAISE_LADDR_ERR;
-                    }
-                    else
-                    {
-                        mem_mask = (vluint8_t)0x3 << (mem_addr & 2);
-                        pc_reg += 4;
-                    }
-                    break;
-                }
+                    ent->op = EX_LH;   break;
                 case 2: // LW
-                {
-                    if (mem_addr & 3)
-                    {
-                        // Unaligned address
-                        mem_xfer = XFER_NONE;
-                        mem_mask = (vluint8_t)0x0;
-                        except_nr = RAISE_LADDR_ERR;
-                    }
-                    else
-                    {
-                        mem_mask = (vluint8_t)0xF;
-                        pc_reg += 4;
-                    }
-                    break;
-                }
+                    ent->op = EX_LW;   break;
                 default:
-                {
-                    // Invalid instruction
-                    mem_xfer = XFER_NONE;
-                    mem_mask = (vluint8_t)0x0;
-                    except_nr = RAISE_ILLEGAL;
-                }
+                    ent->op = EX_LD_ILL;
             }
             break;
         }
@@ -1032,128 +1435,48 @@ void RISCVTrace::riscv_simu_if(vluint32_t addr, vluint32_t inst)
         // 0x0F
         case OPC_FENCE:
         {
-            pc_reg += 4; // NOP
+            ent->op = EX_NOP;
             break;
         }
         
         // 0x13
         case OPC_OP_IMM:
         {
+            ent->imm = i_immed;
             switch (func3)
             {
-                case 0: // ADDI
-                {
-                    if (rd_idx) gp_regs[rd_idx] = uns_rs1 + i_immed;
-                    break;
-                }
-                case 1: // SLLI
-                {
-                    if (rd_idx) gp_regs[rd_idx] = uns_rs1 << (i_immed & 0x1F);
-                    break;
-                }
-                case 2: // SLTI
-                {
-                    if (rd_idx) gp_regs[rd_idx] = (sig_rs1 < sig_imm) ? 1 : 0;
-                    break;
-                }
-                case 3: // SLTIU
-                {
-                    if (rd_idx) gp_regs[rd_idx] = (uns_rs1 < uns_imm) ? 1 : 0;
-                    break;
-                }
-                case 4: // XORI
-                {
-                    if (rd_idx) gp_regs[rd_idx] = uns_rs1 ^ i_immed;
-                    break;
-                }
-                case 5: // SRLI / SRAI
-                {
-                    if (rd_idx)
-                    {
-                        gp_regs[rd_idx] = (GET_BIT(inst,30))
-                                        ? SRA_32(uns_rs1, i_immed & 0x1F)
-                                        : uns_rs1 >> (i_immed & 0x1F);
-                    }
-                    break;
-                }
-                case 6: // ORI
-                {
-                    if (rd_idx) gp_regs[rd_idx] = uns_rs1 | i_immed;
-                    break;
-                }
-                case 7: // ANDI
-                {
-                    if (rd_idx) gp_regs[rd_idx] = uns_rs1 & i_immed;
-                    break;
-                }
+                case 0: ent->op = EX_ADDI;  break;
+                case 1: ent->op = EX_SLLI;  ent->imm &= 0x1F; break;
+                case 2: ent->op = EX_SLTI;  break;
+                case 3: ent->op = EX_SLTIU; break;
+                case 4: ent->op = EX_XORI;  break;
+                case 5: ent->op = (GET_BIT(inst,30)) ? EX_SRAI : EX_SRLI; ent->imm &= 0x1F; break;
+                case 6: ent->op = EX_ORI;   break;
+                case 7: ent->op = EX_ANDI;  break;
             }
-            pc_reg += 4;
             break;
         }
         
         // 0x17
-        case OPC_AUIPC: // AUIPC
+        case OPC_AUIPC:
         {
-            if (rd_idx) gp_regs[rd_idx] = pc_reg + u_immed;
-            pc_reg += 4;
+            ent->op  = EX_AUIPC;
+            ent->imm = inst & 0xFFFFF000;
             break;
         }
         
         // 0x23
         case OPC_STORE:
         {
-            mem_addr = uns_rs1 + s_immed;
-            mem_xfer = func3 + 8;
+            ent->imm = ((inst >> 20) & 0x00000FE0)
+                     | ((inst >>  7) & 0x0000001F)
+                     | (sign & 0xFFFFF000);
             switch (func3)
             {
-                case 0: // SB
-                {
-                    mem_data = (uns_rs2 & 0xFF) * 0x01010101;
-                    mem_mask = (vluint8_t)0x1 << (mem_addr & 3);
-                    pc_reg += 4;
-                    break;
-                }
-                case 1: // SH
-                {
-                    if (mem_addr & 1)
-                    {
-                        // Unaligned address
-                        mem_xfer = XFER_NONE;
-                        mem_mask = (vluint8_t)0x0;
-                        except_nr = RAISE_SADDR_ERR;
-                    }
-                    else
-                    {
-                        mem_data = (uns_rs2 & 0xFFFF) * 0x00010001;
-                        mem_mask = (vluint8_t)0x3 << (mem_addr & 2);
-                        pc_reg += 4;
-                    }
-                    break;
-                }
-                case 2: // SW
-                {
-                    if (mem_addr & 3)
-                    {
-                        // Unaligned address
-                        mem_xfer = XFER_NONE;
-                        mem_mask = (vluint8_t)0x0;
-                        except_nr = RAISE_SADDR_ERR;
-                    }
-                    else
-                    {
-                        mem_data = uns_rs2;
-                        mem_mask = (vluint8_t)0xF;
-                        pc_reg += 4;
-                    }
-                    break;
-                }
-                default:
-                {
-                    // Invalid instruction
-                    mem_xfer = XFER_NONE;
-                    mem_mask = (vluint8_t)0x0;
-                    except_nr = RAISE_ILLEGAL;
-                }
+                case 0:  ent->op = EX_SB; break;
+                case 1:  ent->op = EX_SH; break;
+                case 2:  ent->op = EX_SW; break;
+                default: ent->op = EX_ST_ILL;
             }
             break;
         }
@@ -1163,115 +1486,286 @@ void RISCVTrace::riscv_simu_if(vluint32_t addr, vluint32_t inst)
         {
             switch (func3)
             {
-                case 0: // ADD / SUB
+                case 0: ent->op = (GET_BIT(inst,30)) ? EX_SUB : EX_ADD; break;
+                case 1: ent->op = EX_SLL;  break;
+                case 2: ent->op = EX_SLT;  break;
+                case 3: ent->op = EX_SLTU; break;
+                case 4: ent->op = EX_XOR;  break;
+                case 5: ent->op = (GET_BIT(inst,30)) ? EX_SRA : EX_SRL; break;
+                case 6: ent->op = EX_OR;   break;
+                case 7: ent->op = EX_AND;  break;
+            }
+            break;
+        }
+        
+        // 0x37
+        case OPC_LUI:
+        {
+            ent->op  = EX_LUI;
+            ent->imm = inst & 0xFFFFF000;
+            break;
+        }
+        
+        // 0x63
+        case OPC_BRANCH:
+        {
+            ent->imm = ((inst >> 19) & 0x00001000)
+                     | ((inst >> 20) & 0x000007E0)
+                     | ((inst >>  7) & 0x0000001E)
+                     | ((inst <<  4) & 0x00000800)
+                     | (sign & 0xFFFFE000);
+            switch (func3)
+            {
+                case 0:  ent->op = EX_BEQ;  break;
+                case 1:  ent->op = EX_BNE;  break;
+                case 4:  ent->op = EX_BLT;  break;
+                case 5:  ent->op = EX_BGE;  break;
+                case 6:  ent->op = EX_BLTU; break;
+                case 7:  ent->op = EX_BGEU; break;
+                default: ent->op = EX_ILLEGAL;
+            }
+            break;
+        }
+        
+        // 0x67
+        case OPC_JALR:
+        {
+            ent->op  = EX_JALR;
+            ent->imm = i_immed;
+            break;
+        }
+        
+        // 0x6F
+        case OPC_JAL:
+        {
+            ent->op  = EX_JAL;
+            ent->imm = ((inst >> 11) & 0x00100000)
+                     | ((inst >> 20) & 0x000007FE)
+                     | ((inst >>  9) & 0x00000800)
+                     |  (inst        & 0x000FF000)
+                     | (sign & 0xFFE00000);
+            break;
+        }
+        
+        // 0x73
+        case OPC_SYSTEM:
+        {
+            // CSR number
+            ent->imm = i_immed & 0xFFF;
+            switch (func3)
+            {
+                case 0:
                 {
-                    if (rd_idx)
+                    if (ent->rd)
                     {
-                        gp_regs[rd_idx] = (GET_BIT(inst,30))
-                                        ? uns_rs1 - uns_rs2
-                                        : uns_rs1 + uns_rs2;
+                        ent->op = EX_NONE;
+                        break;
                     }
-                    break;
-                }
-                case 1: // SLL
-                {
-                    if (rd_idx) gp_regs[rd_idx] = uns_rs1 << (uns_rs2 & 0x1F);
-                    break;
-                }
-                case 2: // SLT
-                {
-                    if (rd_idx) gp_regs[rd_idx] = (sig_rs1 < sig_rs2) ? 1 : 0;
-                    break;
-                }
-                case 3: // SLTU
-                {
-                    if (rd_idx) gp_regs[rd_idx] = (uns_rs1 < uns_rs2) ? 1 : 0;
-                    break;
-                }
-                case 4: // XOR
-                {
-                    if (rd_idx) gp_regs[rd_idx] = uns_rs1 ^ uns_rs2;
-                    break;
-                }
-                case 5: // SRL / SRA
-                {
-                    if (rd_idx)
+                    switch (ent->imm)
                     {
-                        gp_regs[rd_idx] = (GET_BIT(inst,30))
-                                        ? SRA_32(uns_rs1, uns_rs2 & 0x1F)
-                                        : uns_rs1 >> (uns_rs2 & 0x1F);
+                        case 0x000: ent->op = EX_ECALL;  break;
+                        case 0x001: ent->op = EX_EBREAK; break;
+                        case 0x302: ent->op = EX_MRET;   break;
+                        default:    ent->op = EX_NOP; // WFI, NOP ?
                     }
                     break;
                 }
-                case 6: // OR
-                {
-                    if (rd_idx) gp_regs[rd_idx] = uns_rs1 | uns_rs2;
-                    break;
-                }
-                case 7: // AND
-                {
-                    if (rd_idx) gp_regs[rd_idx] = uns_rs1 & uns_rs2;
-                    break;
-                }
+                case 1: ent->op = EX_CSRRW;  break;
+                case 2: ent->op = EX_CSRRS;  break;
+                case 3: ent->op = EX_CSRRC;  break;
+                // Immediate value (z_immed) in rs1
+                case 5: ent->op = EX_CSRRWI; break;
+                case 6: ent->op = EX_CSRRSI; break;
+                case 7: ent->op = EX_CSRRCI; break;
+                default: ent->op = EX_ILLEGAL;
             }
+            break;
+        }
+        
+        default: ; // Invalid instruction
+    }
+}
+
+void RISCVTrace::riscv_simu_if(vluint32_t addr, vluint32_t inst)
+{
+    pdc_ent_t *ent;
+    
+    vluint32_t imm;
+    vluint32_t uns_rs1;
+    vluint32_t uns_rs2;
+    vluint32_t jmp_addr = 0;
+    bool       branch;
+    
+    if (addr != pc_reg)
+    {
+        mismatch(RISCV_MISM_INST_ADDR, addr, pc_reg);
+    }
+    
+    // Predecoded instruction, decoded again when the fetched word differs
+    ent = &pdc_buf[(addr >> 2) & (PDC_SIZE - 1)];
+    if ((ent->addr != addr) || (ent->inst != inst))
+    {
+        riscv_decode(addr, inst, ent);
+    }
+    
+    rd_idx  = ent->rd;
+    imm     = ent->imm;
+    uns_rs1 = gp_regs[ent->rs1];
+    uns_rs2 = gp_regs[ent->rs2];
+    
+    switch (ent->op)
+    {
+        // Loads
+        case EX_LB:
+        {
+            mem_addr = uns_rs1 + imm;
+            mem_xfer = ent->func3;
+            mem_mask = (vluint8_t)0x1 << (mem_addr & 3);
             pc_reg += 4;
             break;
         }
+        case EX_LH:
+        {
+            mem_addr = uns_rs1 + imm;
+            mem_xfer = ent->func3;
+            if (mem_addr & 1)
+            {
+                // Unaligned address
+                mem_xfer = XFER_NONE;
+                mem_mask = (vluint8_t)0x0;
+                except_nr = RAISE_LADDR_ERR;
+            }
+            else
+            {
+                mem_mask = (vluint8_t)0x3 << (mem_addr & 2);
+                pc_reg += 4;
+            }
+            break;
+        }
+        case EX_LW:
+        {
+            mem_addr = uns_rs1 + imm;
+            mem_xfer = ent->func3;
+            if (mem_addr & 3)
+            {
+                // Unaligned address
+                mem_xfer = XFER_NONE;
+                mem_mask = (vluint8_t)0x0;
+                except_nr = RAISE_LADDR_ERR;
+            }
+            else
+            {
+                mem_mask = (vluint8_t)0xF;
+                pc_reg += 4;
+            }
+            break;
+        }
         
-        // 0x37
-        case OPC_LUI: // LUI
+        // Stores
+        case EX_SB:
         {
-            if (rd_idx) gp_regs[rd_idx] = u_immed;
+            mem_addr = uns_rs1 + imm;
+            mem_xfer = XFER_SB;
+            mem_data = (uns_rs2 & 0xFF) * 0x01010101;
+            mem_mask = (vluint8_t)0x1 << (mem_addr & 3);
             pc_reg += 4;
             break;
         }
+        case EX_SH:
+        {
+            mem_addr = uns_rs1 + imm;
+            mem_xfer = XFER_SH;
+            if (mem_addr & 1)
+            {
+                // Unaligned address
+                mem_xfer = XFER_NONE;
+                mem_mask = (vluint8_t)0x0;
+                except_nr = RAISE_SADDR_ERR;
+            }
+            else
+            {
+                mem_data = (uns_rs2 & 0xFFFF) * 0x00010001;
+                mem_mask = (vluint8_t)0x3 << (mem_addr & 2);
+                pc_reg += 4;
+            }
+            break;
+        }
+        case EX_SW:
+        {
+            mem_addr = uns_rs1 + imm;
+            mem_xfer = XFER_SW;
+            if (mem_addr & 3)
+            {
+                // Unaligned address
+                mem_xfer = XFER_NONE;
+                mem_mask = (vluint8_t)0x0;
+                except_nr = RAISE_SADDR_ERR;
+            }
+            else
+            {
+                mem_data = uns_rs2;
+                mem_mask = (vluint8_t)0xF;
+                pc_reg += 4;
+            }
+            break;
+        }
         
-        // 0x63
-        case OPC_BRANCH:
+        // Invalid loads / stores
+        case EX_LD_ILL:
+        case EX_ST_ILL:
         {
-            bool branch;
-            
-            jmp_addr = pc_reg + b_immed;
-            switch (func3)
+            mem_addr = uns_rs1 + imm;
+            mem_xfer = XFER_NONE;
+            mem_mask = (vluint8_t)0x0;
+            except_nr = RAISE_ILLEGAL;
+            break;
+        }
+        
+        // Register / immediate
+        case EX_ADDI:  if (rd_idx) gp_regs[rd_idx] = uns_rs1 + imm;                          pc_reg += 4; break;
+        case EX_SLLI:  if (rd_idx) gp_regs[rd_idx] = uns_rs1 << imm;                         pc_reg += 4; break;
+        case EX_SLTI:  if (rd_idx) gp_regs[rd_idx] = ((vlsint32_t)uns_rs1 < (vlsint32_t)imm) ? 1 : 0; pc_reg += 4; break;
+        case EX_SLTIU: if (rd_idx) gp_regs[rd_idx] = (uns_rs1 < imm) ? 1 : 0;                pc_reg += 4; break;
+        case EX_XORI:  if (rd_idx) gp_regs[rd_idx] = uns_rs1 ^ imm;                          pc_reg += 4; break;
+        case EX_SRLI:  if (rd_idx) gp_regs[rd_idx] = uns_rs1 >> imm;                         pc_reg += 4; break;
+        case EX_SRAI:  if (rd_idx) gp_regs[rd_idx] = SRA_32(uns_rs1, imm);                   pc_reg += 4; break;
+        case EX_ORI:   if (rd_idx) gp_regs[rd_idx] = uns_rs1 | imm;                          pc_reg += 4; break;
+        case EX_ANDI:  if (rd_idx) gp_regs[rd_idx] = uns_rs1 & imm;                          pc_reg += 4; break;
+        
+        // Register / register
+        case EX_ADD:   if (rd_idx) gp_regs[rd_idx] = uns_rs1 + uns_rs2;                      pc_reg += 4; break;
+        case EX_SUB:   if (rd_idx) gp_regs[rd_idx] = uns_rs1 - uns_rs2;                      pc_reg += 4; break;
+        case EX_SLL:   if (rd_idx) gp_regs[rd_idx] = uns_rs1 << (uns_rs2 & 0x1F);            pc_reg += 4; break;
+        case EX_SLT:   if (rd_idx) gp_regs[rd_idx] = ((vlsint32_t)uns_rs1 < (vlsint32_t)uns_rs2) ? 1 : 0; pc_reg += 4; break;
+        case EX_SLTU:  if (rd_idx) gp_regs[rd_idx] = (uns_rs1 < uns_rs2) ? 1 : 0;            pc_reg += 4; break;
+        case EX_XOR:   if (rd_idx) gp_regs[rd_idx] = uns_rs1 ^ uns_rs2;                      pc_reg += 4; break;
+        case EX_SRL:   if (rd_idx) gp_regs[rd_idx] = uns_rs1 >> (uns_rs2 & 0x1F);            pc_reg += 4; break;
+        case EX_SRA:   if (rd_idx) gp_regs[rd_idx] = SRA_32(uns_rs1, uns_rs2 & 0x1F);        pc_reg += 4; break;
+        case EX_OR:    if (rd_idx) gp_regs[rd_idx] = uns_rs1 | uns_rs2;                      pc_reg += 4; break;
+        case EX_AND:   if (rd_idx) gp_regs[rd_idx] = uns_rs1 & uns_rs2;                      pc_reg += 4; break;
+        
+        // Upper immediate
+        case EX_LUI:   if (rd_idx) gp_regs[rd_idx] = imm;                                    pc_reg += 4; break;
+        case EX_AUIPC: if (rd_idx) gp_regs[rd_idx] = pc_reg + imm;                           pc_reg += 4; break;
+        
+        // Branches
+        case EX_BEQ:
+        case EX_BNE:
+        case EX_BLT:
+        case EX_BGE:
+        case EX_BLTU:
+        case EX_BGEU:
+        {
+            switch (ent->op)
             {
-                case 0: // BEQ
-                {
-                    branch = (uns_rs1 == uns_rs2) ? true : false;
-                    break;
-                }
-                case 1: // BNE
-                {
-                    branch = (uns_rs1 != uns_rs2) ? true : false;
-                    break;
-                }
-                case 4: // BLT
-                {
-                    branch = (sig_rs1 < sig_rs2) ? true : false;
-                    break;
-                }
-                case 5: // BGE
-                {
-                    branch = (sig_rs1 >= sig_rs2) ? true : false;
-                    break;
-                }
-                case 6: // BLTU
-                {
-                    branch = (uns_rs1 < uns_rs2) ? true : false;
-                    break;
-                }
-                case 7: // BGEU
-                {
-                    branch = (uns_rs1 >= uns_rs2) ? true : false;
-                    break;
-                }
-                default:
-                {
-                    // Invalid instruction
-                    except_nr = RAISE_ILLEGAL;
-                    branch = false;
-                }
+                case EX_BEQ:  branch = (uns_rs1 == uns_rs2); break;
+                case EX_BNE:  branch = (uns_rs1 != uns_rs2); break;
+                case EX_BLT:  branch = ((vlsint32_t)uns_rs1 <  (vlsint32_t)uns_rs2); break;
+                case EX_BGE:  branch = ((vlsint32_t)uns_rs1 >= (vlsint32_t)uns_rs2); break;
+                case EX_BLTU: branch = (uns_rs1 <  uns_rs2); break;
+                default:      branch = (uns_rs1 >= uns_rs2);
             }
-            
+            jmp_addr = pc_reg + imm;
             if (branch)
             {
                 if (jmp_addr & 3)
@@ -1285,17 +1779,16 @@ void RISCVTrace::riscv_simu_if(vluint32_t addr, vluint32_t inst)
             }
             else
             {
-                if (except_nr == RAISE_NONE) pc_reg += 4;
+                pc_reg += 4;
             }
-            
             break;
         }
         
-        // 0x67
-        case OPC_JALR: // JALR
+        // Jumps
+        case EX_JALR:
         {
             if (rd_idx) gp_regs[rd_idx] = pc_reg + 4;
-            jmp_addr = (uns_rs1 + i_immed) & 0xFFFFFFFE;
+            jmp_addr = (uns_rs1 + imm) & 0xFFFFFFFE;
             if (jmp_addr & 2)
             {
                 except_nr = RAISE_IADDR_ERR;
@@ -1306,12 +1799,10 @@ void RISCVTrace::riscv_simu_if(vluint32_t addr, vluint32_t inst)
             }
             break;
         }
-        
-        // 0x6F
-        case OPC_JAL: // JAL
+        case EX_JAL:
         {
             if (rd_idx) gp_regs[rd_idx] = pc_reg + 4;
-            jmp_addr = pc_reg + j_immed;
+            jmp_addr = pc_reg + imm;
             if (jmp_addr & 3)
             {
                 except_nr = RAISE_IADDR_ERR;
@@ -1323,98 +1814,37 @@ void RISCVTrace::riscv_simu_if(vluint32_t addr, vluint32_t inst)
             break;
         }
         
-        // 0x73
-        case OPC_SYSTEM:
+        // System
+        case EX_NOP:    pc_reg += 4;                     break;
+        case EX_ECALL:  except_nr = RAISE_ECALL;         break;
+        case EX_EBREAK: except_nr = RAISE_EBREAK;        break;
+        case EX_MRET:   pc_reg = csr_regs[CSR_MEPC];     break;
+        case EX_NONE:                                    break;
+        
+        // CSR access (imm : CSR number)
+        case EX_CSRRW:
+        case EX_CSRRS:
+        case EX_CSRRC:
+        case EX_CSRRWI:
+        case EX_CSRRSI:
+        case EX_CSRRCI:
         {
-            int csr = i_immed & 0xFFF;
+            // Immediate value (z_immed) or register
+            vluint32_t val = (ent->op >= EX_CSRRWI) ? (vluint32_t)ent->rs1 : uns_rs1;
             
-            switch (func3)
+            if (rd_idx) gp_regs[rd_idx] = csr_regs[imm];
+            switch (ent->op)
             {
-                case 0:
-                {
-                    if (!rd_idx) // ECALL, EBREAK, MRET, WFI
-                    {
-                        switch (csr)
-                        {
-                            case 0x000: // ECALL
-                            {
-                                except_nr = RAISE_ECALL;
-                                break;
-                            }
-                            case 0x001: // EBREAK
-                            {
-                                except_nr = RAISE_EBREAK;
-                                break;
-                            }
-                            case 0x105: // WFI (NOP)
-                            {
-                                pc_reg += 4;
-                                break;
-                            }
-                            case 0x302: // MRET
-                            {
-                                pc_reg = csr_regs[CSR_MEPC];
-                                break;
-                            }
-                            default: // NOP ?
-                            {
-                                pc_reg += 4;
-                            }
-                        }
-                    }
-                    break;
-                }
-                case 1: // CSRRW
-                {
-                    if (rd_idx) gp_regs[rd_idx] = csr_regs[csr];
-                    csr_regs[csr] = uns_rs1;
-                    pc_reg += 4;
-                    break;
-                }
-                case 2: // CSRRS
-                {
-                    if (rd_idx) gp_regs[rd_idx] = csr_regs[csr];
-                    csr_regs[csr] |= uns_rs1;
-                    pc_reg += 4;
-                    break;
-                }
-                case 3: // CSRRC
-                {
-                    if (rd_idx) gp_regs[rd_idx] = csr_regs[csr];
-                    csr_regs[csr] &= ~uns_rs1;
-                    pc_reg += 4;
-                    break;
-                }
-                case 5: // CSRRWI
-                {
-                    if (rd_idx) gp_regs[rd_idx] = csr_regs[csr];
-                    csr_regs[csr] = z_immed;
-                    pc_reg += 4;
-                    break;
-                }
-                case 6: // CSRRSI
-                {
-                    if (rd_idx) gp_regs[rd_idx] = csr_regs[csr];
-                    csr_regs[csr] |= z_immed;
-                    pc_reg += 4;
-                    break;
-                }
-                case 7: // CSRRCI
-                {
-                    if (rd_idx) gp_regs[rd_idx] = csr_regs[csr];
-                    csr_regs[csr] &= ~z_immed;
-                    pc_reg += 4;
-                    break;
-                }
-                default:
-                {
-                    // Invalid instruction
-                    except_nr = RAISE_ILLEGAL;
-                }
+                case EX_CSRRW:
+                case EX_CSRRWI: csr_regs[imm]  = val; break;
+                case EX_CSRRS:
+                case EX_CSRRSI: csr_regs[imm] |= val; break;
+                default:        csr_regs[imm] &= ~val;
             }
+            pc_reg += 4;
             break;
         }
-
+        
         default:
         {
             // Invalid instruction
@@ -1461,8 +1891,7 @@ void RISCVTrace::riscv_simu_rd(vluint32_t addr, vluint32_t data)
     //if (addr != (mem_addr & 0xFFFFFFFC))
     if (addr != mem_addr)
     {
-        fprintf(tfh, "!!! DATA ADDRESS MISMATCH !!!\n");
-        fprintf(tfh, "Verilog : %08X, C-Model : %08X\n", addr, mem_addr);
+        mismatch(RISCV_MISM_DATA_ADDR, addr, mem_addr);
     }
     
     switch (mem_xfer)
@@ -1528,7 +1957,7 @@ void RISCVTrace::riscv_simu_rd(vluint32_t addr, vluint32_t data)
         }
         default:
         {
-            fprintf(tfh, "!!! DATA TRANSFER TYPE MISMATCH !!!\n");
+            mismatch(RISCV_MISM_DATA_TYPE, 0, 0);
         }
     }
     mem_xfer = XFER_NONE;
@@ -1540,20 +1969,17 @@ void RISCVTrace::riscv_simu_wr(vluint32_t addr, vluint32_t data, vluint8_t mask)
     //if (addr != (mem_addr & 0xFFFFFFFC))
     if (addr != mem_addr)
     {
-        fprintf(tfh, "!!! DATA ADDRESS MISMATCH !!!\n");
-        fprintf(tfh, "Verilog : %08X, C-Model : %08X\n", addr, mem_addr);
+        mismatch(RISCV_MISM_DATA_ADDR, addr, mem_addr);
     }
     
     if (data != mem_data)
     {
-        fprintf(tfh, "!!! DATA VALUE MISMATCH !!!\n");
-        fprintf(tfh, "Verilog : %08X, C-Model : %08X\n", data, mem_data);
+        mismatch(RISCV_MISM_DATA_VAL, data, mem_data);
     }
     
     if (mask != mem_mask)
     {
-        fprintf(tfh, "!!! DATA MASK MISMATCH !!!\n");
-        fprintf(tfh, "Verilog : %1X, C-Model : %1X\n", mask, mem_mask);
+        mismatch(RISCV_MISM_DATA_MASK, mask, mem_mask);
     }
     mem_xfer = XFER_NONE;
 }
\ No newline at end of file
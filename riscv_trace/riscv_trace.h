@@ -24,11 +24,21 @@
 //  - It is intended to be connected to a RISC-V verilog core
 //  - It supports segmented traces
 //  - Memory footprint is minimal
+//  - It can write a compact binary trace instead of text (see riscv_log.h)
+//  - Binary traces are converted back to text offline by "riscv_logdec"
+//  - Trace can be formatted and written by a background thread
+//    (needs "trace_writer.h" and "trace_common.h" from ring_buffer)
+//  - Mismatch-only mode : instruction history kept in memory, written
+//    out on a mismatch
+//  - Instructions are predecoded once and cached (keyed by PC and word)
+//  - Disassembly is done only for the text trace, and cached
 
 #ifndef _RISCV_TRACE_H_
 #define _RISCV_TRACE_H_
 
 #include "verilated.h"
+#include "riscv_log.h"
+#include "trace_common.h"
 #include <stdlib.h>
 #include <stdio.h>
 
@@ -39,9 +49,12 @@ class RISCVTrace
         RISCVTrace(vluint32_t reset_vect, vluint32_t comp_data_beg, vluint32_t comp_data_end);
         ~RISCVTrace();
         // Methods
-        int  open(const char *name);
+        int  open(const char *name, bool bin = false);
         int  openNext(void);
         void close(void);
+        int  setAsync(int buf_log2, int policy);
+        void getAsyncStats(vluint64_t &records, vluint64_t &drops, vluint64_t &stalls);
+        void setHistory(int depth, int after);
         void dump(vluint64_t stamp,     vluint8_t  clk,
                   vluint8_t  i_rd_ack,  vluint32_t i_address, vluint32_t i_rddata,
                   vluint8_t  d_rd_ack,  vluint8_t  d_wr_ack,  vluint32_t d_address,
@@ -49,14 +62,52 @@ class RISCVTrace
                   vluint32_t inr_ir_irq,
                   vluint8_t  wb_ena,    vluint8_t  wb_idx,    vluint32_t wb_data);
         char disasm(vluint32_t inst, vluint32_t pc, int idx);
+        void disasm(char *buf, vluint32_t inst, vluint32_t pc);
     private:
         // Utility functions
         char       *uhex_to_str(vluint32_t val, int dig);
         char       *shex_to_str(vluint32_t val, int dig);
         char       *get_csr_str(int csr);
+        // Binary trace
+        void        bin_start(void);
+        void        bin_flush(void);
+        void        bin_fetch(vluint64_t stamp, vluint32_t i_address, vluint32_t i_rddata,
+                              vluint32_t pc, const vluint32_t *regs);
+        void        bin_mem(vluint64_t stamp, int type, vluint32_t addr, vluint32_t data, vluint8_t mask);
+        // Trace / simulation mismatch (text or binary)
+        void        mismatch(int kind, vluint32_t v_val, vluint32_t c_val);
+        // Trace records (text, binary or writer thread)
+        void        trace_fetch(vluint32_t i_address, vluint32_t i_rddata);
+        void        trace_mem(int type, vluint32_t addr, vluint32_t data, vluint8_t mask);
+        void        out_fetch(vluint64_t stamp, vluint32_t i_address, vluint32_t i_rddata,
+                              vluint32_t pc, const vluint32_t *regs);
+        void        out_mem(vluint64_t stamp, int type, vluint32_t addr, vluint32_t data, vluint8_t mask);
+        // Instruction history (mismatch-only trace)
+        void        hist_reset(void);
+        void        hist_evict(void);
+        void        hist_put(int type, vluint32_t addr, vluint32_t data, vluint8_t mask);
+        void        hist_fetch(vluint32_t i_address, vluint32_t i_rddata);
+        void        hist_dump(void);
+        // Text trace
+        void        print_fetch(FILE *fh, vluint64_t stamp, vluint32_t i_address, vluint32_t i_rddata,
+                                vluint32_t pc, const vluint32_t *regs);
+        static void async_fmt(void *ctx, FILE *fh, int type, const vluint8_t *rec, int len);
         // RISC-V disassembler
         void        riscv_dasm(char *buf, vluint32_t inst, vluint32_t pc);
+        TraceDasm<RISCVTrace> *dac;
         // RISC-V simulator
+        typedef struct
+        {
+            vluint32_t addr;  // Fetch address
+            vluint32_t inst;  // Instruction word
+            vluint32_t imm;   // Immediate value (or CSR number)
+            vluint8_t  op;    // Operation (EX_xxx)
+            vluint8_t  rd;    // Destination register
+            vluint8_t  rs1;   // Source registers
+            vluint8_t  rs2;
+            vluint8_t  func3; // Load transfer type
+        } pdc_ent_t;
+        void        riscv_decode(vluint32_t addr, vluint32_t inst, pdc_ent_t *ent);
         void        riscv_simu_if(vluint32_t addr, vluint32_t inst);
         void        riscv_simu_rd(vluint32_t addr, vluint32_t data);
         void        riscv_simu_wr(vluint32_t addr, vluint32_t data, vluint8_t mask);
@@ -69,6 +120,8 @@ class RISCVTrace
         vluint32_t  test_stop;
         vluint32_t  test_size;
         vluint8_t  *test_ptr;
+        // Predecode cache
+        pdc_ent_t  *pdc_buf;
         // CSR registers
         vluint32_t  csr_regs[4096];
         // Disassembly buffer
@@ -76,6 +129,39 @@ class RISCVTrace
         // Trace file handle
         char        tname[256];
         FILE       *tfh;
+        // Binary trace : mode, record buffer and last encoded values
+        bool        bin_mode;
+        bool        bin_on;
+        vluint64_t  bin_now;
+        vluint8_t  *bin_buf;
+        int         bin_len;
+        vluint64_t  bin_ts;
+        vluint32_t  bin_pc;
+        vluint32_t  bin_addr;
+        vluint32_t  bin_regs[32];
+        // Writer thread
+        TraceWriter *twr;
+        bool        async_on;
+        // Instruction history : records ring, window and following instructions
+        typedef struct
+        {
+            vluint64_t stamp;
+            vluint32_t addr;
+            vluint32_t data;
+            vluint32_t pc;
+            vluint8_t  type;
+            vluint8_t  mask;
+        } hist_rec_t;
+        hist_rec_t *hist_buf;
+        vluint64_t  hist_size;
+        vluint64_t  hist_rd;
+        vluint64_t  hist_wr;
+        int         hist_cnt;
+        int         hist_depth;
+        int         hist_post;
+        int         hist_after;
+        vluint32_t  hist_base[32];
+        vluint32_t  hist_regs[32];
         // Output file handle
         char        oname[256];
         FILE       *ofh;
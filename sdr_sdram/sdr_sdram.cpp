@@ -27,13 +27,35 @@
 //  - Debug mode to trace every SDRAM access
 //  - Endianness support for 16, 32 and 64-bit memories
 //  - Direct read/write memory access to use with DPI shortcut in controller
+//  - Sparse mode : pages are allocated and initialized on first access
+//  - Reproducible random fill (seeded, computed per address, multi-threaded)
+//  - Memory mapped image load/save (one copy per bank when possible)
+//  - Compile-time specialized front end (SDRAMT) for inlined direct accesses
+//  - Block transfers (read/write/fill/compare) with DPI-C wrappers
+//  - Idle cycles and falling edges evaluated inline (no call)
+//  - Binary command/data log written by a background thread
+//  - Performance counters (per bank, row histogram, bandwidth) in CSV/JSON
+//  - Transaction level bursts (no pin-level protocol) on the same arrays
+//  - Copy-on-write snapshot/restore with dirty pages tracking
+//  - 64-bit addresses, huge pages backed arrays
+//  - Multi-chip ranks and chip selects (SDRAMArray) with one command decode
+//  - Address watchpoints on bursts and direct accesses (callback or log)
+//  - Parallel memory digest (per page hashes) and diff against an image file
+//  - IDD based energy estimation (per bank, per window, power-down residency)
 //
 
 #include "verilated.h"
 #include "sdr_sdram.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sched.h>
+#include <thread>
 
 // SDRAM commands
 #define CMD_LMR  ((vluint8_t)0)
@@ -133,10 +155,48 @@ static const int c_col_int[8][8] =
     { 0, 6, 4, 6, 0, 6, 4, 6 }  // col = 7
 };
 
+// Page states (sparse mode and snapshot)
+#define PAGE_EMPTY ((vluint8_t)0x00)
+#define PAGE_INIT  ((vluint8_t)0x01) // Accessible
+#define PAGE_WP    ((vluint8_t)0x02) // Read-only : saved on first write
+#define PAGE_DIRTY ((vluint8_t)0x04) // Written since the snapshot
+#define PAGE_NEW   ((vluint8_t)0x08) // Empty at snapshot time
+
+// Image load/save on several threads
+#define IMAGE_MAX_THREADS  (8)
+#define IMAGE_MT_THRESHOLD ((vluint64_t)16 << 20)
+
+// Memory hashing (xxHash64 style mixing, not compatible with it)
+#define HASH_P1 (0x9E3779B185EBCA87ULL)
+#define HASH_P2 (0xC2B2AE3D27D4EB4FULL)
+#define HASH_P3 (0x165667B19E3779F9ULL)
+
+// Energy estimation defaults (MT48LC8M16A2-75 like device, 133 MHz)
+static const sdram_power_t c_power_default =
+{
+    3.3,                    // vdd
+    7.5, 66.0, 44.0, 66.0,  // t_ck, t_rc, t_ras, t_rfc
+    110.0,                  // idd0
+    35.0, 2.0,              // idd2n, idd2p
+    45.0, 10.0,             // idd3n, idd3p
+    115.0, 115.0,           // idd4r, idd4w
+    215.0, 2.0,             // idd5, idd6
+    1                       // chips
+};
+
+// Longest bus turnaround (cycles)
+#define STATS_TURN_MAX     (8)
+
+// SDRAM instances using the sparse mode
+static SDRAM           *s_sparse_inst[SDRAM_MAX_SPARSE];
+static struct sigaction s_prev_action;
+static bool             s_handler_on = false;
+
 // Constructor
-SDRAM::SDRAM(vluint8_t log2_rows, vluint8_t log2_cols, vluint8_t flags, const char *logfile)
+SDRAM::SDRAM(vluint8_t log2_rows, vluint8_t log2_cols, vluint8_t flags, const char *logfile,
+             vluint64_t seed)
 {
-    int bnk_size;
+    vluint64_t bnk_size;
     // SDRAM capacity initialized
     bus_mask    =  flags & (DATA_MSB | DATA_MSW | DATA_MSL);
     bus_log2    = (flags & DATA_MSB) ? 1 : 0;
@@ -146,9 +206,9 @@ SDRAM::SDRAM(vluint8_t log2_rows, vluint8_t log2_cols, vluint8_t flags, const ch
     bit_cols    = (int)log2_cols;
     num_rows    = (int)1 << log2_rows;
     num_cols    = (int)1 << log2_cols;
-    mask_rows   = (vluint32_t)(num_rows - 1) << log2_cols;
-    mask_bank   = (vluint32_t)(SDRAM_NUM_BANKS - 1) << log2_cols;
-    mask_cols   = (vluint32_t)(num_cols - 1);
+    mask_rows   = (vluint64_t)(num_rows - 1) << log2_cols;
+    mask_bank   = (vluint64_t)(SDRAM_NUM_BANKS - 1) << log2_cols;
+    mask_cols   = (vluint64_t)(num_cols - 1);
     if (flags & FLAG_BANK_INTERLEAVING)
     {
         // Banks are interleaved
@@ -164,12 +224,12 @@ SDRAM::SDRAM(vluint8_t log2_rows, vluint8_t log2_cols, vluint8_t flags, const ch
         mask_bank <<= log2_rows;
     }
     // Bank size (in bytes)
-    bnk_size = (int)1 << (log2_rows + log2_cols + bus_log2);
+    bnk_size = (vluint64_t)1 << (log2_rows + log2_cols + bus_log2);
     // Memory size (in bytes)
     mem_size = bnk_size << SDRAM_BIT_BANKS;
     // Init message
-    printf("Instantiating %d MB SDRAM : %d banks x %d rows x %d cols x %d bits\n",
-            mem_size >> 20, SDRAM_NUM_BANKS, num_rows, num_cols, 8 << bus_log2);
+    printf("Instantiating %llu MB SDRAM : %d banks x %d rows x %d cols x %d bits\n",
+            (unsigned long long)(mem_size >> 20), SDRAM_NUM_BANKS, num_rows, num_cols, 8 << bus_log2);
     // Memory read functions
     switch (flags & (FLAG_BANK_INTERLEAVING | FLAG_BIG_ENDIAN))
     {
@@ -250,9 +310,35 @@ SDRAM::SDRAM(vluint8_t log2_rows, vluint8_t log2_cols, vluint8_t flags, const ch
         log_size = 0;
         dbg_on   = false;
     }
+    blog_on       = false;
+    blog_fh       = (FILE *)NULL;
+    blog_thr      = (std::thread *)NULL;
+    
+    // watchpoints
+    watch_on      = false;
+    watch_map     = (vluint64_t *)NULL;
+    watch_cb      = (sdram_watch_cb_t)NULL;
+    watch_user    = NULL;
+    watch_hits    = 0;
+    watch_ts      = 0;
+    watch_id      = 0;
+    
+    // performance counters
+    stats_on      = false;
+    st_name       = (char *)NULL;
+    st_hist       = (vluint32_t *)NULL;
+    st_window     = 0;
+    st_cyc        = 0;
+    pw            = c_power_default;
     
     // special flags
     mem_flags     = flags;
+    // Byte lanes are swapped when the memory and the host endianness differ
+#if BYTE_ORDER == LITTLE_ENDIAN
+    lane_xor      = (flags & FLAG_BIG_ENDIAN) ? bus_mask : 0;
+#else
+    lane_xor      = (flags & FLAG_BIG_ENDIAN) ? 0 : bus_mask;
+#endif
     
     // mode register cleared
     cas_lat       = 0;
@@ -283,1016 +369,2916 @@ SDRAM::SDRAM(vluint8_t log2_rows, vluint8_t log2_cols, vluint8_t flags, const ch
     col         = (int)0;
     bst_ctr_rd  = (int)0;
     bst_ctr_wr  = (int)0;
+    prev_cke    = (vluint8_t)1;
+    st_cke_mode = -1;
+    reset_stats();
+
+    // Initialization mode
+    fill_mode     = (flags & FLAG_RANDOM_FILLED) ? FILL_RANDOM : FILL_ZERO;
+    fill_value    = (vluint64_t)0;
+    fill_seed     = (seed) ? seed : (vluint64_t)time(NULL);
+    if (fill_mode == FILL_RANDOM)
+    {
+        printf("SDRAM random seed : 0x%016llX\n", (unsigned long long)fill_seed);
+    }
 
-    // one array per bank (4 arrays)
-    for (int b = 0; b < SDRAM_NUM_BANKS; b++) // bank
+    // one mapping for all the banks : zeroed pages are provided by the kernel
+    page_log2     = __builtin_ctzl(sysconf(_SC_PAGESIZE));
+    map_size      = mem_size;
+    sparse_on     = (flags & FLAG_SPARSE_MEMORY) ? true : false;
+    page_state    = (vluint8_t *)NULL;
+    fault_lock    = 0;
+    mem_base      = (vluint8_t *)MAP_FAILED;
+    init_base     = (vluint8_t *)MAP_FAILED;
+    mem_fd        = -1;
+    if (sparse_on)
     {
-        array_u64[b] = (vluint64_t *)new vluint64_t[bnk_size/sizeof(vluint64_t)];
-        array_u32[b] = (vluint32_t *)array_u64[b];
-        array_u16[b] = (vluint16_t *)array_u64[b];
-        array_u8[b]  = (vluint8_t *)array_u64[b];
+        // Address space only : pages are initialized on first access
+        // Memory object with two views : the pages are filled through the
+        // second one before they become accessible in the first one
+        mem_fd = memfd_create("sdram", MFD_CLOEXEC);
+        if ((mem_fd >= 0) && (!ftruncate(mem_fd, (off_t)map_size)))
+        {
+            mem_base  = (vluint8_t *)mmap(NULL, map_size, PROT_NONE,
+                                          MAP_SHARED | MAP_NORESERVE, mem_fd, 0);
+            init_base = (vluint8_t *)mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+                                          MAP_SHARED | MAP_NORESERVE, mem_fd, 0);
+        }
+        if ((mem_base == (vluint8_t *)MAP_FAILED) || (init_base == (vluint8_t *)MAP_FAILED))
+        {
+            printf("SDRAM sparse mode not available !!\n");
+            if (mem_base  != (vluint8_t *)MAP_FAILED) munmap((void *)mem_base, map_size);
+            if (init_base != (vluint8_t *)MAP_FAILED) munmap((void *)init_base, map_size);
+            if (mem_fd >= 0) close(mem_fd);
+            mem_base  = (vluint8_t *)MAP_FAILED;
+            init_base = (vluint8_t *)MAP_FAILED;
+            mem_fd    = -1;
+            sparse_on = false;
+        }
     }
-    
-    if (flags & FLAG_RANDOM_FILLED)
+    if (!sparse_on)
     {
-        // fill the arrays with random numbers
-        srand (time (NULL));
-        for (int b = 0; b < SDRAM_NUM_BANKS; b++) // bank
+        // Reserved huge pages : fewer TLB misses on random accesses
+        if ((flags & FLAG_HUGE_PAGES) && (!(map_size & (((vluint64_t)1 << SDRAM_HUGE_PAGE_LOG2) - 1))))
+        {
+            mem_base = (vluint8_t *)mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+                                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (mem_base != (vluint8_t *)MAP_FAILED)
+            {
+                page_log2 = SDRAM_HUGE_PAGE_LOG2;
+                printf("SDRAM huge pages : %llu pages of %d KB\n",
+                       (unsigned long long)(map_size >> page_log2), 1 << (page_log2 - 10));
+            }
+            else
+            {
+                printf("SDRAM huge pages not available, using transparent huge pages\n");
+            }
+        }
+        if (mem_base == (vluint8_t *)MAP_FAILED)
         {
-            for (int a = 0; a < bnk_size; a++) // array
+            mem_base = (vluint8_t *)mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+                                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            // Transparent huge pages (if enabled in "madvise" mode)
+            if (mem_base != (vluint8_t *)MAP_FAILED)
             {
-                array_u8[b][a] = (vluint8_t)rand() & 0xFF;
+                madvise((void *)mem_base, map_size, MADV_HUGEPAGE);
             }
         }
     }
-    else
+    if (mem_base == (vluint8_t *)MAP_FAILED)
+    {
+        printf("Cannot allocate %llu MB of SDRAM !!\n", (unsigned long long)(mem_size >> 20));
+        exit(1);
+    }
+    num_pages     = (map_size + ((vluint64_t)1 << page_log2) - 1) >> page_log2;
+    if (sparse_on)
     {
-        // clear the arrays
-        for (int b = 0; b < SDRAM_NUM_BANKS; b++) // bank
+        page_state = new vluint8_t[num_pages];
+        memset((void *)page_state, PAGE_EMPTY, num_pages);
+        if (register_inst())
         {
-            memset((void *)array_u8[b], 0, bnk_size);
+            // No page fault handling : every page is accessible
+            printf("SDRAM sparse mode not available !!\n");
+            mprotect((void *)mem_base, map_size, PROT_READ | PROT_WRITE);
+            delete[] page_state;
+            page_state = (vluint8_t *)NULL;
+            sparse_on  = false;
         }
+        else
+        {
+            printf("SDRAM sparse mode : %d pages of %d bytes reserved\n",
+                   (int)num_pages, 1 << page_log2);
+        }
+    }
+    // No snapshot yet
+    snap_base     = (vluint8_t *)NULL;
+    snap_on       = false;
+
+    // one array per bank (4 arrays)
+    for (int b = 0; b < SDRAM_NUM_BANKS; b++) // bank
+    {
+        array_u8[b]  = mem_base + (vluint64_t)b * bnk_size;
+        array_u16[b] = (vluint16_t *)array_u8[b];
+        array_u32[b] = (vluint32_t *)array_u8[b];
+        array_u64[b] = (vluint64_t *)array_u8[b];
+    }
+
+    // fill the arrays with random numbers (only on first access in sparse mode)
+    if ((fill_mode == FILL_RANDOM) && (!sparse_on))
+    {
+        fill_all();
     }
 }
 
 // Destructor
 SDRAM::~SDRAM()
 {
+    close_bin_log();
+    if (st_name)
+    {
+        save_stats(st_name);
+        delete[] st_name;
+    }
+    delete[] st_hist;
+    delete[] watch_map;
+    if (watch_hits)
+    {
+        printf("SDRAM watchpoint hits : %llu\n", (unsigned long long)watch_hits);
+    }
+
+    // Memory footprint
+    printf("SDRAM resident size : %llu KB / %llu KB\n",
+           (unsigned long long)(resident_size() >> 10),
+           (unsigned long long)(map_size >> 10));
+
+    // unregister the instance
+    if (page_state)
+    {
+        unregister_inst();
+        delete[] page_state;
+    }
+
     // free the memory
     for (int b = 0; b < SDRAM_NUM_BANKS; b++) // bank
     {
         array_u64[b] = (vluint64_t *)NULL;
         array_u32[b] = (vluint32_t *)NULL;
         array_u16[b] = (vluint16_t *)NULL;
-        delete[] array_u8[b];
+        array_u8[b]  = (vluint8_t *)NULL;
     }
+    munmap((void *)mem_base, map_size);
+    if (init_base != (vluint8_t *)MAP_FAILED) munmap((void *)init_base, map_size);
+    if (mem_fd >= 0) close(mem_fd);
+    if (snap_base) munmap((void *)snap_base, map_size);
 }
 
-// Binary file loading
-void SDRAM::load(const char *name, vluint32_t size, vluint32_t addr)
+// Random value of a 64-bit word (splitmix64, counter based)
+// The value only depends on the seed and on the word position
+static inline vluint64_t rand_u64(vluint64_t seed, vluint64_t idx)
 {
-    FILE *fh;
-    
-    fh = fopen(name, "rb");
-    if (fh)
-    {
-        int        row_size; // Row size (num_cols * 1, 2 or 4)
-        vluint8_t *row_buf;  // Row buffer
-        int        row_pos;  // Row position (0 to num_rows - 1)
-        int        bank_nr;  // Bank number (0 to 3)
-        int        idx;      // Array index (0 to num_cols * num_rows - 1)
-        
-        // Row size computation based on data bus width
-        row_size = (int)1 << (bit_cols + bus_log2);
-        // Allocate one full row
-        row_buf = new vluint8_t[row_size];
-        
-        // Row position
-        row_pos = (int)addr >> (bit_cols + bus_log2);
-        // Banks layout
-        if (mem_flags & FLAG_BANK_INTERLEAVING)
-        {
-            // Banks are interleaved
-            bank_nr = row_pos & (SDRAM_NUM_BANKS - 1);
-            row_pos = row_pos >> SDRAM_BIT_BANKS;
-        }
-        else
-        {
-            // Banks are contiguous
-            bank_nr = row_pos >> bit_rows;
-            row_pos = row_pos & (num_rows - 1);
-        }
-        idx = row_pos << (bit_cols + bus_log2);
-        
-        printf("Starting row : %d, starting bank : %d\n", row_pos, bank_nr);
-        printf("Loading 0x%08lX bytes @ 0x%08lX from binary file \"%s\"...", size, addr, name);
-        for (int r = 0; r < (int)size; r += row_size) // row
+    vluint64_t z = seed + (idx + 1) * 0x9E3779B97F4A7C15ULL;
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Fill a memory range with the initialization pattern
+void SDRAM::fill_range(vluint8_t *ptr, vluint64_t size)
+{
+    fill_copy(ptr, (vluint64_t)(ptr - mem_base), size);
+}
+
+// Initialization pattern of the memory range at "offs", written to "ptr"
+void SDRAM::fill_copy(vluint8_t *ptr, vluint64_t offs, vluint64_t size)
+{
+    switch (fill_mode)
+    {
+        case FILL_RANDOM :
         {
-            // Read one full row from the binary file
-            fread((void *)row_buf, row_size, 1, fh);
-            
-            // Here, we take care of the endianness
-            if (mem_flags & FLAG_BIG_ENDIAN)
-            {
-                // MSB first (motorola's way)
-                for (int c = 0; c < row_size; c++) // column
-                {
-                #if BYTE_ORDER == LITTLE_ENDIAN
-                    array_u8[bank_nr][idx ^ bus_mask] = row_buf[c];
-                #else
-                    array_u8[bank_nr][idx] = row_buf[c];
-                #endif
-                    // Next byte
-                    idx++;
-                }
-            }
-            else
-            {
-                // LSB first (intel's way)
-                for (int c = 0; c < row_size; c++) // column
-                {
-                #if BYTE_ORDER == BIG_ENDIAN
-                    array_u8[bank_nr][idx ^ bus_mask] = row_buf[c];
-                #else
-                    array_u8[bank_nr][idx] = row_buf[c];
-                #endif
-                    // Next byte
-                    idx++;
-                }
-            }
-            
-            // Compute next row's address
-            if (mem_flags & FLAG_BANK_INTERLEAVING)
+            vluint64_t *p64  = (vluint64_t *)ptr;
+            vluint64_t  base = offs >> 3;
+            vluint64_t  seed = fill_seed;
+
+            // No dependency between words : vectorized by the compiler
+            for (vluint64_t a = 0; a < (size >> 3); a++)
             {
-                // Increment bank number
-                bank_nr = (bank_nr + 1) & (SDRAM_NUM_BANKS - 1);
-                
-                // Bank #3 -> bank #0
-                if (!bank_nr)
-                {
-                    row_pos ++;
-                    if ((row_pos == (int)num_rows) && ((r + row_size) < (int)size))
-                    {
-                        printf("Memory overflow while loading !!\n");
-                        return;
-                    }
-                }
-                else
-                {
-                    idx -= (int)num_cols;
-                }
+                p64[a] = rand_u64(seed, base + a);
             }
-            else
+            break;
+        }
+        case FILL_PATTERN :
+        {
+            vluint64_t *p64 = (vluint64_t *)ptr;
+
+            for (vluint64_t a = 0; a < (size >> 3); a++)
             {
-                // Increment row position
-                row_pos = (row_pos + 1) & ((int)num_rows - 1);
-                
-                // Last row in a bank
-                if (!row_pos)
-                {
-                    idx = 0;
-                    bank_nr++;
-                    if ((bank_nr == SDRAM_NUM_BANKS) && ((r + row_size) < (int)size))
-                    {
-                        printf("Memory overflow while loading !!\n");
-                        return;
-                    }
-                }
+                p64[a] = fill_value;
             }
+            break;
+        }
+        default :
+        {
+            memset((void *)ptr, 0, size);
+            break;
         }
-        printf("OK\n");
-        
-        delete[] row_buf;
     }
-    else
+}
+
+// Fill the whole memory, one thread per bank
+void SDRAM::fill_all(void)
+{
+    std::thread *thr[SDRAM_NUM_BANKS];
+    vluint64_t   size = map_size >> SDRAM_BIT_BANKS;
+
+    for (int b = 0; b < SDRAM_NUM_BANKS; b++) // bank
     {
-        printf("Cannot load binary file \"%s\" !!\n", name);
+        thr[b] = new std::thread(&SDRAM::fill_range, this, array_u8[b], size);
+    }
+    for (int b = 0; b < SDRAM_NUM_BANKS; b++) // bank
+    {
+        thr[b]->join();
+        delete thr[b];
     }
 }
 
-// Binary file saving
-void SDRAM::save(const char *name, vluint32_t size, vluint32_t addr)
+// Initialization pattern (64-bit value, repeated)
+void SDRAM::set_fill_pattern(vluint64_t pattern)
 {
-    FILE *fh;
-    
-    fh = fopen(name, "wb");
-    if (fh)
-    {
-        int        row_size; // Row size (num_cols * 1, 2 or 4)
-        vluint8_t *row_buf;  // Row buffer
-        int        row_pos;  // Row position (0 to num_rows - 1)
-        int        bank_nr;  // Bank number (0 to 3)
-        int        idx;      // Array index (0 to num_cols * num_rows - 1)
-        
-        // Row size computation based on data bus width
-        row_size = (int)1 << (bit_cols + bus_log2);
-        // Allocate one full row
-        row_buf = new vluint8_t[row_size];
-        
-        // Row position
-        row_pos = (int)addr >> (bit_cols + bus_log2);
-        // Banks layout
-        if (mem_flags & FLAG_BANK_INTERLEAVING)
-        {
-            // Banks are interleaved
-            bank_nr = row_pos & (SDRAM_NUM_BANKS - 1);
-            row_pos = row_pos >> SDRAM_BIT_BANKS;
-        }
-        else
+    fill_mode  = FILL_PATTERN;
+    fill_value = pattern;
+    // Sparse mode : only the pages not yet accessed are affected
+    if (!sparse_on)
+    {
+        fill_all();
+    }
+}
+
+// Random initialization with a given seed
+void SDRAM::set_random_seed(vluint64_t seed)
+{
+    fill_mode = FILL_RANDOM;
+    fill_seed = seed;
+    printf("SDRAM random seed : 0x%016llX\n", (unsigned long long)fill_seed);
+    // Sparse mode : only the pages not yet accessed are affected
+    if (!sparse_on)
+    {
+        fill_all();
+    }
+}
+
+// Number of bytes really backed by physical memory
+vluint64_t SDRAM::resident_size(void)
+{
+    vluint64_t pages = 0;
+
+    if (sparse_on)
+    {
+        for (vluint64_t p = 0; p < num_pages; p++)
         {
-            // Banks are contiguous
-            bank_nr = row_pos >> bit_rows;
-            row_pos = row_pos & (num_rows - 1);
+            if (page_state[p] != PAGE_EMPTY) pages++;
         }
-        idx = row_pos << (bit_cols + bus_log2);
-        
-        printf("Saving 0x%08lX bytes @ 0x%08lX to binary file \"%s\"...", size, addr, name);
-        for (int r = 0; r < (int)size; r += row_size) // row
+    }
+    else
+    {
+        // mincore works on base pages, even with huge pages
+        int            base_log2 = __builtin_ctzl(sysconf(_SC_PAGESIZE));
+        vluint64_t     n         = map_size >> base_log2;
+        unsigned char *vec       = new unsigned char[n];
+
+        if (!mincore((void *)mem_base, map_size, vec))
         {
-            // Here, we take care of the endianness
-            if (mem_flags & FLAG_BIG_ENDIAN)
-            {
-                // MSB first (motorola's way)
-                for (int c = 0; c < row_size; c++) // column
-                {
-                #if BYTE_ORDER == LITTLE_ENDIAN
-                    row_buf[c] = array_u8[bank_nr][idx ^ bus_mask];
-                #else
-                    row_buf[c] = array_u8[bank_nr][idx];
-                #endif
-                    // Next byte
-                    idx++;
-                }
-            }
-            else
-            {
-                // LSB first (intel's way)
-                for (int c = 0; c < row_size; c++) // column
-                {
-                #if BYTE_ORDER == BIG_ENDIAN
-                    row_buf[c] = array_u8[bank_nr][idx ^ bus_mask];
-                #else
-                    row_buf[c] = array_u8[bank_nr][idx];
-                #endif
-                    // Next byte
-                    idx++;
-                }
-            }
-            
-            // Compute next row's address
-            if (mem_flags & FLAG_BANK_INTERLEAVING)
-            {
-                // Increment bank number
-                bank_nr = (bank_nr + 1) & (SDRAM_NUM_BANKS - 1);
-                
-                // Bank #3 -> bank #0
-                if (!bank_nr)
-                {
-                    row_pos ++;
-                    if ((row_pos == (int)num_rows) && ((r + row_size) < (int)size))
-                    {
-                        printf("Memory overflow while saving !!\n");
-                        return;
-                    }
-                }
-                else
-                {
-                    idx -= (int)num_cols;
-                }
-            }
-            else
+            for (vluint64_t p = 0; p < n; p++)
             {
-                // Increment row position
-                row_pos = (row_pos + 1) & ((int)num_rows - 1);
-                
-                // Last row in a bank
-                if (!row_pos)
-                {
-                    idx = 0;
-                    bank_nr++;
-                    if ((bank_nr == SDRAM_NUM_BANKS) && ((r + row_size) < (int)size))
-                    {
-                        printf("Memory overflow while saving !!\n");
-                        return;
-                    }
-                }
+                pages += vec[p] & 1;
             }
-            
-            // Write one full row to the binary file
-            fwrite((void *)row_buf, row_size, 1, fh);
         }
-        printf("OK\n");
-        
-        delete[] row_buf;
-    }
-    else
-    {
-        printf("Cannot save binary file \"%s\" !!\n", name);
+        delete[] vec;
+        return pages << base_log2;
     }
+    return pages << page_log2;
 }
 
-// Read a byte
-vluint8_t SDRAM::read_byte(vluint32_t addr)
+// Page faults and page mappings from several threads : one at a time
+void SDRAM::fault_enter(void)
 {
-    return (this->*read_u8_priv)(addr);
+    while (__atomic_exchange_n(&fault_lock, 1, __ATOMIC_ACQUIRE))
+    {
+        sched_yield();
+    }
 }
 
-// Read a word
-vluint16_t SDRAM::read_word(vluint32_t addr)
+void SDRAM::fault_leave(void)
 {
-    return (this->*read_u16_priv)(addr);
+    __atomic_store_n(&fault_lock, 0, __ATOMIC_RELEASE);
 }
 
-// Read a long
-vluint32_t SDRAM::read_long(vluint32_t addr)
+// Initialization of a run of empty pages (sparse mode), fault_lock held
+// The pages are filled through the second view while they are still PROT_NONE
+// in the first one : an access from another thread faults and waits for the
+// lock, it can neither read a partly filled page nor have its write overwritten
+// by the fill. The protection is set last, then the state is published.
+// skip_beg/skip_end : pages fully overwritten by the caller (not filled)
+bool SDRAM::page_init(vluint64_t p_beg, vluint64_t p_end, vluint64_t skip_beg, vluint64_t skip_end,
+                      int prot, vluint8_t state)
 {
-    return (this->*read_u32_priv)(addr);
+    for (vluint64_t p = p_beg; p < p_end; p++)
+    {
+        // Zeroed pages are provided by the kernel
+        if ((fill_mode != FILL_ZERO) && ((p < skip_beg) || (p >= skip_end)))
+        {
+            fill_copy(init_base + (p << page_log2), p << page_log2, (vluint64_t)1 << page_log2);
+        }
+    }
+    if (mprotect((void *)(mem_base + (p_beg << page_log2)), (size_t)(p_end - p_beg) << page_log2, prot))
+    {
+        return false;
+    }
+    for (vluint64_t p = p_beg; p < p_end; p++)
+    {
+        __atomic_store_n(&page_state[p], state, __ATOMIC_RELEASE);
+    }
+    return true;
 }
 
-// Read a quad
-vluint64_t SDRAM::read_quad(vluint32_t addr)
+// First access to a page (sparse mode) or first write since the snapshot
+bool SDRAM::page_fault(vluint64_t page)
 {
-    return (this->*read_u64_priv)(addr);
-}
+    vluint8_t *ptr   = mem_base + (page << page_log2);
+    size_t     psize = (size_t)1 << page_log2;
+    vluint8_t  state;
+    bool       ret   = true;
+
+    // Same page faulting on two threads : handled once, the other access is restarted
+    fault_enter();
+    state = page_state[page];
+    if (state == PAGE_EMPTY)
+    {
+        // With a snapshot : read-only from the start, the first write is tracked
+        if (snap_on)
+            ret = page_init(page, page + 1, 0, 0, PROT_READ, PAGE_INIT | PAGE_WP | PAGE_NEW);
+        else
+            ret = page_init(page, page + 1, 0, 0, PROT_READ | PROT_WRITE, PAGE_INIT);
+    }
+    else if (state & PAGE_WP)
+    {
+        // Snapshot contents (no copy for a page dropped by restore)
+        if (!(state & PAGE_NEW))
+        {
+            memcpy((void *)(snap_base + (page << page_log2)), (const void *)ptr, psize);
+        }
+        if (mprotect((void *)ptr, psize, PROT_READ | PROT_WRITE))
+        {
+            ret = false;
+        }
+        else
+        {
+            page_state[page] = (state & ~PAGE_WP) | PAGE_DIRTY;
+        }
+    }
+    fault_leave();
 
-// Write a byte
-void SDRAM::write_byte(vluint32_t addr, vluint8_t data)
-{
-    return (this->*write_u8_priv)(addr, data);
+    return ret;
 }
 
-// Write a word
-void SDRAM::write_word(vluint32_t addr, vluint16_t data)
+// Make a memory range accessible (sparse mode) and writable (snapshot)
+// Pages fully overwritten by the caller are not initialized
+// (a read from another thread races with that write anyway)
+void SDRAM::map_range(vluint64_t offs, vluint64_t size, bool write)
 {
-    return (this->*write_u16_priv)(addr, data);
-}
+    vluint64_t p_beg = offs >> page_log2;
+    vluint64_t p_end = (offs + size + ((vluint64_t)1 << page_log2) - 1) >> page_log2;
+    vluint64_t p_run = p_beg;
+    vluint64_t s_beg = p_end;
+    vluint64_t s_end = p_end;
 
-// Write a long
-void SDRAM::write_long(vluint32_t addr, vluint32_t data)
-{
-    return (this->*write_u32_priv)(addr, data);
+    if (write)
+    {
+        s_beg = (offs + ((vluint64_t)1 << page_log2) - 1) >> page_log2;
+        s_end = (offs + size) >> page_log2;
+    }
+
+    fault_enter();
+    for (vluint64_t p = p_beg; p <= p_end; p++)
+    {
+        // End of a run of empty pages : one system call
+        if ((p == p_end) || (page_state[p] != PAGE_EMPTY))
+        {
+            if (p > p_run)
+            {
+                if (!snap_on)
+                    page_init(p_run, p, s_beg, s_end, PROT_READ | PROT_WRITE, PAGE_INIT);
+                else if (write)
+                    page_init(p_run, p, s_beg, s_end, PROT_READ | PROT_WRITE, PAGE_INIT | PAGE_NEW | PAGE_DIRTY);
+                else
+                    page_init(p_run, p, s_beg, s_end, PROT_READ, PAGE_INIT | PAGE_NEW | PAGE_WP);
+            }
+            p_run = p + 1;
+        }
+    }
+    fault_leave();
+
+    // Snapshot : pages saved before being written
+    if ((snap_on) && (write))
+    {
+        for (vluint64_t p = p_beg; p < p_end; p++)
+        {
+            if (page_state[p] & PAGE_WP) page_fault(p);
+        }
+    }
 }
 
-// Write a quad
-void SDRAM::write_quad(vluint32_t addr, vluint64_t data)
+// Register the instance for the page fault handler
+// Returns -1 when every slot is taken
+int SDRAM::register_inst(void)
 {
-    return (this->*write_u64_priv)(addr, data);
+    int i;
+
+    for (i = 0; i < SDRAM_MAX_SPARSE; i++)
+    {
+        if (!s_sparse_inst[i]) break;
+    }
+    if (i == SDRAM_MAX_SPARSE)
+    {
+        printf("Too many sparse SDRAM instances (%d max) !!\n", SDRAM_MAX_SPARSE);
+        return -1;
+    }
+    __atomic_store_n(&s_sparse_inst[i], this, __ATOMIC_RELEASE);
+    if (!s_handler_on)
+    {
+        struct sigaction sa;
+
+        memset((void *)&sa, 0, sizeof(sa));
+        sa.sa_sigaction = &SDRAM::fault_handler;
+        sa.sa_flags     = SA_SIGINFO;
+        sigemptyset(&sa.sa_mask);
+        sigaction(SIGSEGV, &sa, &s_prev_action);
+        s_handler_on = true;
+    }
+
+    return 0;
 }
 
-// Cycle evaluate
-void SDRAM::eval
-(
-    // Timestamp from clock generator
-    vluint64_t ts,
-    // SDRAM clock
-    vluint8_t clk,
-    vluint8_t cke,
-    // SDRAM commands
-    vluint8_t cs_n,
-    vluint8_t ras_n,
-    vluint8_t cas_n,
-    vluint8_t we_n,
-    // SDRAM address
-    vluint8_t ba,
-    vluint16_t addr,
-    // SDRAM data bus
-    vluint8_t dqm,
-    vluint64_t dq_in,
-    vluint64_t &dq_out
-)
+// Unregister the instance, the last one puts back the previous handler
+void SDRAM::unregister_inst(void)
 {
-    // Clock enabled
-    if (cke)
+    bool last = true;
+
+    for (int i = 0; i < SDRAM_MAX_SPARSE; i++)
     {
-        // Rising edge on clock
-        if (clk && !(prev_clk))
+        if (s_sparse_inst[i] == this)
+        {
+            __atomic_store_n(&s_sparse_inst[i], (SDRAM *)NULL, __ATOMIC_RELEASE);
+        }
+        else if (s_sparse_inst[i])
         {
-            // Command pipeline
-            cmd_pipe.pipe >>= 8;
-            cmd_pipe.u8[3] = CMD_NOP;
-            col_pipe.pipe >>= 16;
-            ba_pipe.pipe  >>= 8;
-            bap_pipe.pipe >>= 8;
-            a10_pipe.pipe >>= 16;
+            last = false;
+        }
+    }
+    if ((last) && (s_handler_on))
+    {
+        struct sigaction sa;
 
-            // DQM pipeline
-            dqm_pipe[0] = dqm_pipe[1];
-            dqm_pipe[1] = dqm;
-            
-            // Process SDRAM command (immediate)
-            if (!cs_n)
-            {
-                // cmd[2:0] = { ras_n, cas_n, we_n }
-                vluint8_t  cmd = (ras_n << 2) | (cas_n << 1) | we_n;
-                // addr[10] wire
-                vluint16_t a10 = addr & 0x400;
-                
-                switch (cmd)
+        sigaction(SIGSEGV, &s_prev_action, &sa);
+        // Handler installed after ours (debugger, sanitizer) : left in place
+        if (sa.sa_sigaction != &SDRAM::fault_handler)
+        {
+            sigaction(SIGSEGV, &sa, (struct sigaction *)NULL);
+        }
+        s_handler_on = false;
+    }
+}
+
+// SIGSEGV handler (sparse mode and snapshot)
+void SDRAM::fault_handler(int sig, siginfo_t *info, void *uctx)
+{
+    vluint8_t *addr = (vluint8_t *)info->si_addr;
+
+    for (int i = 0; i < SDRAM_MAX_SPARSE; i++)
+    {
+        SDRAM *mem = __atomic_load_n(&s_sparse_inst[i], __ATOMIC_ACQUIRE);
+
+        if ((mem) && (addr >= mem->mem_base) && (addr < mem->mem_base + mem->map_size))
+        {
+            if (mem->page_fault((vluint64_t)(addr - mem->mem_base) >> mem->page_log2)) return;
+        }
+    }
+
+    // Not an SDRAM page : previous handler
+    if (s_prev_action.sa_flags & SA_SIGINFO)
+    {
+        s_prev_action.sa_sigaction(sig, info, uctx);
+    }
+    else if ((s_prev_action.sa_handler != SIG_DFL) && (s_prev_action.sa_handler != SIG_IGN))
+    {
+        s_prev_action.sa_handler(sig);
+    }
+    else
+    {
+        // The access is restarted and kills the process
+        signal(sig, SIG_DFL);
+    }
+}
+
+// Copy with a byte swap inside each data bus word
+// (no dependency between words : vectorized by the compiler)
+static void copy_swap(vluint8_t *dst, const vluint8_t *src, vluint64_t size, int bus_log2)
+{
+    switch (bus_log2)
+    {
+        case 1 :
+        {
+            vluint16_t       *d16 = (vluint16_t *)dst;
+            const vluint16_t *s16 = (const vluint16_t *)src;
+
+            for (vluint64_t i = 0; i < (size >> 1); i++) d16[i] = __builtin_bswap16(s16[i]);
+            break;
+        }
+        case 2 :
+        {
+            vluint32_t       *d32 = (vluint32_t *)dst;
+            const vluint32_t *s32 = (const vluint32_t *)src;
+
+            for (vluint64_t i = 0; i < (size >> 2); i++) d32[i] = __builtin_bswap32(s32[i]);
+            break;
+        }
+        case 3 :
+        {
+            vluint64_t       *d64 = (vluint64_t *)dst;
+            const vluint64_t *s64 = (const vluint64_t *)src;
+
+            for (vluint64_t i = 0; i < (size >> 3); i++) d64[i] = __builtin_bswap64(s64[i]);
+            break;
+        }
+        default :
+        {
+            memcpy((void *)dst, (const void *)src, size);
+            break;
+        }
+    }
+}
+
+// Memory offset of an image address
+vluint64_t SDRAM::image_offs(vluint64_t addr)
+{
+    int row_log2 = bit_cols + bus_log2;
+
+    if (mem_flags & FLAG_BANK_INTERLEAVING)
+    {
+        // |      rows       |  banks  |     columns     |
+        vluint64_t row_pos = addr >> row_log2;
+        vluint64_t bank_nr = row_pos & (SDRAM_NUM_BANKS - 1);
+
+        row_pos >>= SDRAM_BIT_BANKS;
+        return (bank_nr << (bit_rows + row_log2))
+             | (row_pos << row_log2)
+             | (addr & (((vluint64_t)1 << row_log2) - 1));
+    }
+    else
+    {
+        // |  banks  |      rows       |     columns     |
+        return addr;
+    }
+}
+
+// Byte address of a burst (for the logs)
+vluint64_t SDRAM::burst_addr(int bank, int col)
+{
+    if (mem_flags & FLAG_BANK_INTERLEAVING)
+        return (((vluint64_t)row_addr[bank] << SDRAM_BIT_BANKS) + ((vluint64_t)bank << bit_cols) + (vluint64_t)col) << bus_log2;
+    else
+        return ((vluint64_t)row_addr[bank] + ((vluint64_t)bank << (bit_rows + bit_cols)) + (vluint64_t)col) << bus_log2;
+}
+
+// Image address of a memory offset
+vluint64_t SDRAM::image_addr(vluint64_t offs)
+{
+    int row_log2 = bit_cols + bus_log2;
+
+    if (mem_flags & FLAG_BANK_INTERLEAVING)
+    {
+        vluint64_t bank_nr = offs >> (bit_rows + row_log2);
+        vluint64_t row_pos = (offs >> row_log2) & (((vluint64_t)1 << bit_rows) - 1);
+
+        return (((row_pos << SDRAM_BIT_BANKS) | bank_nr) << row_log2)
+             | (offs & (((vluint64_t)1 << row_log2) - 1));
+    }
+    else
+    {
+        return offs;
+    }
+}
+
+// Copy between an image and the memory (load : image -> memory)
+void SDRAM::image_copy(vluint8_t *img, vluint64_t addr, vluint64_t size, bool load)
+{
+    vluint64_t row_size = (vluint64_t)1 << (bit_cols + bus_log2);
+    bool       swap     = (lane_xor != 0);
+
+    while (size)
+    {
+        vluint64_t len;
+        vluint64_t offs;
+        vluint8_t *mem;
+
+        // Contiguous banks : one chunk, interleaved banks : one row
+        len  = (mem_flags & FLAG_BANK_INTERLEAVING) ? row_size - (addr & (row_size - 1)) : size;
+        len  = (len > size) ? size : len;
+        offs = image_offs(addr);
+        mem  = mem_base + offs;
+
+        if (!swap)
+        {
+            if (load)
+                memcpy((void *)mem, (const void *)img, len);
+            else
+                memcpy((void *)img, (const void *)mem, len);
+        }
+        else
+        {
+            vluint64_t head = (vluint64_t)(-offs) & bus_mask;
+            vluint64_t body;
+            vluint64_t i;
+
+            head = (head > len) ? len : head;
+            body = (len - head) & ~(vluint64_t)bus_mask;
+            // Unaligned bytes : lane swap
+            for (i = 0; i < head; i++)
+            {
+                if (load)
+                    mem_base[(offs + i) ^ lane_xor] = img[i];
+                else
+                    img[i] = mem_base[(offs + i) ^ lane_xor];
+            }
+            // Aligned words : byte swap
+            if (load)
+                copy_swap(mem + head, img + head, body, bus_log2);
+            else
+                copy_swap(img + head, mem + head, body, bus_log2);
+            for (i = head + body; i < len; i++)
+            {
+                if (load)
+                    mem_base[(offs + i) ^ lane_xor] = img[i];
+                else
+                    img[i] = mem_base[(offs + i) ^ lane_xor];
+            }
+        }
+        img  += len;
+        addr += len;
+        size -= len;
+    }
+}
+
+// Copy between an image and the memory on several threads
+// (only a load maps the pages in sparse mode, a save reads them with image_peek)
+void SDRAM::image_copy_mt(vluint8_t *img, vluint64_t addr, vluint64_t size, bool load)
+{
+    std::thread *thr[IMAGE_MAX_THREADS];
+    vluint64_t   part;
+    int          num;
+
+    if (load) image_prepare(addr, size, true);
+
+    // Small image : no thread
+    num = image_threads(size, (vluint64_t)1 << (bit_cols + bus_log2), part);
+    if (num < 2)
+    {
+        image_part(img, addr, size, load);
+        return;
+    }
+
+    // Equal parts, split on row boundaries
+    for (int t = 0; t < num; t++)
+    {
+        vluint64_t offs = part * (vluint64_t)t;
+        vluint64_t len  = (offs >= size) ? 0 : (size - offs > part) ? part : size - offs;
+
+        thr[t] = new std::thread(&SDRAM::image_part, this, img + offs, addr + offs, len, load);
+    }
+    for (int t = 0; t < num; t++)
+    {
+        thr[t]->join();
+        delete thr[t];
+    }
+}
+
+// One part of image_copy_mt (one scratch page per thread for image_peek)
+void SDRAM::image_part(vluint8_t *img, vluint64_t addr, vluint64_t size, bool load)
+{
+    if (load)
+    {
+        image_copy(img, addr, size, true);
+    }
+    else
+    {
+        std::vector<vluint8_t> pbuf((sparse_on) ? (size_t)1 << page_log2 : 0);
+        vluint64_t pb_page = ~(vluint64_t)0;
+
+        image_peek(img, addr, size, pbuf.data(), pb_page);
+    }
+}
+
+// Image bytes, the pages never accessed (sparse mode) are not mapped :
+// their contents are generated from the initialization pattern
+// pbuf : one page of scratch, pb_page : page held in pbuf
+void SDRAM::image_peek(vluint8_t *img, vluint64_t addr, vluint64_t size,
+                       vluint8_t *pbuf, vluint64_t &pb_page)
+{
+    vluint64_t row_size = (vluint64_t)1 << (bit_cols + bus_log2);
+    vluint64_t psize    = (vluint64_t)1 << page_log2;
+
+    if (!sparse_on)
+    {
+        image_copy(img, addr, size, false);
+        return;
+    }
+
+    while (size)
+    {
+        vluint64_t len;
+        vluint64_t offs;
+        vluint64_t page;
+        vluint64_t pos;
+
+        // One row (interleaved banks) inside one page
+        len  = (mem_flags & FLAG_BANK_INTERLEAVING) ? row_size - (addr & (row_size - 1)) : size;
+        len  = (len > size) ? size : len;
+        offs = image_offs(addr);
+        page = offs >> page_log2;
+        pos  = offs & (psize - 1);
+        len  = (len > psize - pos) ? psize - pos : len;
+
+        if (__atomic_load_n(&page_state[page], __ATOMIC_ACQUIRE) != PAGE_EMPTY)
+        {
+            image_copy(img, addr, len, false);
+        }
+        else
+        {
+            if (pb_page != page)
+            {
+                fill_copy(pbuf, page << page_log2, psize);
+                pb_page = page;
+            }
+            // Lanes swap stays inside a data bus word, thus inside the page
+            if (!lane_xor)
+            {
+                memcpy((void *)img, (const void *)(pbuf + pos), len);
+            }
+            else
+            {
+                for (vluint64_t i = 0; i < len; i++)
+                {
+                    img[i] = pbuf[(pos + i) ^ lane_xor];
+                }
+            }
+        }
+        img  += len;
+        addr += len;
+        size -= len;
+    }
+}
+
+// Sparse mode or snapshot : prepare the pages first (no concurrent page faults)
+void SDRAM::image_prepare(vluint64_t addr, vluint64_t size, bool write)
+{
+    vluint64_t row_size = (vluint64_t)1 << (bit_cols + bus_log2);
+
+    if (!page_state) return;
+
+    while (size)
+    {
+        vluint64_t len = (mem_flags & FLAG_BANK_INTERLEAVING) ? row_size - (addr & (row_size - 1)) : size;
+
+        len = (len > size) ? size : len;
+        map_range(image_offs(addr), len, write);
+        addr += len;
+        size -= len;
+    }
+}
+
+// Number of threads for an image operation
+// (part : bytes per thread, multiple of "align" : 1 for a small image)
+int SDRAM::image_threads(vluint64_t size, vluint64_t align, vluint64_t &part)
+{
+    int num = (int)std::thread::hardware_concurrency();
+
+    num  = (num > IMAGE_MAX_THREADS) ? IMAGE_MAX_THREADS : num;
+    num  = ((size < IMAGE_MT_THRESHOLD) || (num < 2)) ? 1 : num;
+    part = ((size / num) + align - 1) & ~(align - 1);
+
+    return num;
+}
+
+// Binary file loading
+void SDRAM::load(const char *name, vluint64_t size, vluint64_t addr)
+{
+    struct stat st;
+    vluint8_t  *img;
+    int         fd;
+
+    fd = open(name, O_RDONLY);
+    if ((fd < 0) || (fstat(fd, &st)) || (!st.st_size))
+    {
+        printf("Cannot load binary file \"%s\" !!\n", name);
+        if (fd >= 0) close(fd);
+        return;
+    }
+    if ((vluint64_t)size > (vluint64_t)st.st_size) size = (vluint64_t)st.st_size;
+    if ((vluint64_t)addr + (vluint64_t)size > map_size)
+    {
+        printf("Memory overflow while loading !!\n");
+        size = ((vluint64_t)addr < map_size) ? map_size - (vluint64_t)addr : 0;
+    }
+    if (!size)
+    {
+        close(fd);
+        return;
+    }
+
+    img = (vluint8_t *)mmap(NULL, (size_t)size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (img == (vluint8_t *)MAP_FAILED)
+    {
+        printf("Cannot map binary file \"%s\" !!\n", name);
+        return;
+    }
+
+    printf("Starting offset : 0x%08llX\n", (unsigned long long)image_offs(addr));
+    printf("Loading 0x%08llX bytes @ 0x%08llX from binary file \"%s\"...",
+           (unsigned long long)size, (unsigned long long)addr, name);
+    image_copy_mt(img, (vluint64_t)addr, (vluint64_t)size, true);
+    printf("OK\n");
+
+    munmap((void *)img, (size_t)size);
+}
+
+// Binary file saving
+void SDRAM::save(const char *name, vluint64_t size, vluint64_t addr)
+{
+    vluint8_t *img;
+    int        fd;
+
+    fd = open(name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        printf("Cannot save binary file \"%s\" !!\n", name);
+        return;
+    }
+    if ((vluint64_t)addr + (vluint64_t)size > map_size)
+    {
+        printf("Memory overflow while saving !!\n");
+        size = ((vluint64_t)addr < map_size) ? map_size - (vluint64_t)addr : 0;
+    }
+    if ((!size) || (ftruncate(fd, (off_t)size)))
+    {
+        close(fd);
+        return;
+    }
+
+    img = (vluint8_t *)mmap(NULL, (size_t)size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (img == (vluint8_t *)MAP_FAILED)
+    {
+        printf("Cannot map binary file \"%s\" !!\n", name);
+        return;
+    }
+
+    printf("Saving 0x%08llX bytes @ 0x%08llX to binary file \"%s\"...",
+           (unsigned long long)size, (unsigned long long)addr, name);
+    image_copy_mt(img, (vluint64_t)addr, (vluint64_t)size, false);
+    printf("OK\n");
+
+    munmap((void *)img, (size_t)size);
+}
+
+static inline vluint64_t hash_rotl(vluint64_t v, int n)
+{
+    return (v << n) | (v >> (64 - n));
+}
+
+// Hash of a buffer : 4 independent lanes of 8 bytes
+static vluint64_t hash_block(const vluint8_t *buf, vluint64_t size)
+{
+    vluint64_t h0 = HASH_P1 + HASH_P2;
+    vluint64_t h1 = HASH_P2;
+    vluint64_t h2 = 0;
+    vluint64_t h3 = (vluint64_t)0 - HASH_P1;
+    vluint64_t w[4];
+    vluint64_t h;
+    vluint64_t i;
+
+    for (i = 0; i + 32 <= size; i += 32)
+    {
+        memcpy((void *)w, (const void *)(buf + i), 32);
+        h0 = hash_rotl(h0 + w[0] * HASH_P2, 31) * HASH_P1;
+        h1 = hash_rotl(h1 + w[1] * HASH_P2, 31) * HASH_P1;
+        h2 = hash_rotl(h2 + w[2] * HASH_P2, 31) * HASH_P1;
+        h3 = hash_rotl(h3 + w[3] * HASH_P2, 31) * HASH_P1;
+    }
+    h = hash_rotl(h0, 1) + hash_rotl(h1, 7) + hash_rotl(h2, 12) + hash_rotl(h3, 18) + size;
+    for (; i < size; i++)
+    {
+        h = hash_rotl(h ^ ((vluint64_t)buf[i] * HASH_P3), 11) * HASH_P1;
+    }
+    // Final avalanche
+    h ^= h >> 33;
+    h *= HASH_P2;
+    h ^= h >> 29;
+    h *= HASH_P3;
+    h ^= h >> 32;
+
+    return h;
+}
+
+// Hashes of the image pages in [addr, addr + size)
+void SDRAM::image_hash(vluint64_t addr, vluint64_t size, vluint64_t *hash)
+{
+    vluint8_t  buf[(size_t)1 << SDRAM_HASH_LOG2];
+    vluint64_t blk = (vluint64_t)1 << SDRAM_HASH_LOG2;
+    std::vector<vluint8_t> pbuf((sparse_on) ? (size_t)1 << page_log2 : 0);
+    vluint64_t pb_page = ~(vluint64_t)0;
+
+    for (vluint64_t p = 0; p < size; p += blk)
+    {
+        vluint64_t len = (size - p > blk) ? blk : size - p;
+
+        image_peek(buf, addr + p, len, pbuf.data(), pb_page);
+        *hash++ = hash_block(buf, len);
+    }
+}
+
+// Differences between an image and the memory in [addr, addr + size)
+// (contiguous differing bytes make one range, "full" : more than max_diffs)
+void SDRAM::image_diff(const vluint8_t *img, vluint64_t addr, vluint64_t size, int max_diffs,
+                       std::vector<vluint64_t> *d_addr, std::vector<vluint64_t> *d_size, bool *full)
+{
+    vluint8_t  buf[(size_t)1 << SDRAM_HASH_LOG2];
+    vluint64_t blk = (vluint64_t)1 << SDRAM_HASH_LOG2;
+    std::vector<vluint8_t> pbuf((sparse_on) ? (size_t)1 << page_log2 : 0);
+    vluint64_t pb_page = ~(vluint64_t)0;
+
+    *full = false;
+    for (vluint64_t p = 0; p < size; p += blk)
+    {
+        vluint64_t len = (size - p > blk) ? blk : size - p;
+
+        image_peek(buf, addr + p, len, pbuf.data(), pb_page);
+        if (!memcmp((const void *)buf, (const void *)(img + p), (size_t)len)) continue;
+
+        for (vluint64_t i = 0; i < len; i++)
+        {
+            vluint64_t a = addr + p + i;
+
+            if (buf[i] == img[p + i]) continue;
+
+            if ((!d_addr->empty()) && (d_addr->back() + d_size->back() == a))
+            {
+                d_size->back()++;
+            }
+            else if ((int)d_addr->size() == max_diffs)
+            {
+                *full = true;
+                return;
+            }
+            else
+            {
+                d_addr->push_back(a);
+                d_size->push_back(1);
+            }
+        }
+    }
+}
+
+// Digest of the whole memory (image order, like a saved image)
+// pages : hash per SDRAM_HASH_LOG2 bytes page (optional)
+vluint64_t SDRAM::digest(std::vector<vluint64_t> *pages)
+{
+    std::thread            *thr[IMAGE_MAX_THREADS];
+    std::vector<vluint64_t> tmp;
+    std::vector<vluint64_t> &hash = (pages) ? *pages : tmp;
+    vluint64_t              blk   = (vluint64_t)1 << SDRAM_HASH_LOG2;
+    vluint64_t              part;
+    int                     num;
+
+    // Sparse mode : the pages never accessed stay unmapped
+    hash.resize((size_t)((map_size + blk - 1) >> SDRAM_HASH_LOG2));
+
+    // Equal parts, split on page boundaries
+    num = image_threads(map_size, blk, part);
+    for (int t = 0; t < num; t++)
+    {
+        vluint64_t offs = part * (vluint64_t)t;
+        vluint64_t len  = (offs >= map_size) ? 0 : (map_size - offs > part) ? part : map_size - offs;
+
+        thr[t] = new std::thread(&SDRAM::image_hash, this, offs, len, hash.data() + (offs >> SDRAM_HASH_LOG2));
+    }
+    for (int t = 0; t < num; t++)
+    {
+        thr[t]->join();
+        delete thr[t];
+    }
+
+    return hash_block((const vluint8_t *)hash.data(), (vluint64_t)hash.size() * sizeof(vluint64_t));
+}
+
+// Comparison with an image file (golden dump written by save)
+// Returns the number of differing ranges (up to max_diffs), 0 : identical, -1 : error
+int SDRAM::compare_file(const char *name, int max_diffs,
+                        std::vector<vluint64_t> &addr, std::vector<vluint64_t> &size)
+{
+    std::thread            *thr[IMAGE_MAX_THREADS];
+    std::vector<vluint64_t> t_addr[IMAGE_MAX_THREADS];
+    std::vector<vluint64_t> t_size[IMAGE_MAX_THREADS];
+    bool                    t_full[IMAGE_MAX_THREADS];
+    struct stat             st;
+    vluint8_t              *img;
+    vluint64_t              len;
+    vluint64_t              part;
+    int                     num;
+    int                     fd;
+
+    addr.clear();
+    size.clear();
+    fd = open(name, O_RDONLY);
+    if ((fd < 0) || (fstat(fd, &st)) || (!st.st_size))
+    {
+        printf("Cannot compare with binary file \"%s\" !!\n", name);
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    len = (vluint64_t)st.st_size;
+    if (len != map_size)
+    {
+        printf("Binary file \"%s\" size (0x%08llX) differs from the SDRAM size !!\n",
+               name, (unsigned long long)len);
+        close(fd);
+        return -1;
+    }
+    // At least one range is reported
+    max_diffs = (max_diffs < 1) ? 1 : max_diffs;
+    img = (vluint8_t *)mmap(NULL, (size_t)len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (img == (vluint8_t *)MAP_FAILED)
+    {
+        printf("Cannot map binary file \"%s\" !!\n", name);
+        return -1;
+    }
+    madvise((void *)img, (size_t)len, MADV_SEQUENTIAL);
+
+    // Equal parts, split on page boundaries
+    num = image_threads(len, (vluint64_t)1 << SDRAM_HASH_LOG2, part);
+    for (int t = 0; t < num; t++)
+    {
+        vluint64_t offs = part * (vluint64_t)t;
+        vluint64_t t_len = (offs >= len) ? 0 : (len - offs > part) ? part : len - offs;
+
+        thr[t] = new std::thread(&SDRAM::image_diff, this, img + offs, offs, t_len, max_diffs,
+                                 &t_addr[t], &t_size[t], &t_full[t]);
+    }
+    for (int t = 0; t < num; t++)
+    {
+        thr[t]->join();
+        delete thr[t];
+    }
+    munmap((void *)img, (size_t)len);
+
+    // Ranges in address order, merged across the parts
+    for (int t = 0; t < num; t++)
+    {
+        for (size_t i = 0; i < t_addr[t].size(); i++)
+        {
+            if ((!addr.empty()) && (addr.back() + size.back() == t_addr[t][i]))
+            {
+                size.back() += t_size[t][i];
+            }
+            else if ((int)addr.size() < max_diffs)
+            {
+                addr.push_back(t_addr[t][i]);
+                size.push_back(t_size[t][i]);
+            }
+        }
+        // Following ranges unknown
+        if ((t_full[t]) || ((int)addr.size() == max_diffs)) break;
+    }
+
+    if (addr.empty())
+    {
+        printf("SDRAM matches binary file \"%s\"\n", name);
+    }
+    else
+    {
+        printf("SDRAM differs from binary file \"%s\" :\n", name);
+        for (size_t i = 0; i < addr.size(); i++)
+        {
+            printf("  0x%08llX - 0x%08llX (0x%llX bytes)\n", (unsigned long long)addr[i],
+                   (unsigned long long)(addr[i] + size[i] - 1), (unsigned long long)size[i]);
+        }
+    }
+
+    return (int)addr.size();
+}
+
+// Snapshot of the memory contents
+// Pages become read-only : they are copied on their first write
+void SDRAM::snapshot(void)
+{
+    vluint64_t p_run = 0;
+
+    if (!snap_base)
+    {
+        // Address space only : backed on first write
+        snap_base = (vluint8_t *)mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+                                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (snap_base == (vluint8_t *)MAP_FAILED)
+        {
+            printf("Cannot allocate SDRAM snapshot !!\n");
+            snap_base = (vluint8_t *)NULL;
+            return;
+        }
+        // Dirty pages tracking
+        if (!page_state)
+        {
+            page_state = new vluint8_t[num_pages];
+            memset((void *)page_state, PAGE_INIT, num_pages);
+            if (register_inst())
+            {
+                printf("Cannot track SDRAM snapshot pages !!\n");
+                delete[] page_state;
+                page_state = (vluint8_t *)NULL;
+                munmap((void *)snap_base, map_size);
+                snap_base  = (vluint8_t *)NULL;
+                return;
+            }
+        }
+    }
+    else
+    {
+        // Previous snapshot dropped
+        madvise((void *)snap_base, map_size, MADV_DONTNEED);
+    }
+
+    fault_enter();
+    for (vluint64_t p = 0; p <= num_pages; p++)
+    {
+        // End of a run of accessible pages : one system call
+        if ((p == num_pages) || (page_state[p] == PAGE_EMPTY))
+        {
+            if (p > p_run)
+            {
+                mprotect((void *)(mem_base + (p_run << page_log2)),
+                         (size_t)(p - p_run) << page_log2, PROT_READ);
+            }
+            p_run = p + 1;
+        }
+        else
+        {
+            page_state[p] = PAGE_INIT | PAGE_WP;
+        }
+    }
+    snap_on = true;
+    fault_leave();
+}
+
+// Back to the snapshot : only the modified pages are copied
+// Returns the number of restored pages
+vluint64_t SDRAM::restore(void)
+{
+    size_t     psize = (size_t)1 << page_log2;
+    vluint64_t pages = 0;
+
+    if (!snap_on)
+    {
+        printf("No SDRAM snapshot to restore !!\n");
+        return 0;
+    }
+
+    fault_enter();
+    for (vluint64_t p = 0; p < num_pages; p++)
+    {
+        vluint8_t  state = page_state[p];
+        vluint8_t *ptr   = mem_base + (p << page_log2);
+
+        if (state & PAGE_NEW)
+        {
+            // Not accessed at snapshot time : empty again
+            mprotect((void *)ptr, psize, PROT_NONE);
+            fallocate(mem_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                      (off_t)(p << page_log2), (off_t)psize);
+            page_state[p] = PAGE_EMPTY;
+            pages++;
+        }
+        else if (state & PAGE_DIRTY)
+        {
+            memcpy((void *)ptr, (const void *)(snap_base + (p << page_log2)), psize);
+            mprotect((void *)ptr, psize, PROT_READ);
+            page_state[p] = PAGE_INIT | PAGE_WP;
+            pages++;
+        }
+    }
+    fault_leave();
+
+    return pages;
+}
+
+// Regions modified since the snapshot (image addresses, memory order)
+// Returns the number of modified bytes
+vluint64_t SDRAM::dirty_regions(std::vector<vluint64_t> &addr, std::vector<vluint64_t> &size)
+{
+    vluint64_t row_size = (vluint64_t)1 << (bit_cols + bus_log2);
+    vluint64_t psize    = (vluint64_t)1 << page_log2;
+    vluint64_t chunk    = (mem_flags & FLAG_BANK_INTERLEAVING) ? row_size : psize;
+    vluint64_t total    = 0;
+
+    addr.clear();
+    size.clear();
+    if (!snap_on) return 0;
+
+    chunk = (chunk > psize) ? psize : chunk;
+    for (vluint64_t p = 0; p < num_pages; p++)
+    {
+        if (!(page_state[p] & PAGE_DIRTY)) continue;
+
+        // Interleaved banks : one region per row
+        for (vluint64_t offs = p << page_log2; offs < (p + 1) << page_log2; offs += chunk)
+        {
+            vluint64_t a = image_addr(offs);
+
+            if ((!addr.empty()) && (addr.back() + size.back() == a))
+            {
+                size.back() += chunk;
+            }
+            else
+            {
+                addr.push_back(a);
+                size.push_back(chunk);
+            }
+        }
+        total += psize;
+    }
+
+    return total;
+}
+
+// Modified regions saving : updates an image written by save
+// (the whole image is saved without a snapshot)
+void SDRAM::save_dirty(const char *name, vluint64_t size, vluint64_t addr)
+{
+    std::vector<vluint64_t> r_addr;
+    std::vector<vluint64_t> r_size;
+    vluint64_t  total = 0;
+    struct stat st;
+    vluint8_t  *img;
+    int         fd;
+
+    if (!snap_on)
+    {
+        save(name, size, addr);
+        return;
+    }
+
+    fd = open(name, O_RDWR | O_CREAT, 0644);
+    if ((fd < 0) || (fstat(fd, &st)))
+    {
+        printf("Cannot update binary file \"%s\" !!\n", name);
+        if (fd >= 0) close(fd);
+        return;
+    }
+    if ((vluint64_t)addr + (vluint64_t)size > map_size)
+    {
+        printf("Memory overflow while saving !!\n");
+        size = ((vluint64_t)addr < map_size) ? map_size - (vluint64_t)addr : 0;
+    }
+    if ((!size) || (((vluint64_t)st.st_size < (vluint64_t)size) && (ftruncate(fd, (off_t)size))))
+    {
+        close(fd);
+        return;
+    }
+
+    img = (vluint8_t *)mmap(NULL, (size_t)size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (img == (vluint8_t *)MAP_FAILED)
+    {
+        printf("Cannot map binary file \"%s\" !!\n", name);
+        return;
+    }
+
+    dirty_regions(r_addr, r_size);
+    for (size_t i = 0; i < r_addr.size(); i++)
+    {
+        // Clipped to the image
+        vluint64_t beg = (r_addr[i] > (vluint64_t)addr) ? r_addr[i] : (vluint64_t)addr;
+        vluint64_t end = r_addr[i] + r_size[i];
+
+        end = (end > (vluint64_t)addr + size) ? (vluint64_t)addr + size : end;
+        if (beg >= end) continue;
+        image_copy(img + (beg - (vluint64_t)addr), beg, end - beg, false);
+        total += end - beg;
+    }
+    printf("Saved 0x%08llX modified bytes @ 0x%08llX to binary file \"%s\"\n",
+           (unsigned long long)total, (unsigned long long)addr, name);
+
+    munmap((void *)img, (size_t)size);
+}
+
+// Binary log file creation
+bool SDRAM::open_bin_log(const char *name)
+{
+    sdram_log_hdr_t hdr;
+
+    close_bin_log();
+    blog_fh = fopen(name, "wb");
+    if (!blog_fh)
+    {
+        printf("Cannot create SDRAM binary log file \"%s\" !!\n", name);
+        return false;
+    }
+    memset((void *)&hdr, 0, sizeof(hdr));
+    hdr.magic     = SDRAM_LOG_MAGIC;
+    hdr.version   = SDRAM_LOG_VERSION;
+    hdr.rec_size  = sizeof(sdram_log_rec_t);
+    hdr.bus_log2  = (vluint8_t)bus_log2;
+    hdr.num_banks = (vluint8_t)SDRAM_NUM_BANKS;
+    hdr.bit_rows  = (vluint8_t)bit_rows;
+    hdr.bit_cols  = (vluint8_t)bit_cols;
+    hdr.mem_flags = mem_flags;
+    fwrite((const void *)&hdr, sizeof(hdr), 1, blog_fh);
+
+    // Cleared once : blog_put() never writes the reserved bytes
+    blog_buf[0] = new sdram_log_rec_t[SDRAM_LOG_BUF_LEN];
+    blog_buf[1] = new sdram_log_rec_t[SDRAM_LOG_BUF_LEN];
+    memset((void *)blog_buf[0], 0, SDRAM_LOG_BUF_LEN * sizeof(sdram_log_rec_t));
+    memset((void *)blog_buf[1], 0, SDRAM_LOG_BUF_LEN * sizeof(sdram_log_rec_t));
+    blog_cur    = 0;
+    blog_pos    = 0;
+    blog_len    = 0;
+    blog_stop   = false;
+    blog_thr    = new std::thread(&SDRAM::blog_thread, this);
+    blog_on     = true;
+    printf("SDRAM binary log file \"%s\" created\n", name);
+
+    return true;
+}
+
+// Binary log file closing (pending records are written)
+void SDRAM::close_bin_log(void)
+{
+    if (!blog_on) return;
+
+    blog_on = false;
+    if (blog_pos) blog_swap();
+    {
+        std::unique_lock<std::mutex> lock(blog_mtx);
+
+        blog_stop = true;
+    }
+    blog_cv.notify_all();
+    blog_thr->join();
+    delete blog_thr;
+    blog_thr = (std::thread *)NULL;
+    fclose(blog_fh);
+    blog_fh = (FILE *)NULL;
+    delete[] blog_buf[0];
+    delete[] blog_buf[1];
+}
+
+// Hand the current buffer over to the writer thread
+void SDRAM::blog_swap(void)
+{
+    std::unique_lock<std::mutex> lock(blog_mtx);
+
+    // Other buffer still being written
+    while (blog_len) blog_cv.wait(lock);
+    blog_len = blog_pos;
+    blog_cur ^= 1;
+    blog_pos  = 0;
+    lock.unlock();
+    blog_cv.notify_all();
+}
+
+// Writer thread
+void SDRAM::blog_thread(void)
+{
+    std::unique_lock<std::mutex> lock(blog_mtx);
+
+    for (;;)
+    {
+        if (blog_len)
+        {
+            sdram_log_rec_t *buf = blog_buf[blog_cur ^ 1];
+            int              len = blog_len;
+
+            lock.unlock();
+            fwrite((const void *)buf, sizeof(sdram_log_rec_t), len, blog_fh);
+            lock.lock();
+            blog_len = 0;
+            blog_cv.notify_all();
+        }
+        else if (blog_stop)
+        {
+            break;
+        }
+        else
+        {
+            blog_cv.wait(lock);
+        }
+    }
+}
+
+// Performance counters activation
+// name : file written at destruction (".json" : JSON, otherwise CSV)
+// row_hist : per-row access histogram, window : bandwidth sampling (cycles)
+void SDRAM::enable_stats(const char *name, bool row_hist, int window)
+{
+    delete[] st_name;
+    st_name = (char *)NULL;
+    if (name)
+    {
+        st_name = new char[strlen(name) + 1];
+        strcpy(st_name, name);
+    }
+    delete[] st_hist;
+    st_hist = (vluint32_t *)NULL;
+    if (row_hist)
+    {
+        st_hist = new vluint32_t[num_rows << SDRAM_BIT_BANKS];
+    }
+    st_window = (window > 0) ? (vluint64_t)window : 0;
+    reset_stats();
+    stats_on  = true;
+}
+
+// Performance counters cleared
+void SDRAM::reset_stats(void)
+{
+    memset((void *)st_bank, 0, sizeof(st_bank));
+    st_ref      = 0;
+    st_busy     = 0;
+    st_last     = ~(vluint64_t)0;
+    st_base     = st_cyc;
+    st_turn     = 0;
+    st_switch   = 0;
+    st_dir      = -1;
+    st_beat_cyc = 0;
+    for (int b = 0; b < SDRAM_NUM_BANKS; b++)
+    {
+        st_new_row[b] = false;
+    }
+    if (st_hist)
+    {
+        memset((void *)st_hist, 0, (num_rows << SDRAM_BIT_BANKS) * sizeof(vluint32_t));
+    }
+    st_bw_rd.clear();
+    st_bw_wr.clear();
+    st_win_act.clear();
+    st_win_ref.clear();
+    st_win_open.clear();
+    // Rows opened at reset
+    st_open_n   = 0;
+    st_open_cyc = 0;
+    st_any_at   = 0;
+    for (int b = 0; b < SDRAM_NUM_BANKS; b++)
+    {
+        st_open_at[b] = 0;
+        if (row_act[b]) st_open_n++;
+    }
+    st_pd_ps[0] = 0;
+    st_pd_ps[1] = 0;
+    st_pd_ps[2] = 0;
+}
+
+// Energy estimation parameters
+void SDRAM::set_power_params(const sdram_power_t &params)
+{
+    pw = params;
+    if (pw.chips < 1) pw.chips = 1;
+}
+
+// Windows counters allocation
+void SDRAM::stats_win_size(vluint64_t w)
+{
+    if (w >= (vluint64_t)st_bw_rd.size())
+    {
+        st_bw_rd.resize(w + 1, 0);
+        st_bw_wr.resize(w + 1, 0);
+        st_win_act.resize(w + 1, 0);
+        st_win_ref.resize(w + 1, 0);
+        st_win_open.resize(w + 1, 0);
+    }
+}
+
+// Cycles [beg, end) with an opened row, split on windows
+void SDRAM::stats_open_add(vluint64_t beg, vluint64_t end, std::vector<vluint32_t> &win)
+{
+    while (beg < end)
+    {
+        vluint64_t w   = beg / st_window;
+        vluint64_t lim = (w + 1) * st_window;
+
+        lim = (lim > end) ? end : lim;
+        if (w >= (vluint64_t)win.size()) win.resize(w + 1, 0);
+        win[w] += (vluint32_t)(lim - beg);
+        beg = lim;
+    }
+}
+
+// Row opened or closed (activate, precharge, auto-precharge)
+void SDRAM::stats_row(int b, bool open)
+{
+    vluint64_t cyc = st_cyc - st_base;
+
+    if (open)
+    {
+        st_open_at[b] = cyc;
+        if (!st_open_n++) st_any_at = cyc;
+    }
+    else
+    {
+        st_bank[b].open_cyc += cyc - st_open_at[b];
+        if (!--st_open_n)
+        {
+            st_open_cyc += cyc - st_any_at;
+            if (st_window) stats_open_add(st_any_at, cyc, st_win_open);
+        }
+    }
+}
+
+// CKE change : power-down or self refresh entry/exit
+// (self refresh : auto refresh command with CKE low)
+void SDRAM::stats_cke(vluint64_t ts, vluint8_t cke, vluint8_t cs_n,
+                      vluint8_t ras_n, vluint8_t cas_n, vluint8_t we_n)
+{
+    prev_cke = cke;
+    if (!stats_on) return;
+
+    if (!cke)
+    {
+        st_cke_ts   = ts;
+        if ((!cs_n) && (!ras_n) && (!cas_n) && (we_n))
+            st_cke_mode = 2;
+        else
+            st_cke_mode = (st_open_n) ? 1 : 0;
+    }
+    else if (st_cke_mode >= 0)
+    {
+        st_pd_ps[st_cke_mode] += ts - st_cke_ts;
+        st_cke_mode = -1;
+    }
+}
+
+// Energy estimation from the counters (pJ : mA x V x ns)
+// win : energy per bandwidth window (optional)
+void SDRAM::stats_energy(energy_t &e, std::vector<double> *win)
+{
+    vluint64_t cyc   = st_cyc - st_base;
+    vluint64_t open  = st_open_cyc;
+    double     k     = (double)pw.chips * pw.vdd;
+    double     e_act = k * (pw.idd0 * pw.t_rc - (pw.idd3n * pw.t_ras + pw.idd2n * (pw.t_rc - pw.t_ras)));
+    double     e_rd  = k * (pw.idd4r - pw.idd3n) * pw.t_ck;
+    double     e_wr  = k * (pw.idd4w - pw.idd3n) * pw.t_ck;
+    double     e_ref = k * (pw.idd5 - pw.idd3n) * pw.t_rfc;
+    std::vector<vluint32_t> w_open = st_win_open;
+
+    // Rows still opened
+    if (st_open_n)
+    {
+        open += cyc - st_any_at;
+        if (st_window) stats_open_add(st_any_at, cyc, w_open);
+    }
+
+    memset((void *)&e, 0, sizeof(e));
+    for (int b = 0; b < SDRAM_NUM_BANKS; b++)
+    {
+        double act = (double)st_bank[b].act * e_act;
+        double rd  = (double)st_bank[b].rd_beat * e_rd;
+        double wr  = (double)st_bank[b].wr_beat * e_wr;
+
+        e.activate += act;
+        e.read     += rd;
+        e.write    += wr;
+        e.bank[b]   = act + rd + wr;
+    }
+    e.background   = k * pw.t_ck * ((double)open * pw.idd3n + (double)(cyc - open) * pw.idd2n);
+    e.refresh      = (double)st_ref * e_ref;
+    e.power_down   = k * ((double)st_pd_ps[0] * pw.idd2p + (double)st_pd_ps[1] * pw.idd3p) * 1e-3;
+    e.self_refresh = k * (double)st_pd_ps[2] * pw.idd6 * 1e-3;
+    e.total        = e.background + e.activate + e.read + e.write + e.refresh
+                   + e.power_down + e.self_refresh;
+
+    if ((win) && (st_window) && (cyc))
+    {
+        vluint64_t num = (cyc - 1) / st_window + 1;
+
+        stats_win_size(num - 1);
+        w_open.resize(num, 0);
+        win->resize(num);
+        for (vluint64_t w = 0; w < num; w++)
+        {
+            vluint64_t w_cyc = (cyc - w * st_window > st_window) ? st_window : cyc - w * st_window;
+
+            (*win)[w] = k * pw.t_ck * ((double)w_open[w] * pw.idd3n + (double)(w_cyc - w_open[w]) * pw.idd2n)
+                      + (double)st_win_act[w] * e_act + (double)st_win_ref[w] * e_ref
+                      + (double)(st_bw_rd[w] >> bus_log2) * e_rd + (double)(st_bw_wr[w] >> bus_log2) * e_wr;
+        }
+    }
+}
+
+// Estimated energy since the counters reset (pJ)
+double SDRAM::get_energy(void)
+{
+    energy_t e;
+
+    stats_energy(e, (std::vector<double> *)NULL);
+    return e.total;
+}
+
+// Cycle with bus activity
+inline void SDRAM::stats_busy(void)
+{
+    if (st_last != st_cyc)
+    {
+        st_last = st_cyc;
+        st_busy++;
+    }
+}
+
+// Command counters
+void SDRAM::stats_cmd(vluint8_t cmd, vluint8_t ba, vluint16_t a10)
+{
+    stats_busy();
+    switch (cmd)
+    {
+        case CMD_REF:
+        {
+            st_ref++;
+            if (st_window)
+            {
+                vluint64_t w = (st_cyc - st_base) / st_window;
+
+                stats_win_size(w);
+                st_win_ref[w]++;
+            }
+            break;
+        }
+        case CMD_PRE:
+        {
+            if (a10)
+            {
+                for (int b = 0; b < SDRAM_NUM_BANKS; b++)
+                {
+                    if (row_act[b]) st_bank[b].pre++;
+                }
+            }
+            else
+            {
+                st_bank[ba].pre++;
+            }
+            break;
+        }
+        case CMD_ACT:
+        {
+            st_bank[ba].act++;
+            st_new_row[ba] = true;
+            if (st_window)
+            {
+                vluint64_t w = (st_cyc - st_base) / st_window;
+
+                stats_win_size(w);
+                st_win_act[w]++;
+            }
+            break;
+        }
+        case CMD_WR:
+        case CMD_RD:
+        {
+            if (cmd == CMD_WR)
+                st_bank[ba].wr_cmd++;
+            else
+                st_bank[ba].rd_cmd++;
+            // First access after an activate : row miss
+            if (st_new_row[ba])
+                st_bank[ba].row_miss++;
+            else
+                st_bank[ba].row_hit++;
+            st_new_row[ba] = false;
+            if (st_hist)
+            {
+                st_hist[(ba << bit_rows) + (row_addr[ba] >> bit_cols)]++;
+            }
+            break;
+        }
+        default: ;
+    }
+}
+
+// Data beat counters (dir : 0 = read, 1 = write)
+void SDRAM::stats_beat(int dir)
+{
+    vluint64_t cyc = st_cyc - st_base;
+
+    stats_busy();
+    if (dir)
+        st_bank[bank].wr_beat++;
+    else
+        st_bank[bank].rd_beat++;
+
+    // Bus turnaround : empty cycles between the two directions
+    // (longer gaps are idle cycles)
+    if ((st_dir >= 0) && (st_dir != dir))
+    {
+        st_switch++;
+        if (cyc - st_beat_cyc <= STATS_TURN_MAX) st_turn += cyc - st_beat_cyc - 1;
+    }
+    st_dir      = dir;
+    st_beat_cyc = cyc;
+
+    // Bandwidth samples
+    if (st_window)
+    {
+        vluint64_t w = cyc / st_window;
+
+        stats_win_size(w);
+        if (dir)
+            st_bw_wr[w] += (vluint32_t)1 << bus_log2;
+        else
+            st_bw_rd[w] += (vluint32_t)1 << bus_log2;
+    }
+}
+
+// Performance counters export (".json" : JSON, otherwise CSV)
+void SDRAM::save_stats(const char *name)
+{
+    static const char *c_names[10] =
+    {
+        "act", "pre", "ap", "rd_cmd", "wr_cmd", "rd_beat", "wr_beat", "row_hit", "row_miss", "open_cyc"
+    };
+    static const char *c_energy[8] =
+    {
+        "background", "activate", "read", "write", "refresh", "power_down", "self_refresh", "total"
+    };
+    const char *ext  = strrchr(name, '.');
+    bool        json = (ext) && (!strcmp(ext, ".json"));
+    vluint64_t  cyc  = st_cyc - st_base;
+    bank_stats_t bk[SDRAM_NUM_BANKS];
+    energy_t    en;
+    std::vector<double> en_win;
+    FILE       *fh;
+
+    // Rows still opened
+    memcpy((void *)bk, (const void *)st_bank, sizeof(bk));
+    for (int b = 0; b < SDRAM_NUM_BANKS; b++)
+    {
+        if (row_act[b]) bk[b].open_cyc += cyc - st_open_at[b];
+    }
+    stats_energy(en, &en_win);
+
+    fh = fopen(name, "w");
+    if (!fh)
+    {
+        printf("Cannot create SDRAM statistics file \"%s\" !!\n", name);
+        return;
+    }
+
+    if (json)
+    {
+        fprintf(fh, "{\n");
+        fprintf(fh, "  \"cycles\": %llu,\n",     (unsigned long long)cyc);
+        fprintf(fh, "  \"idle\": %llu,\n",       (unsigned long long)(cyc - st_busy));
+        fprintf(fh, "  \"turnaround\": %llu,\n", (unsigned long long)st_turn);
+        fprintf(fh, "  \"switches\": %llu,\n",   (unsigned long long)st_switch);
+        fprintf(fh, "  \"refresh\": %llu,\n",    (unsigned long long)st_ref);
+        fprintf(fh, "  \"bus_bytes\": %d,\n",    1 << bus_log2);
+        fprintf(fh, "  \"power_down_ps\": %llu,\n",        (unsigned long long)st_pd_ps[0]);
+        fprintf(fh, "  \"active_power_down_ps\": %llu,\n", (unsigned long long)st_pd_ps[1]);
+        fprintf(fh, "  \"self_refresh_ps\": %llu,\n",      (unsigned long long)st_pd_ps[2]);
+        fprintf(fh, "  \"banks\": [\n");
+        for (int b = 0; b < SDRAM_NUM_BANKS; b++)
+        {
+            const vluint64_t *ctr = (const vluint64_t *)&bk[b];
+
+            fprintf(fh, "    {");
+            for (int i = 0; i < 10; i++)
+            {
+                fprintf(fh, "%s\"%s\": %llu", (i) ? ", " : " ", c_names[i], (unsigned long long)ctr[i]);
+            }
+            fprintf(fh, ", \"energy_pj\": %.1f }%s\n", en.bank[b], (b < SDRAM_NUM_BANKS - 1) ? "," : "");
+        }
+        fprintf(fh, "  ],\n  \"energy_pj\": {");
+        for (int i = 0; i < 8; i++)
+        {
+            fprintf(fh, "%s\"%s\": %.1f", (i) ? ", " : " ", c_energy[i], ((const double *)&en)[i]);
+        }
+        fprintf(fh, " }");
+        if (st_hist)
+        {
+            bool first = true;
+
+            fprintf(fh, ",\n  \"row_hist\": [");
+            for (int r = 0; r < (num_rows << SDRAM_BIT_BANKS); r++)
+            {
+                if (!st_hist[r]) continue;
+                fprintf(fh, "%s\n    [%d, %d, %u]", (first) ? "" : ",", r >> bit_rows, r & (num_rows - 1), st_hist[r]);
+                first = false;
+            }
+            fprintf(fh, "\n  ]");
+        }
+        if (st_window)
+        {
+            fprintf(fh, ",\n  \"bandwidth\": {\n    \"window\": %llu,\n    \"rd_bytes\": [",
+                    (unsigned long long)st_window);
+            for (size_t w = 0; w < st_bw_rd.size(); w++)
+            {
+                fprintf(fh, "%s%u", (w) ? ", " : "", st_bw_rd[w]);
+            }
+            fprintf(fh, "],\n    \"wr_bytes\": [");
+            for (size_t w = 0; w < st_bw_wr.size(); w++)
+            {
+                fprintf(fh, "%s%u", (w) ? ", " : "", st_bw_wr[w]);
+            }
+            fprintf(fh, "],\n    \"energy_pj\": [");
+            for (size_t w = 0; w < en_win.size(); w++)
+            {
+                fprintf(fh, "%s%.1f", (w) ? ", " : "", en_win[w]);
+            }
+            fprintf(fh, "]\n  }");
+        }
+        fprintf(fh, "\n}\n");
+    }
+    else
+    {
+        // counter,bank,index,value
+        fprintf(fh, "counter,bank,index,value\n");
+        fprintf(fh, "cycles,,,%llu\n",     (unsigned long long)cyc);
+        fprintf(fh, "idle,,,%llu\n",       (unsigned long long)(cyc - st_busy));
+        fprintf(fh, "turnaround,,,%llu\n", (unsigned long long)st_turn);
+        fprintf(fh, "switches,,,%llu\n",   (unsigned long long)st_switch);
+        fprintf(fh, "refresh,,,%llu\n",    (unsigned long long)st_ref);
+        fprintf(fh, "bus_bytes,,,%d\n",    1 << bus_log2);
+        fprintf(fh, "power_down_ps,,,%llu\n",        (unsigned long long)st_pd_ps[0]);
+        fprintf(fh, "active_power_down_ps,,,%llu\n", (unsigned long long)st_pd_ps[1]);
+        fprintf(fh, "self_refresh_ps,,,%llu\n",      (unsigned long long)st_pd_ps[2]);
+        for (int i = 0; i < 8; i++)
+        {
+            fprintf(fh, "energy_%s,,,%.1f\n", c_energy[i], ((const double *)&en)[i]);
+        }
+        for (int b = 0; b < SDRAM_NUM_BANKS; b++)
+        {
+            const vluint64_t *ctr = (const vluint64_t *)&bk[b];
+
+            for (int i = 0; i < 10; i++)
+            {
+                fprintf(fh, "%s,%d,,%llu\n", c_names[i], b, (unsigned long long)ctr[i]);
+            }
+            fprintf(fh, "energy_bank,%d,,%.1f\n", b, en.bank[b]);
+        }
+        if (st_hist)
+        {
+            for (int r = 0; r < (num_rows << SDRAM_BIT_BANKS); r++)
+            {
+                if (!st_hist[r]) continue;
+                fprintf(fh, "row_hist,%d,%d,%u\n", r >> bit_rows, r & (num_rows - 1), st_hist[r]);
+            }
+        }
+        for (size_t w = 0; w < st_bw_rd.size(); w++)
+        {
+            fprintf(fh, "rd_bytes,,%d,%u\n", (int)w, st_bw_rd[w]);
+            fprintf(fh, "wr_bytes,,%d,%u\n", (int)w, st_bw_wr[w]);
+        }
+        for (size_t w = 0; w < en_win.size(); w++)
+        {
+            fprintf(fh, "energy_window,,%d,%.1f\n", (int)w, en_win[w]);
+        }
+    }
+    fclose(fh);
+    printf("SDRAM statistics saved to \"%s\"\n", name);
+}
+
+// Transaction level read : "beats" data bus words, as seen on the DQ pins
+// (zeroes on an out of range burst)
+void SDRAM::tlm_read(vluint64_t addr, int beats, vluint64_t *data)
+{
+    vluint64_t a = (vluint64_t)addr & ~(vluint64_t)bus_mask;
+
+    if (!block_check(a, (vluint64_t)beats << bus_log2))
+    {
+        if (beats > 0) memset((void *)data, 0, (size_t)beats * sizeof(vluint64_t));
+        return;
+    }
+
+    for (int i = 0; i < beats; i++, a += (vluint64_t)1 << bus_log2)
+    {
+        vluint8_t *ptr = mem_base + image_offs(a);
+
+        switch (bus_log2)
+        {
+            case 0  : data[i] = (vluint64_t)*ptr;                 break;
+            case 1  : data[i] = (vluint64_t)*(vluint16_t *)ptr;   break;
+            case 2  : data[i] = (vluint64_t)*(vluint32_t *)ptr;   break;
+            default : data[i] = *(vluint64_t *)ptr;
+        }
+        if ((watch_on) && (watch_test(a))) watch_check(a, bus_mask + 1, SDRAM_WATCH_RD, data[i]);
+    }
+}
+
+// Transaction level write : "beats" data bus words, as seen on the DQ pins
+// mask : DQM pins value per beat (1 : byte not written), NULL : no mask
+void SDRAM::tlm_write(vluint64_t addr, int beats, const vluint64_t *data, const vluint8_t *mask)
+{
+    vluint64_t a = (vluint64_t)addr & ~(vluint64_t)bus_mask;
+
+    if (!block_check(a, (vluint64_t)beats << bus_log2)) return;
+
+    for (int i = 0; i < beats; i++, a += (vluint64_t)1 << bus_log2)
+    {
+        vluint8_t *ptr = mem_base + image_offs(a);
+        vluint64_t dqm_mask = (mask) ? c_dqm_mask[mask[i]] : ~(vluint64_t)0;
+
+        if ((watch_on) && (watch_test(a))) watch_check(a, bus_mask + 1, SDRAM_WATCH_WR, data[i]);
+
+        switch (bus_log2)
+        {
+            case 0 :
+            {
+                if (dqm_mask & 0xFF) *ptr = (vluint8_t)data[i];
+                break;
+            }
+            case 1 :
+            {
+                vluint16_t *p16 = (vluint16_t *)ptr;
+
+                *p16 = ((vluint16_t)data[i] & (vluint16_t)dqm_mask) | (*p16 & ~(vluint16_t)dqm_mask);
+                break;
+            }
+            case 2 :
+            {
+                vluint32_t *p32 = (vluint32_t *)ptr;
+
+                *p32 = ((vluint32_t)data[i] & (vluint32_t)dqm_mask) | (*p32 & ~(vluint32_t)dqm_mask);
+                break;
+            }
+            default :
+            {
+                vluint64_t *p64 = (vluint64_t *)ptr;
+
+                *p64 = (data[i] & dqm_mask) | (*p64 & ~dqm_mask);
+            }
+        }
+    }
+}
+
+// Block transfer range check
+bool SDRAM::block_check(vluint64_t addr, vluint64_t size)
+{
+    if ((vluint64_t)addr + (vluint64_t)size > map_size)
+    {
+        printf("SDRAM block access out of range (0x%08llX bytes @ 0x%08llX) !!\n",
+               (unsigned long long)size, (unsigned long long)addr);
+        return false;
+    }
+    return true;
+}
+
+// Read a block
+void SDRAM::read_block(vluint64_t addr, vluint8_t *buf, vluint64_t size)
+{
+    if (!block_check(addr, size))
+    {
+        // Defined contents for the caller (DPI output array)
+        memset((void *)buf, 0, (size_t)size);
+        return;
+    }
+
+    image_copy_mt(buf, (vluint64_t)addr, (vluint64_t)size, false);
+}
+
+// Write a block
+void SDRAM::write_block(vluint64_t addr, const vluint8_t *buf, vluint64_t size)
+{
+    if (!block_check(addr, size)) return;
+
+    image_copy_mt((vluint8_t *)buf, (vluint64_t)addr, (vluint64_t)size, true);
+}
+
+// Fill a block with a byte value (no byte swap needed)
+void SDRAM::fill_block(vluint64_t addr, vluint8_t data, vluint64_t size)
+{
+    vluint64_t row_size = (vluint64_t)1 << (bit_cols + bus_log2);
+    vluint64_t a        = (vluint64_t)addr;
+    vluint64_t n        = (vluint64_t)size;
+
+    if (!block_check(addr, size)) return;
+
+    while (n)
+    {
+        // Contiguous banks : one chunk, interleaved banks : one row
+        vluint64_t len  = (mem_flags & FLAG_BANK_INTERLEAVING) ? row_size - (a & (row_size - 1)) : n;
+        vluint64_t offs = image_offs(a);
+
+        len = (len > n) ? n : len;
+        if (page_state) map_range(offs, len, true);
+        if ((lane_xor) && (((offs | len) & bus_mask) != 0))
+        {
+            // Partial data bus words : lane swap
+            for (vluint64_t i = 0; i < len; i++)
+            {
+                mem_base[(offs + i) ^ lane_xor] = data;
+            }
+        }
+        else
+        {
+            memset((void *)(mem_base + offs), data, len);
+        }
+        a += len;
+        n -= len;
+    }
+}
+
+// Compare a block
+vlsint64_t SDRAM::compare_block(vluint64_t addr, const vluint8_t *buf, vluint64_t size)
+{
+    vluint8_t  tmp[4096];
+    vluint64_t pos = 0;
+    std::vector<vluint8_t> pbuf((sparse_on) ? (size_t)1 << page_log2 : 0);
+    vluint64_t pb_page = ~(vluint64_t)0;
+
+    if (!block_check(addr, size)) return (vlsint64_t)-2;
+
+    while (pos < (vluint64_t)size)
+    {
+        vluint64_t len = (vluint64_t)size - pos;
+
+        len = (len > sizeof(tmp)) ? sizeof(tmp) : len;
+        image_peek(tmp, (vluint64_t)addr + pos, len, pbuf.data(), pb_page);
+        if (memcmp((const void *)tmp, (const void *)(buf + pos), len))
+        {
+            // First different byte
+            for (vluint64_t i = 0; i < len; i++)
+            {
+                if (tmp[i] != buf[pos + i]) return (vlsint64_t)((vluint64_t)addr + pos + i);
+            }
+        }
+        pos += len;
+    }
+    return (vlsint64_t)-1;
+}
+
+// Watchpoint creation (image addresses, mode : SDRAM_WATCH_xx)
+int SDRAM::add_watch(vluint64_t addr, vluint64_t size, int mode)
+{
+    watch_t w;
+
+    if ((!size) || (!block_check(addr, size))) return -1;
+
+    w.addr = addr;
+    w.size = size;
+    w.mode = mode & SDRAM_WATCH_RW;
+    w.id   = watch_id++;
+    // Sorted by address
+    std::vector<watch_t>::iterator it = watch_list.begin();
+    while ((it != watch_list.end()) && (it->addr <= addr)) it++;
+    watch_list.insert(it, w);
+    watch_build();
+
+    return w.id;
+}
+
+// Watchpoint removal
+void SDRAM::del_watch(int id)
+{
+    for (std::vector<watch_t>::iterator it = watch_list.begin(); it != watch_list.end(); it++)
+    {
+        if (it->id == id)
+        {
+            watch_list.erase(it);
+            break;
+        }
+    }
+    watch_build();
+}
+
+// Watchpoint hits call-back
+void SDRAM::set_watch_callback(sdram_watch_cb_t cb, void *user)
+{
+    watch_cb   = cb;
+    watch_user = user;
+}
+
+// Watched pages bitmap
+void SDRAM::watch_build(void)
+{
+    vluint64_t words = ((map_size >> SDRAM_WATCH_LOG2) + 63) >> 6;
+
+    watch_on = false;
+    if (!watch_map)
+    {
+        watch_map = new vluint64_t[words];
+    }
+    memset((void *)watch_map, 0, words * sizeof(vluint64_t));
+    for (size_t i = 0; i < watch_list.size(); i++)
+    {
+        vluint64_t beg = watch_list[i].addr >> SDRAM_WATCH_LOG2;
+        vluint64_t end = (watch_list[i].addr + watch_list[i].size - 1) >> SDRAM_WATCH_LOG2;
+
+        for (vluint64_t p = beg; p <= end; p++)
+        {
+            watch_map[p >> 6] |= (vluint64_t)1 << (p & 63);
+        }
+    }
+    // Accesses are only checked with at least one watchpoint
+    watch_on = !watch_list.empty();
+}
+
+// Access to a watched page : ranges check
+void SDRAM::watch_check(vluint64_t addr, int size, int mode, vluint64_t data)
+{
+    vluint64_t a = addr & (map_size - 1);
+
+    for (size_t i = 0; i < watch_list.size(); i++)
+    {
+        const watch_t &w = watch_list[i];
+
+        // Sorted list : no more ranges before the access end
+        if (w.addr >= a + (vluint64_t)size) break;
+        if ((w.addr + w.size <= a) || (!(w.mode & mode))) continue;
+
+        watch_hits++;
+        if (watch_cb)
+        {
+            watch_cb(watch_user, w.id, watch_ts, a, size, mode, data);
+        }
+        else if (watch_hits <= SDRAM_WATCH_MAX_LOG)
+        {
+            printf("SDRAM watchpoint #%d @ %llu ps : %s 0x%0*llX @ 0x%08llX\n",
+                   w.id, (unsigned long long)watch_ts, (mode == SDRAM_WATCH_WR) ? "Wr" : "Rd",
+                   size * 2, (unsigned long long)data, (unsigned long long)a);
+            if (watch_hits == SDRAM_WATCH_MAX_LOG)
+            {
+                printf("SDRAM watchpoint : log limit reached, hits are only counted\n");
+            }
+        }
+    }
+}
+
+// Read a byte
+vluint8_t SDRAM::read_byte(vluint64_t addr)
+{
+    vluint8_t data = (this->*read_u8_priv)(addr);
+
+    if ((watch_on) && (watch_test(addr))) watch_check(addr, 1, SDRAM_WATCH_RD, (vluint64_t)data);
+    return data;
+}
+
+// Read a word
+vluint16_t SDRAM::read_word(vluint64_t addr)
+{
+    vluint16_t data = (this->*read_u16_priv)(addr);
+
+    if ((watch_on) && (watch_test(addr))) watch_check(addr, 2, SDRAM_WATCH_RD, (vluint64_t)data);
+    return data;
+}
+
+// Read a long
+vluint32_t SDRAM::read_long(vluint64_t addr)
+{
+    vluint32_t data = (this->*read_u32_priv)(addr);
+
+    if ((watch_on) && (watch_test(addr))) watch_check(addr, 4, SDRAM_WATCH_RD, (vluint64_t)data);
+    return data;
+}
+
+// Read a quad
+vluint64_t SDRAM::read_quad(vluint64_t addr)
+{
+    vluint64_t data = (this->*read_u64_priv)(addr);
+
+    if ((watch_on) && (watch_test(addr))) watch_check(addr, 8, SDRAM_WATCH_RD, (vluint64_t)data);
+    return data;
+}
+
+// Write a byte
+void SDRAM::write_byte(vluint64_t addr, vluint8_t data)
+{
+    if ((watch_on) && (watch_test(addr))) watch_check(addr, 1, SDRAM_WATCH_WR, (vluint64_t)data);
+    return (this->*write_u8_priv)(addr, data);
+}
+
+// Write a word
+void SDRAM::write_word(vluint64_t addr, vluint16_t data)
+{
+    if ((watch_on) && (watch_test(addr))) watch_check(addr, 2, SDRAM_WATCH_WR, (vluint64_t)data);
+    return (this->*write_u16_priv)(addr, data);
+}
+
+// Write a long
+void SDRAM::write_long(vluint64_t addr, vluint32_t data)
+{
+    if ((watch_on) && (watch_test(addr))) watch_check(addr, 4, SDRAM_WATCH_WR, (vluint64_t)data);
+    return (this->*write_u32_priv)(addr, data);
+}
+
+// Write a quad
+void SDRAM::write_quad(vluint64_t addr, vluint64_t data)
+{
+    if ((watch_on) && (watch_test(addr))) watch_check(addr, 8, SDRAM_WATCH_WR, (vluint64_t)data);
+    return (this->*write_u64_priv)(addr, data);
+}
+
+// Rising edge on clock (when eval() fast path is not taken)
+void SDRAM::eval_edge
+(
+    // Timestamp from clock generator
+    vluint64_t ts,
+    // SDRAM commands
+    vluint8_t cs_n,
+    vluint8_t ras_n,
+    vluint8_t cas_n,
+    vluint8_t we_n,
+    // SDRAM address
+    vluint8_t ba,
+    vluint16_t addr,
+    // SDRAM data bus
+    vluint8_t dqm,
+    vluint64_t dq_in,
+    vluint64_t &dq_out
+)
+{
+    watch_ts = ts;
+    
+    // Command pipeline
+    cmd_pipe.pipe >>= 8;
+    cmd_pipe.u8[3] = CMD_NOP;
+    col_pipe.pipe >>= 16;
+    ba_pipe.pipe  >>= 8;
+    bap_pipe.pipe >>= 8;
+    a10_pipe.pipe >>= 16;
+
+    // DQM pipeline
+    dqm_pipe[0] = dqm_pipe[1];
+    dqm_pipe[1] = dqm;
+    
+    // Process SDRAM command (immediate)
+    if (!cs_n)
+    {
+        // cmd[2:0] = { ras_n, cas_n, we_n }
+        vluint8_t  cmd = (ras_n << 2) | (cas_n << 1) | we_n;
+        // addr[10] wire
+        vluint16_t a10 = addr & 0x400;
+        
+        if ((blog_on) && (cmd != CMD_NOP))
+            blog_put(ts, cmd, ba, (vluint64_t)addr, (a10) ? SDRAM_LOG_A10 : 0, 0, 0);
+        if ((stats_on) && (cmd != CMD_NOP))
+            stats_cmd(cmd, ba, a10);
+        
+        switch (cmd)
+        {
+            // 3'b000 : Load mode register
+            case CMD_LMR:
+            {
+                if (dbg_on)
+                {
+                    printf("Load Std Mode Register @ %llu ps\n", ts);
+                    log_size += sprintf(log_buf + log_size, "%15llu ps : Load Std Mode Register\n", ts);
+                }
+                    
+                // CAS latency
+                switch((addr >> 4) & 7)
                 {
-                    // 3'b000 : Load mode register
-                    case CMD_LMR:
+                    case 2:
                     {
                         if (dbg_on)
                         {
-                            printf("Load Std Mode Register @ %llu ps\n", ts);
-                            log_size += sprintf(log_buf + log_size, "%15llu ps : Load Std Mode Register\n", ts);
-                        }
-                            
-                        // CAS latency
-                        switch((addr >> 4) & 7)
-                        {
-                            case 2:
-                            {
-                                if (dbg_on)
-                                {
-                                    printf("CAS latency        = 2 cycles\n");
-                                    log_size += sprintf(log_buf + log_size, "                     CAS latency        = 2 cycles\n");
-                                }
-                                cas_lat = (int)2;
-                                break;
-                            }
-                            case 3:
-                            {
-                                if (dbg_on)
-                                {
-                                    printf("CAS latency        = 3 cycles\n");
-                                    log_size += sprintf(log_buf + log_size, "                     CAS latency        = 3 cycles\n");
-                                }
-                                cas_lat = (int)3;
-                                break;
-                            }
-                            default:
-                            {
-                                if (dbg_on)
-                                {
-                                    printf("CAS latency        = ???\n");
-                                    log_size += sprintf(log_buf + log_size, "                     CAS latency        = ???\n");
-                                }
-                                cas_lat = (int)0; // This disables pipelined commands
-                            }
-                        }
-                        
-                        // Burst length + Burst type
-                        bst_type = (vluint8_t)0;
-                        switch (addr & 0xF)
-                        {
-                            case 0x8:
-                            case 0x0:
-                            {
-                                if (dbg_on)
-                                {
-                                    printf("Read burst length  = 1 word\n");
-                                    log_size += sprintf(log_buf + log_size, "                     Read burst length  = 1 word\n");
-                                }
-                                bst_len_rd = 1;
-                                bst_msk_rd = 0;
-                                break;
-                            }
-                            case 0x9:
-                            case 0x1:
-                            {
-                                if (dbg_on)
-                                {
-                                    printf("Read burst length  = 2 words\n");
-                                    log_size += sprintf(log_buf + log_size, "                     Read burst length  = 2 words\n");
-                                }
-                                bst_len_rd = 2;
-                                bst_msk_rd = 1;
-                                break;
-                            }
-                            case 0xA:
-                            {
-                                bst_type = (vluint8_t)1;
-                            }
-                            case 0x2:
-                            {
-                                if (dbg_on)
-                                {
-                                    printf("Read burst length  = 4 words\n");
-                                    log_size += sprintf(log_buf + log_size, "                     Read burst length  = 4 words\n");
-                                }
-                                bst_len_rd = 4;
-                                bst_msk_rd = 3;
-                                break;
-                            }
-                            case 0xB:
-                            {
-                                bst_type = (vluint8_t)1;
-                            }
-                            case 0x3:
-                            {
-                                if (dbg_on)
-                                {
-                                    printf("Read burst length  = 8 words\n");
-                                    log_size += sprintf(log_buf + log_size, "                     Read burst length  = 8 words\n");
-                                }
-                                bst_len_rd = 8;
-                                bst_msk_rd = 7;
-                                break;
-                            }
-                            case 0x7:
-                            {
-                                if (dbg_on)
-                                {
-                                    printf("Read burst length  = continuous\n");
-                                    log_size += sprintf(log_buf + log_size, "                     Read burst length  = continuous\n");
-                                }
-                                bst_len_rd = num_cols;
-                                bst_msk_rd = num_cols - 1;
-                                break;
-                            }
-                            default:
-                            {
-                                if (dbg_on)
-                                {
-                                    printf("Read burst length  = ???\n");
-                                    log_size += sprintf(log_buf + log_size, "                     Read burst length  = ???\n");
-                                }
-                                bst_len_rd = 0; // This will disable burst read
-                                bst_msk_rd = 0;
-                            }
+                            printf("CAS latency        = 2 cycles\n");
+                            log_size += sprintf(log_buf + log_size, "                     CAS latency        = 2 cycles\n");
                         }
+                        cas_lat = (int)2;
+                        break;
+                    }
+                    case 3:
+                    {
                         if (dbg_on)
                         {
-                            if (addr & 8)
-                            {
-                                printf("Burst type         = interleaved\n");
-                                log_size += sprintf(log_buf + log_size, "                     Burst type         = interleaved\n");
-                            }
-                            else
-                            {
-                                printf("Burst type         = sequential\n");
-                                log_size += sprintf(log_buf + log_size, "                     Burst type         = sequential\n");
-                            }
+                            printf("CAS latency        = 3 cycles\n");
+                            log_size += sprintf(log_buf + log_size, "                     CAS latency        = 3 cycles\n");
                         }
-                        
-                        // Write burst
-                        if (addr & 0x0200)
+                        cas_lat = (int)3;
+                        break;
+                    }
+                    default:
+                    {
+                        if (dbg_on)
                         {
-                            if (dbg_on)
-                            {
-                                printf("Write burst length = 1\n");
-                                log_size += sprintf(log_buf + log_size, "                     Write burst length = 1\n");
-                            }
-                            bst_len_wr = 1;
-                            bst_msk_wr = 0;
+                            printf("CAS latency        = ???\n");
+                            log_size += sprintf(log_buf + log_size, "                     CAS latency        = ???\n");
                         }
-                        else
+                        cas_lat = (int)0; // This disables pipelined commands
+                    }
+                }
+                
+                // Burst length + Burst type
+                bst_type = (vluint8_t)0;
+                switch (addr & 0xF)
+                {
+                    case 0x8:
+                    case 0x0:
+                    {
+                        if (dbg_on)
                         {
-                            if (dbg_on)
-                            {
-                                if (bst_len_rd)
-                                {
-                                    if (bst_len_rd <= (int)8)
-                                    {
-                                        printf("Write burst length = %d word(s)\n", bst_len_rd);
-                                        log_size += sprintf(log_buf + log_size, "                     Write burst length = %d word(s)\n", bst_len_rd);
-                                    }
-                                    else
-                                    {
-                                        printf("Write burst length = continuous\n");
-                                        log_size += sprintf(log_buf + log_size, "                     Write burst length = continuous\n");
-                                    }
-                                }
-                                else
-                                {
-                                    // This disables burst write
-                                    printf("Write burst length = ???\n");
-                                    log_size += sprintf(log_buf + log_size, "                     Write burst length = ???\n");
-                                }
-                            }
-                            bst_len_wr = bst_len_rd;
-                            bst_msk_wr = bst_msk_rd;
+                            printf("Read burst length  = 1 word\n");
+                            log_size += sprintf(log_buf + log_size, "                     Read burst length  = 1 word\n");
                         }
+                        bst_len_rd = 1;
+                        bst_msk_rd = 0;
                         break;
                     }
-                    // 3'b001 : Auto refresh
-                    case CMD_REF:
+                    case 0x9:
+                    case 0x1:
                     {
                         if (dbg_on)
-                            log_size += sprintf(log_buf + log_size, "%15llu ps : Auto Refresh\n", ts);
-                        
-                        for (int i = 0; i < SDRAM_NUM_BANKS; i++)
                         {
-                            if (!row_pre[i])
-                            {
-                                printf("ERROR @ %llu ps : All banks must be Precharge before Auto Refresh\n", ts);
-                                break;
-                            }
+                            printf("Read burst length  = 2 words\n");
+                            log_size += sprintf(log_buf + log_size, "                     Read burst length  = 2 words\n");
                         }
+                        bst_len_rd = 2;
+                        bst_msk_rd = 1;
                         break;
                     }
-                    // 3'b010 : Precharge
-                    case CMD_PRE:
+                    case 0xA:
                     {
-                        if (a10)
-                        {
-                            if (dbg_on)
-                                log_size += sprintf(log_buf + log_size, "%15llu ps : Precharge all banks\n", ts);
-                            
-                            if (ap_bank[0] || ap_bank[1] || ap_bank[2] || ap_bank[3])
-                            {
-                                printf("ERROR @ %llu ps : at least one bank is auto-precharged !\n", ts);
-                                break;
-                            }
-                            
-                            // Precharge all banks
-                            for (int i = 0; i < SDRAM_NUM_BANKS; i++)
-                            {
-                                row_act[i] = 0;
-                                row_pre[i] = 1;
-                            }
-                        }
-                        else
+                        bst_type = (vluint8_t)1;
+                    }
+                    case 0x2:
+                    {
+                        if (dbg_on)
                         {
-                            if (dbg_on)
-                                log_size += sprintf(log_buf + log_size, "%15llu ps : Precharge bank #%d\n", ts, ba);
-                                
-                            if (ap_bank[ba])
-                            {
-                                printf("ERROR @ %llu ps : cannot apply a precharge to auto-precharged bank %d !\n", ts, ba);
-                                break;
-                            }
-                            
-                            // Precharge one bank
-                            row_act[ba] = 0;
-                            row_pre[ba] = 1;
+                            printf("Read burst length  = 4 words\n");
+                            log_size += sprintf(log_buf + log_size, "                     Read burst length  = 4 words\n");
                         }
-                        
-                        // Terminate a WRITE immediately
-                        if ((a10) || (bank == (int)ba))
-                            bst_ctr_wr = 0;
-                        
-                        // CAS latency pipeline for READ
-                        if (cas_lat)
+                        bst_len_rd = 4;
+                        bst_msk_rd = 3;
+                        break;
+                    }
+                    case 0xB:
+                    {
+                        bst_type = (vluint8_t)1;
+                    }
+                    case 0x3:
+                    {
+                        if (dbg_on)
                         {
-                            cmd_pipe.u8[cas_lat] = CMD_PRE;
-                            bap_pipe.u8[cas_lat] = ba;
-                            a10_pipe.u16[cas_lat] = a10;
+                            printf("Read burst length  = 8 words\n");
+                            log_size += sprintf(log_buf + log_size, "                     Read burst length  = 8 words\n");
                         }
-                        
+                        bst_len_rd = 8;
+                        bst_msk_rd = 7;
                         break;
                     }
-                    // 3'b011 : Activate
-                    case CMD_ACT:
+                    case 0x7:
                     {
                         if (dbg_on)
-                            log_size += sprintf(log_buf + log_size, "%15llu ps : Activate bank #%d, row #%d\n", ts, ba, addr);
-                                
-                        if (row_act[ba])
                         {
-                            printf("ERROR @ %llu ps : bank %d already active !\n", ts, ba);
-                            break;
+                            printf("Read burst length  = continuous\n");
+                            log_size += sprintf(log_buf + log_size, "                     Read burst length  = continuous\n");
                         }
-                           
-                        row_act[ba]  = 1;
-                        row_pre[ba]  = 0;
-                        row_addr[ba] = ((int)addr << bit_cols) & mask_rows;
-                        
+                        bst_len_rd = num_cols;
+                        bst_msk_rd = num_cols - 1;
                         break;
                     }
-                    // 3'b100 : Write
-                    case CMD_WR:
+                    default:
                     {
                         if (dbg_on)
-                            log_size += sprintf(log_buf + log_size,
-                                                "%15llu ps : Write%s bank #%d, col #%d\n",
-                                                ts, (a10) ? "(AP)" : "", ba, addr & mask_cols);
-                        
-                        if (!row_act[ba])
                         {
-                            printf("ERROR @ %llu ps : bank %d is not activated for WRITE !\n", ts, ba);
-                            break;
+                            printf("Read burst length  = ???\n");
+                            log_size += sprintf(log_buf + log_size, "                     Read burst length  = ???\n");
                         }
-                           
-                        // Latch command right away
-                        cmd_pipe.u8[0]  = CMD_WR;
-                        col_pipe.u16[0] = addr & mask_cols;
-                        ba_pipe.u8[0]   = ba;
+                        bst_len_rd = 0; // This will disable burst read
+                        bst_msk_rd = 0;
+                    }
+                }
+                if (dbg_on)
+                {
+                    if (addr & 8)
+                    {
+                        printf("Burst type         = interleaved\n");
+                        log_size += sprintf(log_buf + log_size, "                     Burst type         = interleaved\n");
+                    }
+                    else
+                    {
+                        printf("Burst type         = sequential\n");
+                        log_size += sprintf(log_buf + log_size, "                     Burst type         = sequential\n");
+                    }
+                }
                 
-                        // Auto-precharge
-                        ap_bank[ba] = a10;
-                        
-                        break;
+                // Write burst
+                if (addr & 0x0200)
+                {
+                    if (dbg_on)
+                    {
+                        printf("Write burst length = 1\n");
+                        log_size += sprintf(log_buf + log_size, "                     Write burst length = 1\n");
                     }
-                    // 3'b101 : Read
-                    case CMD_RD:
+                    bst_len_wr = 1;
+                    bst_msk_wr = 0;
+                }
+                else
+                {
+                    if (dbg_on)
                     {
-                        if (dbg_on)
-                            log_size += sprintf(log_buf + log_size,
-                                                "%15llu ps : Read%s bank #%d, col #%d\n",
-                                                ts, (a10) ? "(AP)" : "", ba, addr & mask_cols);
-                        
-                        if (!row_act[ba])
+                        if (bst_len_rd)
                         {
-                            printf("ERROR @ %llu ps : bank %d is not activated for READ !\n", ts, ba);
-                            break;
+                            if (bst_len_rd <= (int)8)
+                            {
+                                printf("Write burst length = %d word(s)\n", bst_len_rd);
+                                log_size += sprintf(log_buf + log_size, "                     Write burst length = %d word(s)\n", bst_len_rd);
+                            }
+                            else
+                            {
+                                printf("Write burst length = continuous\n");
+                                log_size += sprintf(log_buf + log_size, "                     Write burst length = continuous\n");
+                            }
                         }
-                           
-                        // CAS latency pipeline
-                        if (cas_lat)
+                        else
                         {
-                            cmd_pipe.u8[cas_lat]  = CMD_RD;
-                            col_pipe.u16[cas_lat] = addr & mask_cols;
-                            ba_pipe.u8[cas_lat]   = ba;
+                            // This disables burst write
+                            printf("Write burst length = ???\n");
+                            log_size += sprintf(log_buf + log_size, "                     Write burst length = ???\n");
                         }
-                        
-                        // Auto-precharge
-                        ap_bank[ba] = a10;
-                        
+                    }
+                    bst_len_wr = bst_len_rd;
+                    bst_msk_wr = bst_msk_rd;
+                }
+                break;
+            }
+            // 3'b001 : Auto refresh
+            case CMD_REF:
+            {
+                if (dbg_on)
+                    log_size += sprintf(log_buf + log_size, "%15llu ps : Auto Refresh\n", ts);
+                
+                for (int i = 0; i < SDRAM_NUM_BANKS; i++)
+                {
+                    if (!row_pre[i])
+                    {
+                        printf("ERROR @ %llu ps : All banks must be Precharge before Auto Refresh\n", ts);
+                        break;
+                    }
+                }
+                break;
+            }
+            // 3'b010 : Precharge
+            case CMD_PRE:
+            {
+                if (a10)
+                {
+                    if (dbg_on)
+                        log_size += sprintf(log_buf + log_size, "%15llu ps : Precharge all banks\n", ts);
+                    
+                    if (ap_bank[0] || ap_bank[1] || ap_bank[2] || ap_bank[3])
+                    {
+                        printf("ERROR @ %llu ps : at least one bank is auto-precharged !\n", ts);
                         break;
                     }
-                    // 3'b110 : Burst stop
-                    case CMD_BST:
+                    
+                    // Precharge all banks
+                    for (int i = 0; i < SDRAM_NUM_BANKS; i++)
                     {
-                        if (dbg_on)
-                            log_size += sprintf(log_buf + log_size, "%15llu ps : Burst Stop bank #%d\n", ts, ba);
-                            
-                        if (ap_bank[ba])
-                        {
-                            printf("ERROR @ %llu ps : cannot apply a burst stop to auto-precharged bank %d !\n", ts, ba);
-                            break;
-                        }
-                            
-                        // Terminate a WRITE immediately
-                        bst_ctr_wr = (vluint16_t)0;
+                        if ((stats_on) && (row_act[i])) stats_row(i, false);
+                        row_act[i] = 0;
+                        row_pre[i] = 1;
+                    }
+                }
+                else
+                {
+                    if (dbg_on)
+                        log_size += sprintf(log_buf + log_size, "%15llu ps : Precharge bank #%d\n", ts, ba);
                         
-                        // CAS latency for READ
-                        if (cas_lat)
-                        {
-                            cmd_pipe.u8[cas_lat] = CMD_BST;
-                        }
+                    if (ap_bank[ba])
+                    {
+                        printf("ERROR @ %llu ps : cannot apply a precharge to auto-precharged bank %d !\n", ts, ba);
                         break;
                     }
-                    // 3'b111 : No operation
-                    default: ;
+                    
+                    // Precharge one bank
+                    if ((stats_on) && (row_act[ba])) stats_row(ba, false);
+                    row_act[ba] = 0;
+                    row_pre[ba] = 1;
+                }
+                
+                // Terminate a WRITE immediately
+                if ((a10) || (bank == (int)ba))
+                    bst_ctr_wr = 0;
+                
+                // CAS latency pipeline for READ
+                if (cas_lat)
+                {
+                    cmd_pipe.u8[cas_lat] = CMD_PRE;
+                    bap_pipe.u8[cas_lat] = ba;
+                    a10_pipe.u16[cas_lat] = a10;
+                }
+                
+                break;
+            }
+            // 3'b011 : Activate
+            case CMD_ACT:
+            {
+                if (dbg_on)
+                    log_size += sprintf(log_buf + log_size, "%15llu ps : Activate bank #%d, row #%d\n", ts, ba, addr);
+                        
+                if (row_act[ba])
+                {
+                    printf("ERROR @ %llu ps : bank %d already active !\n", ts, ba);
+                    break;
+                }
+                   
+                if (stats_on) stats_row(ba, true);
+                row_act[ba]  = 1;
+                row_pre[ba]  = 0;
+                row_addr[ba] = ((int)addr & (num_rows - 1)) << bit_cols;
+                
+                break;
+            }
+            // 3'b100 : Write
+            case CMD_WR:
+            {
+                if (dbg_on)
+                    log_size += sprintf(log_buf + log_size,
+                                        "%15llu ps : Write%s bank #%d, col #%d\n",
+                                        ts, (a10) ? "(AP)" : "", ba, (int)(addr & mask_cols));
+                
+                if (!row_act[ba])
+                {
+                    printf("ERROR @ %llu ps : bank %d is not activated for WRITE !\n", ts, ba);
+                    break;
+                }
+                   
+                // Latch command right away
+                cmd_pipe.u8[0]  = CMD_WR;
+                col_pipe.u16[0] = addr & mask_cols;
+                ba_pipe.u8[0]   = ba;
+        
+                // Auto-precharge
+                ap_bank[ba] = a10;
+                
+                break;
+            }
+            // 3'b101 : Read
+            case CMD_RD:
+            {
+                if (dbg_on)
+                    log_size += sprintf(log_buf + log_size,
+                                        "%15llu ps : Read%s bank #%d, col #%d\n",
+                                        ts, (a10) ? "(AP)" : "", ba, (int)(addr & mask_cols));
+                
+                if (!row_act[ba])
+                {
+                    printf("ERROR @ %llu ps : bank %d is not activated for READ !\n", ts, ba);
+                    break;
+                }
+                   
+                // CAS latency pipeline
+                if (cas_lat)
+                {
+                    cmd_pipe.u8[cas_lat]  = CMD_RD;
+                    col_pipe.u16[cas_lat] = addr & mask_cols;
+                    ba_pipe.u8[cas_lat]   = ba;
+                }
+                
+                // Auto-precharge
+                ap_bank[ba] = a10;
+                
+                break;
+            }
+            // 3'b110 : Burst stop
+            case CMD_BST:
+            {
+                if (dbg_on)
+                    log_size += sprintf(log_buf + log_size, "%15llu ps : Burst Stop bank #%d\n", ts, ba);
+                    
+                if (ap_bank[ba])
+                {
+                    printf("ERROR @ %llu ps : cannot apply a burst stop to auto-precharged bank %d !\n", ts, ba);
+                    break;
+                }
+                    
+                // Terminate a WRITE immediately
+                bst_ctr_wr = (vluint16_t)0;
+                
+                // CAS latency for READ
+                if (cas_lat)
+                {
+                    cmd_pipe.u8[cas_lat] = CMD_BST;
                 }
+                break;
+            }
+            // 3'b111 : No operation
+            default: ;
+        }
+    }
+    
+    // Process SDRAM command (pipelined)
+    switch (cmd_pipe.u8[0])
+    {
+        // 3'b010 : Precharge
+        case CMD_PRE:
+        {
+            if ((a10_pipe.u16[0]) || (bap_pipe.u8[0] == (vluint8_t)bank))
+                bst_ctr_rd = (int)0;
+            break;
+        }
+        // 3'b100 : Write
+        case CMD_WR:
+        {
+            // Bank, row and column addresses in memory array
+            bank       = (int)ba_pipe.u8[0];
+            row        = row_addr[bank] + ((int)col_pipe.u16[0] & ~bst_msk_wr);
+            col        = (int)col_pipe.u16[0] & bst_msk_wr;
+            bst_ctr_rd = 0;
+            bst_ctr_wr = bst_len_wr;
+            
+            if (dbg_on)
+            {
+                fprintf(fh_log, "   Wr @ 0x%08llX :", (unsigned long long)burst_addr(bank, (int)col_pipe.u16[0]));
+            }
+            if (blog_on)
+            {
+                blog_put(ts, SDRAM_LOG_WR_BURST, bank, burst_addr(bank, (int)col_pipe.u16[0]), 0, 0, 0);
+            }
+            
+            break;
+        }
+        // 3'b101 : Read
+        case CMD_RD:
+        {
+            // Bank, row and column addresses in memory array
+            bank       = (int)ba_pipe.u8[0];
+            row        = row_addr[bank] + ((int)col_pipe.u16[0] & ~bst_msk_rd);
+            col        = (int)col_pipe.u16[0] & bst_msk_rd;
+            bst_ctr_rd = bst_len_rd;
+            bst_ctr_wr = 0;
+            
+            if (dbg_on)
+            {
+                fprintf(fh_log, "   Rd @ 0x%08llX :", (unsigned long long)burst_addr(bank, (int)col_pipe.u16[0]));
+            }
+            if (blog_on)
+            {
+                blog_put(ts, SDRAM_LOG_RD_BURST, bank, burst_addr(bank, (int)col_pipe.u16[0]), 0, 0, 0);
             }
             
-            // Process SDRAM command (pipelined)
-            switch (cmd_pipe.u8[0])
+            break;
+        }
+        // 3'b110 : Burst stop
+        case CMD_BST:
+        {
+            bst_ctr_rd = (int)0;
+            break;
+        }
+        // 3'b111 : No operation
+        default: ;
+    }
+    
+    // Write to memory
+    if (bst_ctr_wr)
+    {
+        switch (bus_log2)
+        {
+            // 8-bit bus
+            case 0:
             {
-                // 3'b010 : Precharge
-                case CMD_PRE:
+                // Non masked write
+                if (!dqm)
                 {
-                    if ((a10_pipe.u16[0]) || (bap_pipe.u8[0] == (vluint8_t)bank))
-                        bst_ctr_rd = (int)0;
-                    break;
+                    array_u8[bank][row + col] = (vluint8_t)dq_in;
                 }
-                // 3'b100 : Write
-                case CMD_WR:
+                break;
+            }
+            // 16-bit bus
+            case 1:
+            {
+                // Non masked write
+                if (!dqm)
                 {
-                    // Bank, row and column addresses in memory array
-                    bank       = (int)ba_pipe.u8[0];
-                    row        = row_addr[bank] + ((int)col_pipe.u16[0] & ~bst_msk_wr);
-                    col        = (int)col_pipe.u16[0] & bst_msk_wr;
-                    bst_ctr_rd = 0;
-                    bst_ctr_wr = bst_len_wr;
-                    
-                    if (dbg_on)
-                    {
-                        if (mem_flags & FLAG_BANK_INTERLEAVING)
-                            fprintf(fh_log, "   Wr @ 0x%08X :", ((row_addr[bank] << SDRAM_BIT_BANKS) + (bank << bit_cols) + (int)col_pipe.u16[0]) << bus_log2);
-                        else
-                            fprintf(fh_log, "   Wr @ 0x%08X :", (row_addr[bank] + (bank << (bit_rows + bit_cols)) + (int)col_pipe.u16[0]) << bus_log2);
-                    }
-                    
-                    break;
+                    array_u16[bank][row + col] = (vluint16_t)dq_in;
                 }
-                // 3'b101 : Read
-                case CMD_RD:
+                // Masked write
+                else
                 {
-                    // Bank, row and column addresses in memory array
-                    bank       = (int)ba_pipe.u8[0];
-                    row        = row_addr[bank] + ((int)col_pipe.u16[0] & ~bst_msk_rd);
-                    col        = (int)col_pipe.u16[0] & bst_msk_rd;
-                    bst_ctr_rd = bst_len_rd;
-                    bst_ctr_wr = 0;
+                    vluint16_t dqm_mask = (vluint16_t)c_dqm_mask[dqm];
                     
-                    if (dbg_on)
-                    {
-                        if (mem_flags & FLAG_BANK_INTERLEAVING)
-                            fprintf(fh_log, "   Rd @ 0x%08X :", ((row_addr[bank] << SDRAM_BIT_BANKS) + (bank << bit_cols) + (int)col_pipe.u16[0]) << bus_log2);
-                        else
-                            fprintf(fh_log, "   Rd @ 0x%08X :", (row_addr[bank] + (bank << (bit_rows + bit_cols)) + (int)col_pipe.u16[0]) << bus_log2);
-                    }
-                    
-                    break;
-                }
-                // 3'b110 : Burst stop
-                case CMD_BST:
-                {
-                    bst_ctr_rd = (int)0;
-                    break;
+                    array_u16[bank][row + col] = (vluint16_t)dq_in & dqm_mask
+                                               | array_u16[bank][row + col] & ~dqm_mask;
                 }
-                // 3'b111 : No operation
-                default: ;
+                break;
             }
-            
-            // Write to memory
-            if (bst_ctr_wr)
+            // 32-bit bus
+            case 2:
             {
-                switch (bus_log2)
+                // Non masked write
+                if (!dqm)
                 {
-                    // 8-bit bus
-                    case 0:
-                    {
-                        // Non masked write
-                        if (!dqm)
-                        {
-                            array_u8[bank][row + col] = (vluint8_t)dq_in;
-                        }
-                        break;
-                    }
-                    // 16-bit bus
-                    case 1:
-                    {
-                        // Non masked write
-                        if (!dqm)
-                        {
-                            array_u16[bank][row + col] = (vluint16_t)dq_in;
-                        }
-                        // Masked write
-                        else
-                        {
-                            vluint16_t dqm_mask = (vluint16_t)c_dqm_mask[dqm];
-                            
-                            array_u16[bank][row + col] = (vluint16_t)dq_in & dqm_mask
-                                                       | array_u16[bank][row + col] & ~dqm_mask;
-                        }
-                        break;
-                    }
-                    // 32-bit bus
-                    case 2:
-                    {
-                        // Non masked write
-                        if (!dqm)
-                        {
-                            array_u32[bank][row + col] = (vluint32_t)dq_in;
-                        }
-                        // Masked write
-                        else
-                        {
-                            vluint32_t dqm_mask = (vluint32_t)c_dqm_mask[dqm];
-                            
-                            array_u32[bank][row + col] = (vluint32_t)dq_in & dqm_mask
-                                                       | array_u32[bank][row + col] & ~dqm_mask;
-                        }
-                        break;
-                    }
-                    // 64-bit bus
-                    case 3:
-                    {
-                        // Non masked write
-                        if (!dqm)
-                        {
-                            array_u64[bank][row + col] = dq_in;
-                        }
-                        // Masked write
-                        else
-                        {
-                            vluint64_t dqm_mask = c_dqm_mask[dqm];
-                            
-                            array_u64[bank][row + col] = (dq_in & dqm_mask)
-                                                       | array_u64[bank][row + col] & ~dqm_mask;
-                        }
-                        break;
-                    }
+                    array_u32[bank][row + col] = (vluint32_t)dq_in;
                 }
-                
-                if (dbg_on)
+                // Masked write
+                else
                 {
-                    dq_lane_t dq_tmp;
-                    dq_tmp.u64 = dq_in;
+                    vluint32_t dqm_mask = (vluint32_t)c_dqm_mask[dqm];
                     
-                    fputc(' ', fh_log);
-                    for (int l = bus_mask; l >= 0; l--)
-                    {
-                        if ((dqm >> l) & 1)
-                        {
-                            fputs("XX", fh_log);
-                        }
-                        else
-                        {
-                            fprintf(fh_log, "%02X", dq_tmp.u8[l]);
-                        }
-                    }
+                    array_u32[bank][row + col] = (vluint32_t)dq_in & dqm_mask
+                                               | array_u32[bank][row + col] & ~dqm_mask;
                 }
-                
-                // Burst counter
-                if (--bst_ctr_wr)
+                break;
+            }
+            // 64-bit bus
+            case 3:
+            {
+                // Non masked write
+                if (!dqm)
                 {
-                    if (bst_type)
-                    {
-                        // BL4_Int, BL8_Int
-                        col = c_col_int[col][bst_ctr_wr];
-                    }
-                    else
-                    {
-                        // BL1, BL2, BL4_Seq, BL8_Seq
-                        col++;
-                        col &= bst_msk_wr;
-                    }
+                    array_u64[bank][row + col] = dq_in;
                 }
-                // End of burst
+                // Masked write
                 else
                 {
-                    // Auto-precharge case
-                    if (ap_bank[bank])
-                    {
-                        ap_bank[bank] = (vluint16_t)0;
-                        row_act[bank] = (vluint8_t)0;
-                        row_pre[bank] = (vluint8_t)1;
-                    }
-                    if (dbg_on) fputs("\n", fh_log);
+                    vluint64_t dqm_mask = c_dqm_mask[dqm];
+                    
+                    array_u64[bank][row + col] = (dq_in & dqm_mask)
+                                               | array_u64[bank][row + col] & ~dqm_mask;
                 }
+                break;
             }
-            // Read from memory
-            else if (bst_ctr_rd)
+        }
+        
+        if (stats_on) stats_beat(1);
+        if (blog_on)
+            blog_put(ts, SDRAM_LOG_WR_BEAT, bank, (vluint64_t)(row + col), (bst_ctr_wr == 1) ? SDRAM_LOG_LAST : 0, dqm, dq_in);
+        if (watch_on)
+        {
+            vluint64_t a = burst_addr(bank, row - row_addr[bank] + col);
+            
+            if (watch_test(a)) watch_check(a, bus_mask + 1, SDRAM_WATCH_WR, dq_in);
+        }
+        
+        if (dbg_on)
+        {
+            dq_lane_t dq_tmp;
+            dq_tmp.u64 = dq_in;
+            
+            fputc(' ', fh_log);
+            for (int l = bus_mask; l >= 0; l--)
             {
-                switch (bus_log2)
+                if ((dqm >> l) & 1)
                 {
-                    // 8-bit bus
-                    case 0:
-                    {
-                        dq_out = (vluint64_t)array_u8[bank][row + col] & c_dqm_mask[dqm];
-                        break;
-                    }
-                    // 16-bit bus
-                    case 1:
-                    {
-                        dq_out = (vluint64_t)array_u16[bank][row + col] & c_dqm_mask[dqm];
-                        break;
-                    }
-                    // 32-bit bus
-                    case 2:
-                    {
-                        dq_out = (vluint64_t)array_u32[bank][row + col] & c_dqm_mask[dqm];
-                        break;
-                    }
-                    // 64-bit bus
-                    case 3:
-                    {
-                        dq_out = (vluint64_t)array_u64[bank][row + col] & c_dqm_mask[dqm];
-                        break;
-                    }
-                    default:
-                    {
-                        dq_out = (vluint64_t)0;
-                    }
+                    fputs("XX", fh_log);
                 }
-                
-                if (dbg_on)
+                else
                 {
-                    dq_lane_t dq_tmp;
-                    dq_tmp.u64 = dq_out;
-                    
-                    fputc(' ', fh_log);
-                    for (int l = bus_mask; l >= 0; l--)
-                    {
-                        if ((dqm_pipe[0] >> l) & 1)
-                        {
-                            fputs("XX", fh_log);
-                        }
-                        else
-                        {
-                            fprintf(fh_log, "%02X", dq_tmp.u8[l]);
-                        }
-                    }
+                    fprintf(fh_log, "%02X", dq_tmp.u8[l]);
                 }
-                
-                // Burst counter
-                if (--bst_ctr_rd)
+            }
+        }
+        
+        // Burst counter
+        if (--bst_ctr_wr)
+        {
+            if (bst_type)
+            {
+                // BL4_Int, BL8_Int
+                col = c_col_int[col][bst_ctr_wr];
+            }
+            else
+            {
+                // BL1, BL2, BL4_Seq, BL8_Seq
+                col++;
+                col &= bst_msk_wr;
+            }
+        }
+        // End of burst
+        else
+        {
+            // Auto-precharge case
+            if (ap_bank[bank])
+            {
+                if (stats_on)
                 {
-                    if (bst_type)
-                    {
-                        // BL4_Int, BL8_Int
-                        col = c_col_int[col][bst_ctr_rd];
-                    }
-                    else
-                    {
-                        // BL1, BL2, BL4_Seq, BL8_Seq
-                        col++;
-                        col &= bst_msk_rd;
-                    }
+                    st_bank[bank].ap++;
+                    stats_row(bank, false);
+                }
+                ap_bank[bank] = (vluint16_t)0;
+                row_act[bank] = (vluint8_t)0;
+                row_pre[bank] = (vluint8_t)1;
+            }
+            if (dbg_on) fputs("\n", fh_log);
+        }
+    }
+    // Read from memory
+    else if (bst_ctr_rd)
+    {
+        switch (bus_log2)
+        {
+            // 8-bit bus
+            case 0:
+            {
+                dq_out = (vluint64_t)array_u8[bank][row + col] & c_dqm_mask[dqm];
+                break;
+            }
+            // 16-bit bus
+            case 1:
+            {
+                dq_out = (vluint64_t)array_u16[bank][row + col] & c_dqm_mask[dqm];
+                break;
+            }
+            // 32-bit bus
+            case 2:
+            {
+                dq_out = (vluint64_t)array_u32[bank][row + col] & c_dqm_mask[dqm];
+                break;
+            }
+            // 64-bit bus
+            case 3:
+            {
+                dq_out = (vluint64_t)array_u64[bank][row + col] & c_dqm_mask[dqm];
+                break;
+            }
+            default:
+            {
+                dq_out = (vluint64_t)0;
+            }
+        }
+        
+        if (stats_on) stats_beat(0);
+        if (blog_on)
+            blog_put(ts, SDRAM_LOG_RD_BEAT, bank, (vluint64_t)(row + col), (bst_ctr_rd == 1) ? SDRAM_LOG_LAST : 0, dqm_pipe[0], dq_out);
+        if (watch_on)
+        {
+            vluint64_t a = burst_addr(bank, row - row_addr[bank] + col);
+            
+            if (watch_test(a)) watch_check(a, bus_mask + 1, SDRAM_WATCH_RD, dq_out);
+        }
+        
+        if (dbg_on)
+        {
+            dq_lane_t dq_tmp;
+            dq_tmp.u64 = dq_out;
+            
+            fputc(' ', fh_log);
+            for (int l = bus_mask; l >= 0; l--)
+            {
+                if ((dqm_pipe[0] >> l) & 1)
+                {
+                    fputs("XX", fh_log);
                 }
-                // End of burst
                 else
                 {
-                    // Auto-precharge case
-                    if (ap_bank[bank])
-                    {
-                        ap_bank[bank] = (vluint16_t)0;
-                        row_act[bank] = (vluint8_t)0;
-                        row_pre[bank] = (vluint8_t)1;
-                    }
-                    if (dbg_on) fputs("\n", fh_log);
+                    fprintf(fh_log, "%02X", dq_tmp.u8[l]);
                 }
             }
-            // Flush log buffer
-            if (log_size)
+        }
+        
+        // Burst counter
+        if (--bst_ctr_rd)
+        {
+            if (bst_type)
+            {
+                // BL4_Int, BL8_Int
+                col = c_col_int[col][bst_ctr_rd];
+            }
+            else
             {
-                fprintf(fh_log, log_buf);
-                fflush(fh_log);
-                log_size = 0;
+                // BL1, BL2, BL4_Seq, BL8_Seq
+                col++;
+                col &= bst_msk_rd;
             }
         }
-        
-        // For edge detection
-        prev_clk = clk;
+        // End of burst
+        else
+        {
+            // Auto-precharge case
+            if (ap_bank[bank])
+            {
+                if (stats_on)
+                {
+                    st_bank[bank].ap++;
+                    stats_row(bank, false);
+                }
+                ap_bank[bank] = (vluint16_t)0;
+                row_act[bank] = (vluint8_t)0;
+                row_pre[bank] = (vluint8_t)1;
+            }
+            if (dbg_on) fputs("\n", fh_log);
+        }
     }
-    // Clock disabled
-    else
+    // Flush log buffer
+    if (log_size)
     {
-        prev_clk = (vluint8_t)0;
+        fprintf(fh_log, log_buf);
+        fflush(fh_log);
+        log_size = 0;
     }
 }
 
 // Read a byte, interleaved banks
-vluint8_t SDRAM::read_u8_i(vluint32_t addr)
+vluint8_t SDRAM::read_u8_i(vluint64_t addr)
 {
-    vluint32_t bank_nr;  // Bank number (0 to 3)
-    vluint32_t idx;      // Array index (0 to num_cols * num_rows - 1)
+    vluint64_t bank_nr;  // Bank number (0 to 3)
+    vluint64_t idx;      // Array index (0 to num_cols * num_rows - 1)
     
     // |      rows      |  banks  |    columns     |
     // |<-- bit_rows -->|<-- 2 -->|<-- bit_cols -->|
@@ -1303,10 +3289,10 @@ vluint8_t SDRAM::read_u8_i(vluint32_t addr)
 }
 
 // Read a word, interleaved banks, big-endian
-vluint16_t SDRAM::read_u16_i_be(vluint32_t addr)
+vluint16_t SDRAM::read_u16_i_be(vluint64_t addr)
 {
-    vluint32_t bank_nr;  // Bank number (0 to 3)
-    vluint32_t idx;      // Array index (0 to num_cols * num_rows - 1)
+    vluint64_t bank_nr;  // Bank number (0 to 3)
+    vluint64_t idx;      // Array index (0 to num_cols * num_rows - 1)
     
     // |      rows      |  banks  |    columns     |  data   |
     // |<-- bit_rows -->|<-- 2 -->|<-- bit_cols -->|<-- 1 -->|
@@ -1322,10 +3308,10 @@ vluint16_t SDRAM::read_u16_i_be(vluint32_t addr)
 }
 
 // Read a word, interleaved banks, little-endian
-vluint16_t SDRAM::read_u16_i_le(vluint32_t addr)
+vluint16_t SDRAM::read_u16_i_le(vluint64_t addr)
 {
-    vluint32_t bank_nr;  // Bank number (0 to 3)
-    vluint32_t idx;      // Array index (0 to num_cols * num_rows - 1)
+    vluint64_t bank_nr;  // Bank number (0 to 3)
+    vluint64_t idx;      // Array index (0 to num_cols * num_rows - 1)
     
     // |      rows      |  banks  |    columns     |  data   |
     // |<-- bit_rows -->|<-- 2 -->|<-- bit_cols -->|<-- 1 -->|
@@ -1341,10 +3327,10 @@ vluint16_t SDRAM::read_u16_i_le(vluint32_t addr)
 }
 
 // Read a long, interleaved banks, big-endian
-vluint32_t SDRAM::read_u32_i_be(vluint32_t addr)
+vluint32_t SDRAM::read_u32_i_be(vluint64_t addr)
 {
-    vluint32_t bank_nr;  // Bank number (0 to 3)
-    vluint32_t idx;      // Array index (0 to num_cols * num_rows - 1)
+    vluint64_t bank_nr;  // Bank number (0 to 3)
+    vluint64_t idx;      // Array index (0 to num_cols * num_rows - 1)
     
     // |      rows      |  banks  |    columns     |  data   |
     // |<-- bit_rows -->|<-- 2 -->|<-- bit_cols -->|<-- 2 -->|
@@ -1360,10 +3346,10 @@ vluint32_t SDRAM::read_u32_i_be(vluint32_t addr)
 }
 
 // Read a long, interleaved banks, little-endian
-vluint32_t SDRAM::read_u32_i_le(vluint32_t addr)
+vluint32_t SDRAM::read_u32_i_le(vluint64_t addr)
 {
-    vluint32_t bank_nr;  // Bank number (0 to 3)
-    vluint32_t idx;      // Array index (0 to num_cols * num_rows - 1)
+    vluint64_t bank_nr;  // Bank number (0 to 3)
+    vluint64_t idx;      // Array index (0 to num_cols * num_rows - 1)
     
     // |      rows      |  banks  |    columns     |  data   |
     // |<-- bit_rows -->|<-- 2 -->|<-- bit_cols -->|<-- 2 -->|
@@ -1379,10 +3365,10 @@ vluint32_t SDRAM::read_u32_i_le(vluint32_t addr)
 }
 
 // Read a quad, interleaved banks, big-endian
-vluint64_t SDRAM::read_u64_i_be(vluint32_t addr)
+vluint64_t SDRAM::read_u64_i_be(vluint64_t addr)
 {
-    vluint32_t bank_nr;  // Bank number (0 to 3)
-    vluint32_t idx;      // Array index (0 to num_cols * num_rows - 1)
+    vluint64_t bank_nr;  // Bank number (0 to 3)
+    vluint64_t idx;      // Array index (0 to num_cols * num_rows - 1)
     
     // |      rows      |  banks  |    columns     |  data   |
     // |<-- bit_rows -->|<-- 2 -->|<-- bit_cols -->|<-- 3 -->|
@@ -1398,10 +3384,10 @@ vluint64_t SDRAM::read_u64_i_be(vluint32_t addr)
 }
 
 // Read a quad, interleaved banks, little-endian
-vluint64_t SDRAM::read_u64_i_le(vluint32_t addr)
+vluint64_t SDRAM::read_u64_i_le(vluint64_t addr)
 {
-    vluint32_t bank_nr;  // Bank number (0 to 3)
-    vluint32_t idx;      // Array index (0 to num_cols * num_rows - 1)
+    vluint64_t bank_nr;  // Bank number (0 to 3)
+    vluint64_t idx;      // Array index (0 to num_cols * num_rows - 1)
     
     // |      rows      |  banks  |    columns     |  data   |
     // |<-- bit_rows -->|<-- 2 -->|<-- bit_cols -->|<-- 3 -->|
@@ -1417,10 +3403,10 @@ vluint64_t SDRAM::read_u64_i_le(vluint32_t addr)
 }
 
 // Read a byte, contiguous banks
-vluint8_t SDRAM::read_u8_c(vluint32_t addr)
+vluint8_t SDRAM::read_u8_c(vluint64_t addr)
 {
-    vluint32_t bank_nr;  // Bank number (0 to 3)
-    vluint32_t idx;      // Array index (0 to num_cols * num_rows - 1)
+    vluint64_t bank_nr;  // Bank number (0 to 3)
+    vluint64_t idx;      // Array index (0 to num_cols * num_rows - 1)
     
     // |  banks  |      rows      |    columns     |
     // |<-- 2 -->|<-- bit_rows -->|<-- bit_cols -->|
@@ -1431,10 +3417,10 @@ vluint8_t SDRAM::read_u8_c(vluint32_t addr)
 }
 
 // Read a word, contiguous banks, big-endian
-vluint16_t SDRAM::read_u16_c_be(vluint32_t addr)
+vluint16_t SDRAM::read_u16_c_be(vluint64_t addr)
 {
-    vluint32_t bank_nr;  // Bank number (0 to 3)
-    vluint32_t idx;      // Array index (0 to num_cols * num_rows - 1)
+    vluint64_t bank_nr;  // Bank number (0 to 3)
+    vluint64_t idx;      // Array index (0 to num_cols * num_rows - 1)
     
     // |  banks  |      rows      |    columns     |  data   |
     // |<-- 2 -->|<-- bit_rows -->|<-- bit_cols -->|<-- 1 -->|
@@ -1450,10 +3436,10 @@ vluint16_t SDRAM::read_u16_c_be(vluint32_t addr)
 }
 
 // Read a word, contiguous banks, little-endian
-vluint16_t SDRAM::read_u16_c_le(vluint32_t addr)
+vluint16_t SDRAM::read_u16_c_le(vluint64_t addr)
 {
-    vluint32_t bank_nr;  // Bank number (0 to 3)
-    vluint32_t idx;      // Array index (0 to num_cols * num_rows - 1)
+    vluint64_t bank_nr;  // Bank number (0 to 3)
+    vluint64_t idx;      // Array index (0 to num_cols * num_rows - 1)
     
     // |  banks  |      rows      |    columns     |  data   |
     // |<-- 2 -->|<-- bit_rows -->|<-- bit_cols -->|<-- 1 -->|
@@ -1469,10 +3455,10 @@ vluint16_t SDRAM::read_u16_c_le(vluint32_t addr)
 }
 
 // Read a long, contiguous banks, big-endian
-vluint32_t SDRAM::read_u32_c_be(vluint32_t addr)
+vluint32_t SDRAM::read_u32_c_be(vluint64_t addr)
 {
-    vluint32_t bank_nr;  // Bank number (0 to 3)
-    vluint32_t idx;      // Array index (0 to num_cols * num_rows - 1)
+    vluint64_t bank_nr;  // Bank number (0 to 3)
+    vluint64_t idx;      // Array index (0 to num_cols * num_rows - 1)
     
     // |  banks  |      rows      |    columns     |  data   |
     // |<-- 2 -->|<-- bit_rows -->|<-- bit_cols -->|<-- 2 -->|
@@ -1488,10 +3474,10 @@ vluint32_t SDRAM::read_u32_c_be(vluint32_t addr)
 }
 
 // Read a long, contiguous banks, little-endian
-vluint32_t SDRAM::read_u32_c_le(vluint32_t addr)
+vluint32_t SDRAM::read_u32_c_le(vluint64_t addr)
 {
-    vluint32_t bank_nr;  // Bank number (0 to 3)
-    vluint32_t idx;      // Array index (0 to num_cols * num_rows - 1)
+    vluint64_t bank_nr;  // Bank number (0 to 3)
+    vluint64_t idx;      // Array index (0 to num_cols * num_rows - 1)
     
     // |  banks  |      rows      |    columns     |  data   |
     // |<-- 2 -->|<-- bit_rows -->|<-- bit_cols -->|<-- 2 -->|
@@ -1507,10 +3493,10 @@ vluint32_t SDRAM::read_u32_c_le(vluint32_t addr)
 }
 
 // Read a quad, contiguous banks, big-endian
-vluint64_t SDRAM::read_u64_c_be(vluint32_t addr)
+vluint64_t SDRAM::read_u64_c_be(vluint64_t addr)
 {
-    vluint32_t bank_nr;  // Bank number (0 to 3)
-    vluint32_t idx;      // Array index (0 to num_cols * num_rows - 1)
+    vluint64_t bank_nr;  // Bank number (0 to 3)
+    vluint64_t idx;      // Array index (0 to num_cols * num_rows - 1)
     
     // |  banks  |      rows      |    columns     |  data   |
     // |<-- 2 -->|<-- bit_rows -->|<-- bit_cols -->|<-- 3 -->|
@@ -1526,10 +3512,10 @@ vluint64_t SDRAM::read_u64_c_be(vluint32_t addr)
 }
 
 // Read a quad, contiguous banks, little-endian
-vluint64_t SDRAM::read_u64_c_le(vluint32_t addr)
+vluint64_t SDRAM::read_u64_c_le(vluint64_t addr)
 {
-    vluint32_t bank_nr;  // Bank number (0 to 3)
-    vluint32_t idx;      // Array index (0 to num_cols * num_rows - 1)
+    vluint64_t bank_nr;  // Bank number (0 to 3)
+    vluint64_t idx;      // Array index (0 to num_cols * num_rows - 1)
     
     // |  banks  |      rows      |    columns     |  data   |
     // |<-- 2 -->|<-- bit_rows -->|<-- bit_cols -->|<-- 3 -->|
@@ -1545,10 +3531,10 @@ vluint64_t SDRAM::read_u64_c_le(vluint32_t addr)
 }
 
 // Write a byte, interleaved banks
-void SDRAM::write_u8_i(vluint32_t addr, vluint8_t data)
+void SDRAM::write_u8_i(vluint64_t addr, vluint8_t data)
 {
-    vluint32_t bank_nr;  // Bank number (0 to 3)
-    vluint32_t idx;      // Array index (0 to num_cols * num_rows - 1)
+    vluint64_t bank_nr;  // Bank number (0 to 3)
+    vluint64_t idx;      // Array index (0 to num_cols * num_rows - 1)
     
     // |      rows      |  banks  |    columns     |
     // |<-- bit_rows -->|<-- 2 -->|<-- bit_cols -->|
@@ -1559,10 +3545,10 @@ void SDRAM::write_u8_i(vluint32_t addr, vluint8_t data)
 }
 
 // Write a word, interleaved banks, big-endian
-void SDRAM::write_u16_i_be(vluint32_t addr, vluint16_t data)
+void SDRAM::write_u16_i_be(vluint64_t addr, vluint16_t data)
 {
-    vluint32_t bank_nr;  // Bank number (0 to 3)
-    vluint32_t idx;      // Array index (0 to num_cols * num_rows - 1)
+    vluint64_t bank_nr;  // Bank number (0 to 3)
+    vluint64_t idx;      // Array index (0 to num_cols * num_rows - 1)
     
     // |      rows      |  banks  |    columns     |  data   |
     // |<-- bit_rows -->|<-- 2 -->|<-- bit_cols -->|<-- 1 -->|
@@ -1578,10 +3564,10 @@ void SDRAM::write_u16_i_be(vluint32_t addr, vluint16_t data)
 }
 
 // Write a word, interleaved banks, little-endian
-void SDRAM::write_u16_i_le(vluint32_t addr, vluint16_t data)
+void SDRAM::write_u16_i_le(vluint64_t addr, vluint16_t data)
 {
-    vluint32_t bank_nr;  // Bank number (0 to 3)
-    vluint32_t idx;      // Array index (0 to num_cols * num_rows - 1)
+    vluint64_t bank_nr;  // Bank number (0 to 3)
+    vluint64_t idx;      // Array index (0 to num_cols * num_rows - 1)
     
     // |      rows      |  banks  |    columns     |  data   |
     // |<-- bit_rows -->|<-- 2 -->|<-- bit_cols -->|<-- 1 -->|
@@ -1597,10 +3583,10 @@ void SDRAM::write_u16_i_le(vluint32_t addr, vluint16_t data)
 }
 
 // Write a long, interleaved banks, big-endian
-void SDRAM::write_u32_i_be(vluint32_t addr, vluint32_t data)
+void SDRAM::write_u32_i_be(vluint64_t addr, vluint32_t data)
 {
-    vluint32_t bank_nr;  // Bank number (0 to 3)
-    vluint32_t idx;      // Array index (0 to num_cols * num_rows - 1)
+    vluint64_t bank_nr;  // Bank number (0 to 3)
+    vluint64_t idx;      // Array index (0 to num_cols * num_rows - 1)
     
     // |      rows      |  banks  |    columns     |  data   |
     // |<-- bit_rows -->|<-- 2 -->|<-- bit_cols -->|<-- 2 -->|
@@ -1616,10 +3602,10 @@ void SDRAM::write_u32_i_be(vluint32_t addr, vluint32_t data)
 }
 
 // Write a long, interleaved banks, little-endian
-void SDRAM::write_u32_i_le(vluint32_t addr, vluint32_t data)
+void SDRAM::write_u32_i_le(vluint64_t addr, vluint32_t data)
 {
-    vluint32_t bank_nr;  // Bank number (0 to 3)
-    vluint32_t idx;      // Array index (0 to num_cols * num_rows - 1)
+    vluint64_t bank_nr;  // Bank number (0 to 3)
+    vluint64_t idx;      // Array index (0 to num_cols * num_rows - 1)
     
     // |      rows      |  banks  |    columns     |  data   |
     // |<-- bit_rows -->|<-- 2 -->|<-- bit_cols -->|<-- 2 -->|
@@ -1635,10 +3621,10 @@ void SDRAM::write_u32_i_le(vluint32_t addr, vluint32_t data)
 }
 
 // Write a quad, interleaved banks, big-endian
-void SDRAM::write_u64_i_be(vluint32_t addr, vluint64_t data)
+void SDRAM::write_u64_i_be(vluint64_t addr, vluint64_t data)
 {
-    vluint32_t bank_nr;  // Bank number (0 to 3)
-    vluint32_t idx;      // Array index (0 to num_cols * num_rows - 1)
+    vluint64_t bank_nr;  // Bank number (0 to 3)
+    vluint64_t idx;      // Array index (0 to num_cols * num_rows - 1)
     
     // |      rows      |  banks  |    columns     |  data   |
     // |<-- bit_rows -->|<-- 2 -->|<-- bit_cols -->|<-- 3 -->|
@@ -1654,10 +3640,10 @@ void SDRAM::write_u64_i_be(vluint32_t addr, vluint64_t data)
 }
 
 // Write a quad, interleaved banks, little-endian
-void SDRAM::write_u64_i_le(vluint32_t addr, vluint64_t data)
+void SDRAM::write_u64_i_le(vluint64_t addr, vluint64_t data)
 {
-    vluint32_t bank_nr;  // Bank number (0 to 3)
-    vluint32_t idx;      // Array index (0 to num_cols * num_rows - 1)
+    vluint64_t bank_nr;  // Bank number (0 to 3)
+    vluint64_t idx;      // Array index (0 to num_cols * num_rows - 1)
     
     // |      rows      |  banks  |    columns     |  data   |
     // |<-- bit_rows -->|<-- 2 -->|<-- bit_cols -->|<-- 3 -->|
@@ -1673,10 +3659,10 @@ void SDRAM::write_u64_i_le(vluint32_t addr, vluint64_t data)
 }
 
 // Write a byte, contiguous banks
-void SDRAM::write_u8_c(vluint32_t addr, vluint8_t data)
+void SDRAM::write_u8_c(vluint64_t addr, vluint8_t data)
 {
-    vluint32_t bank_nr;  // Bank number (0 to 3)
-    vluint32_t idx;      // Array index (0 to num_cols * num_rows - 1)
+    vluint64_t bank_nr;  // Bank number (0 to 3)
+    vluint64_t idx;      // Array index (0 to num_cols * num_rows - 1)
     
     // |  banks  |      rows      |    columns     |
     // |<-- 2 -->|<-- bit_rows -->|<-- bit_cols -->|
@@ -1687,10 +3673,10 @@ void SDRAM::write_u8_c(vluint32_t addr, vluint8_t data)
 }
 
 // Write a word, contiguous banks, big-endian
-void SDRAM::write_u16_c_be(vluint32_t addr, vluint16_t data)
+void SDRAM::write_u16_c_be(vluint64_t addr, vluint16_t data)
 {
-    vluint32_t bank_nr;  // Bank number (0 to 3)
-    vluint32_t idx;      // Array index (0 to num_cols * num_rows - 1)
+    vluint64_t bank_nr;  // Bank number (0 to 3)
+    vluint64_t idx;      // Array index (0 to num_cols * num_rows - 1)
     
     // |  banks  |      rows      |    columns     |  data   |
     // |<-- 2 -->|<-- bit_rows -->|<-- bit_cols -->|<-- 1 -->|
@@ -1706,10 +3692,10 @@ void SDRAM::write_u16_c_be(vluint32_t addr, vluint16_t data)
 }
 
 // Write a word, contiguous banks, little-endian
-void SDRAM::write_u16_c_le(vluint32_t addr, vluint16_t data)
+void SDRAM::write_u16_c_le(vluint64_t addr, vluint16_t data)
 {
-    vluint32_t bank_nr;  // Bank number (0 to 3)
-    vluint32_t idx;      // Array index (0 to num_cols * num_rows - 1)
+    vluint64_t bank_nr;  // Bank number (0 to 3)
+    vluint64_t idx;      // Array index (0 to num_cols * num_rows - 1)
     
     // |  banks  |      rows      |    columns     |  data   |
     // |<-- 2 -->|<-- bit_rows -->|<-- bit_cols -->|<-- 1 -->|
@@ -1725,10 +3711,10 @@ void SDRAM::write_u16_c_le(vluint32_t addr, vluint16_t data)
 }
 
 // Write a long, contiguous banks, big-endian
-void SDRAM::write_u32_c_be(vluint32_t addr, vluint32_t data)
+void SDRAM::write_u32_c_be(vluint64_t addr, vluint32_t data)
 {
-    vluint32_t bank_nr;  // Bank number (0 to 3)
-    vluint32_t idx;      // Array index (0 to num_cols * num_rows - 1)
+    vluint64_t bank_nr;  // Bank number (0 to 3)
+    vluint64_t idx;      // Array index (0 to num_cols * num_rows - 1)
     
     // |  banks  |      rows      |    columns     |  data   |
     // |<-- 2 -->|<-- bit_rows -->|<-- bit_cols -->|<-- 2 -->|
@@ -1744,10 +3730,10 @@ void SDRAM::write_u32_c_be(vluint32_t addr, vluint32_t data)
 }
 
 // Write a long, contiguous banks, little-endian
-void SDRAM::write_u32_c_le(vluint32_t addr, vluint32_t data)
+void SDRAM::write_u32_c_le(vluint64_t addr, vluint32_t data)
 {
-    vluint32_t bank_nr;  // Bank number (0 to 3)
-    vluint32_t idx;      // Array index (0 to num_cols * num_rows - 1)
+    vluint64_t bank_nr;  // Bank number (0 to 3)
+    vluint64_t idx;      // Array index (0 to num_cols * num_rows - 1)
     
     // |  banks  |      rows      |    columns     |  data   |
     // |<-- 2 -->|<-- bit_rows -->|<-- bit_cols -->|<-- 2 -->|
@@ -1763,10 +3749,10 @@ void SDRAM::write_u32_c_le(vluint32_t addr, vluint32_t data)
 }
 
 // Write a quad, contiguous banks, big-endian
-void SDRAM::write_u64_c_be(vluint32_t addr, vluint64_t data)
+void SDRAM::write_u64_c_be(vluint64_t addr, vluint64_t data)
 {
-    vluint32_t bank_nr;  // Bank number (0 to 3)
-    vluint32_t idx;      // Array index (0 to num_cols * num_rows - 1)
+    vluint64_t bank_nr;  // Bank number (0 to 3)
+    vluint64_t idx;      // Array index (0 to num_cols * num_rows - 1)
     
     // |  banks  |      rows      |    columns     |  data   |
     // |<-- 2 -->|<-- bit_rows -->|<-- bit_cols -->|<-- 3 -->|
@@ -1782,10 +3768,10 @@ void SDRAM::write_u64_c_be(vluint32_t addr, vluint64_t data)
 }
 
 // Write a quad, contiguous banks, little-endian
-void SDRAM::write_u64_c_le(vluint32_t addr, vluint64_t data)
+void SDRAM::write_u64_c_le(vluint64_t addr, vluint64_t data)
 {
-    vluint32_t bank_nr;  // Bank number (0 to 3)
-    vluint32_t idx;      // Array index (0 to num_cols * num_rows - 1)
+    vluint64_t bank_nr;  // Bank number (0 to 3)
+    vluint64_t idx;      // Array index (0 to num_cols * num_rows - 1)
     
     // |  banks  |      rows      |    columns     |  data   |
     // |<-- 2 -->|<-- bit_rows -->|<-- bit_cols -->|<-- 3 -->|
@@ -1799,3 +3785,128 @@ void SDRAM::write_u64_c_le(vluint32_t addr, vluint64_t data)
     array_u64[bank_nr][idx] = data;
 #endif
 }
+
+// Multi-chip array constructor
+SDRAMArray::SDRAMArray(int ranks, int chips, vluint8_t log2_rows, vluint8_t log2_cols,
+                       vluint8_t flags, const char *logfile, vluint64_t seed)
+{
+    int  chip_bytes = (flags & (DATA_MSB | DATA_MSW | DATA_MSL)) + 1;
+    int  bus_bytes  = chip_bytes * chips;
+    char name[1024];
+
+    if ((ranks < 1) || (ranks > SDRAM_MAX_RANKS) || (ranks & (ranks - 1)))
+    {
+        printf("SDRAM array : 1, 2, 4 or 8 ranks only !!\n");
+        exit(1);
+    }
+    if ((chips < 1) || (chips & (chips - 1)) || (bus_bytes > 8))
+    {
+        printf("SDRAM array : %d x %d-bit chips do not make an 8/16/32/64-bit bus !!\n",
+               chips, chip_bytes * 8);
+        exit(1);
+    }
+    printf("Instantiating SDRAM array : %d rank(s) x %d chip(s) x %d bits\n",
+           ranks, chips, chip_bytes * 8);
+
+    // The chips of a rank are one model with the combined data bus
+    flags = (flags & ~(DATA_MSB | DATA_MSW | DATA_MSL)) | (vluint8_t)(bus_bytes - 1);
+    num_ranks = ranks;
+    for (int r = 0; r < num_ranks; r++)
+    {
+        if ((logfile) && (num_ranks > 1))
+        {
+            snprintf(name, sizeof(name), "%s.cs%d", logfile, r);
+        }
+        rank_mem[r] = new SDRAM(log2_rows, log2_cols, flags,
+                                (logfile && (num_ranks > 1)) ? name : logfile,
+                                (seed) ? seed + (vluint64_t)r : seed);
+    }
+    rank_log2 = __builtin_ctzll(rank_mem[0]->mem_size);
+    rank_mask = rank_mem[0]->mem_size - 1;
+    mem_size  = rank_mem[0]->mem_size * (vluint64_t)num_ranks;
+    prev_clk  = 0;
+    prev_cke  = 1;
+}
+
+// Multi-chip array destructor
+SDRAMArray::~SDRAMArray()
+{
+    for (int r = 0; r < num_ranks; r++)
+    {
+        delete rank_mem[r];
+    }
+}
+
+// No command nor burst in progress on any rank
+bool SDRAMArray::is_idle(void)
+{
+    for (int r = 0; r < num_ranks; r++)
+    {
+        if (!rank_mem[r]->is_idle()) return false;
+    }
+    return true;
+}
+
+// Read a byte
+vluint8_t SDRAMArray::read_byte(vluint64_t addr)
+{
+    SDRAM *mem = rank_of(addr);
+
+    return mem->read_byte(addr);
+}
+
+// Read a word
+vluint16_t SDRAMArray::read_word(vluint64_t addr)
+{
+    SDRAM *mem = rank_of(addr);
+
+    return mem->read_word(addr);
+}
+
+// Read a long
+vluint32_t SDRAMArray::read_long(vluint64_t addr)
+{
+    SDRAM *mem = rank_of(addr);
+
+    return mem->read_long(addr);
+}
+
+// Read a quad
+vluint64_t SDRAMArray::read_quad(vluint64_t addr)
+{
+    SDRAM *mem = rank_of(addr);
+
+    return mem->read_quad(addr);
+}
+
+// Write a byte
+void SDRAMArray::write_byte(vluint64_t addr, vluint8_t data)
+{
+    SDRAM *mem = rank_of(addr);
+
+    mem->write_byte(addr, data);
+}
+
+// Write a word
+void SDRAMArray::write_word(vluint64_t addr, vluint16_t data)
+{
+    SDRAM *mem = rank_of(addr);
+
+    mem->write_word(addr, data);
+}
+
+// Write a long
+void SDRAMArray::write_long(vluint64_t addr, vluint32_t data)
+{
+    SDRAM *mem = rank_of(addr);
+
+    mem->write_long(addr, data);
+}
+
+// Write a quad
+void SDRAMArray::write_quad(vluint64_t addr, vluint64_t data)
+{
+    SDRAM *mem = rank_of(addr);
+
+    mem->write_quad(addr, data);
+}
@@ -27,12 +27,35 @@
 //  - Debug mode to trace every SDRAM access
 //  - Endianness support for 16, 32 and 64-bit memories
 //  - Direct read/write memory access to use with DPI shortcut in controller
+//  - Sparse mode : pages are allocated and initialized on first access
+//    (image save and block read/compare do not allocate the pages never accessed)
+//  - Reproducible random fill (seeded, computed per address, multi-threaded)
+//  - Memory mapped image load/save (one copy per bank when possible)
+//  - Compile-time specialized front end (SDRAMT) for inlined direct accesses
+//  - Block transfers (read/write/fill/compare) with DPI-C wrappers
+//  - Idle cycles and falling edges evaluated inline (no call)
+//  - Binary command/data log written by a background thread
+//  - Performance counters (per bank, row histogram, bandwidth) in CSV/JSON
+//  - Transaction level bursts (no pin-level protocol) on the same arrays
+//  - Copy-on-write snapshot/restore with dirty pages tracking
+//  - 64-bit addresses, huge pages backed arrays
+//  - Multi-chip ranks and chip selects (SDRAMArray) with one command decode
+//  - Address watchpoints on bursts and direct accesses (callback or log)
+//  - Parallel memory digest (per page hashes) and diff against an image file
+//  - IDD based energy estimation (per bank, per window, power-down residency)
 //
 
 #ifndef _SDR_SDRAM_H_
 #define _SDR_SDRAM_H_
 
 #include "verilated.h"
+#include "sdram_log.h"
+#include <signal.h>
+#include <string.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
 
 #ifdef _SDRAM_8_BANKS_
 /* For simulation only !! */
@@ -52,37 +75,153 @@
 #define FLAG_BANK_INTERLEAVING ((vluint8_t)0x08)
 #define FLAG_BIG_ENDIAN        ((vluint8_t)0x10)
 #define FLAG_RANDOM_FILLED     ((vluint8_t)0x20)
+#define FLAG_SPARSE_MEMORY     ((vluint8_t)0x40)
+#define FLAG_HUGE_PAGES        ((vluint8_t)0x80)
+
+// Huge page size (log2), for FLAG_HUGE_PAGES (hugetlbfs default size)
+#define SDRAM_HUGE_PAGE_LOG2   (21)
+
+// Maximum number of SDRAM instances in sparse mode or with a snapshot
+#define SDRAM_MAX_SPARSE       (16)
+
+// Maximum number of ranks (chip selects) in an SDRAM array
+#define SDRAM_MAX_RANKS        (8)
+
+// Memory digest : page size (log2, bytes)
+#define SDRAM_HASH_LOG2        (12)
+
+// Watchpoints : access types
+#define SDRAM_WATCH_RD         (1)
+#define SDRAM_WATCH_WR         (2)
+#define SDRAM_WATCH_RW         (3)
+// Watchpoints : bitmap granularity (log2, bytes)
+#define SDRAM_WATCH_LOG2       (12)
+// Watchpoints : hits printed without a callback
+#define SDRAM_WATCH_MAX_LOG    (256)
+
+// Watchpoint hit call-back (ts : last clock edge for the direct accesses)
+typedef void (*sdram_watch_cb_t)(void *user, int id, vluint64_t ts, vluint64_t addr,
+                                 int size, int mode, vluint64_t data);
+
+// Energy estimation : datasheet parameters (one device)
+typedef struct
+{
+    double     vdd;                              // Supply voltage (V)
+    double     t_ck;                             // Clock period (ns)
+    double     t_rc;                             // Activate to activate, same bank (ns)
+    double     t_ras;                            // Activate to precharge (ns)
+    double     t_rfc;                            // Auto refresh period (ns)
+    double     idd0;                             // Activate - precharge, one bank (mA)
+    double     idd2n;                            // Precharge standby (mA)
+    double     idd2p;                            // Precharge power-down (mA)
+    double     idd3n;                            // Active standby (mA)
+    double     idd3p;                            // Active power-down (mA)
+    double     idd4r;                            // Burst read (mA)
+    double     idd4w;                            // Burst write (mA)
+    double     idd5;                             // Auto refresh (mA)
+    double     idd6;                             // Self refresh (mA)
+    int        chips;                            // Devices sharing the command bus
+} sdram_power_t;
+
+// Binary log buffer size (records, two buffers)
+#define SDRAM_LOG_BUF_LEN      (16384)
 
 class SDRAM
 {
     public:
         // Constructor and destructor
-        SDRAM(vluint8_t log2_rows, vluint8_t log2_cols, vluint8_t flags, const char *logfile);
+        // (seed = 0 : random fill seed taken from the current time)
+        SDRAM(vluint8_t log2_rows, vluint8_t log2_cols, vluint8_t flags, const char *logfile,
+              vluint64_t seed = 0);
         ~SDRAM();
         // Methods :
         // ---------
         // Binary image load
-        void load(const char *name, vluint32_t size,  vluint32_t addr);
+        void load(const char *name, vluint64_t size,  vluint64_t addr);
         // Binary image save
-        void save(const char *name, vluint32_t size,  vluint32_t addr);
-        // Cycle evaluate
-        void eval(vluint64_t ts,    vluint8_t clk,    vluint8_t  cke,
-                  vluint8_t  cs_n,  vluint8_t ras_n,  vluint8_t  cas_n, vluint8_t we_n,
-                  vluint8_t  ba,    vluint16_t addr,
-                  vluint8_t  dqm,   vluint64_t dq_in, vluint64_t &dq_out);
+        void save(const char *name, vluint64_t size,  vluint64_t addr);
+        // Cycle evaluate (inlined : clock edges and idle cycles are filtered here)
+        inline void eval(vluint64_t ts,    vluint8_t clk,    vluint8_t  cke,
+                         vluint8_t  cs_n,  vluint8_t ras_n,  vluint8_t  cas_n, vluint8_t we_n,
+                         vluint8_t  ba,    vluint16_t addr,
+                         vluint8_t  dqm,   vluint64_t dq_in, vluint64_t &dq_out)
+        {
+            // Power-down and self refresh residency
+            if (cke ^ prev_cke) stats_cke(ts, cke, cs_n, ras_n, cas_n, we_n);
+            // Clock enabled, rising edge on clock
+            if (cke & clk & (prev_clk ^ 1))
+            {
+                eval_rise(ts, cs_n, ras_n, cas_n, we_n, ba, addr, dqm, dq_in, dq_out);
+            }
+            // For edge detection (clock disabled : cleared)
+            prev_clk = clk & cke;
+        }
         // Direct memory read access
-        vluint8_t  read_byte(vluint32_t addr);
-        vluint16_t read_word(vluint32_t addr);
-        vluint32_t read_long(vluint32_t addr);
-        vluint64_t read_quad(vluint32_t addr);
+        vluint8_t  read_byte(vluint64_t addr);
+        vluint16_t read_word(vluint64_t addr);
+        vluint32_t read_long(vluint64_t addr);
+        vluint64_t read_quad(vluint64_t addr);
         // Direct memory write access
-        void write_byte(vluint32_t addr, vluint8_t  data);
-        void write_word(vluint32_t addr, vluint16_t data);
-        void write_long(vluint32_t addr, vluint32_t data);
-        void write_quad(vluint32_t addr, vluint64_t data);
+        void write_byte(vluint64_t addr, vluint8_t  data);
+        void write_word(vluint64_t addr, vluint16_t data);
+        void write_long(vluint64_t addr, vluint32_t data);
+        void write_quad(vluint64_t addr, vluint64_t data);
+        // Block transfers (bytes in image order, like load/save)
+        void read_block(vluint64_t addr, vluint8_t *buf, vluint64_t size);
+        void write_block(vluint64_t addr, const vluint8_t *buf, vluint64_t size);
+        void fill_block(vluint64_t addr, vluint8_t data, vluint64_t size);
+        // Returns -1 if identical, -2 on error, otherwise the first different address
+        vlsint64_t compare_block(vluint64_t addr, const vluint8_t *buf, vluint64_t size);
+        // Transaction level bursts (byte address, data bus words, DQM per beat)
+        void tlm_read(vluint64_t addr, int beats, vluint64_t *data);
+        void tlm_write(vluint64_t addr, int beats, const vluint64_t *data, const vluint8_t *mask);
+        // No command nor burst in progress : switching to/from TLM is safe
+        inline bool is_idle(void)
+        {
+            return (cmd_pipe.pipe == (vluint32_t)0x07070707) && (!bst_ctr_rd) && (!bst_ctr_wr);
+        }
+        // Binary log (see sdram_log.h), can be used with the text log
+        bool open_bin_log(const char *name);
+        void close_bin_log(void);
+        // Performance counters (name : saved at destruction, window : cycles)
+        void enable_stats(const char *name, bool row_hist, int window);
+        void save_stats(const char *name);
+        void reset_stats(void);
+        // Energy estimation parameters (default : MT48LC8M16A2-75 like device)
+        void set_power_params(const sdram_power_t &params);
+        // Estimated energy since the counters reset (pJ)
+        double get_energy(void);
+        // Digest of the memory (image order), pages : hash per SDRAM_HASH_LOG2 bytes
+        vluint64_t digest(std::vector<vluint64_t> *pages = NULL);
+        // Differences with an image file (first max_diffs ranges, at least 1)
+        // Returns the number of ranges, 0 : identical, -1 : file error or size mismatch
+        int compare_file(const char *name, int max_diffs,
+                         std::vector<vluint64_t> &addr, std::vector<vluint64_t> &size);
+        // Snapshot of the memory contents (pages are copied on first write)
+        void snapshot(void);
+        // Back to the snapshot (only the modified pages are copied)
+        vluint64_t restore(void);
+        // Regions modified since the snapshot (image addresses)
+        vluint64_t dirty_regions(std::vector<vluint64_t> &addr, std::vector<vluint64_t> &size);
+        // Modified regions saving (updates an image written by save)
+        void save_dirty(const char *name, vluint64_t size, vluint64_t addr);
+        // Initialization pattern (instead of zeroes)
+        void set_fill_pattern(vluint64_t pattern);
+        // Random initialization with a given seed (to replay a run)
+        void set_random_seed(vluint64_t seed);
+        vluint64_t get_random_seed(void) { return fill_seed; }
+        // Resident memory size (in bytes)
+        vluint64_t resident_size(void);
+        // Address watchpoints (image addresses, like the direct accesses)
+        // Returns the watchpoint id, -1 if out of range
+        int  add_watch(vluint64_t addr, vluint64_t size, int mode);
+        void del_watch(int id);
+        // Hits call-back (NULL : hits are printed)
+        void set_watch_callback(sdram_watch_cb_t cb, void *user);
+        vluint64_t get_watch_hits(void) { return watch_hits; }
         // Memory size (in bytes)
-        vluint32_t mem_size;
-    private:
+        vluint64_t mem_size;
+    protected:
         // Special type to access data byte lanes
         typedef union
         {
@@ -100,44 +239,70 @@ class SDRAM
             vluint16_t u16[4];
             vluint64_t pipe;
         } pipe_u16_t;
+        friend class SDRAMArray;
+        // Cycle evaluate, rising edge on clock (idle cycles filtered inline)
+        inline void eval_rise(vluint64_t ts,
+                              vluint8_t  cs_n,  vluint8_t ras_n,  vluint8_t  cas_n, vluint8_t we_n,
+                              vluint8_t  ba,    vluint16_t addr,
+                              vluint8_t  dqm,   vluint64_t dq_in, vluint64_t &dq_out)
+        {
+            st_cyc++;
+            // Idle : empty pipeline, no burst in progress and no command
+            if (!((cmd_pipe.pipe ^ (vluint32_t)0x07070707) | bst_ctr_rd | bst_ctr_wr |
+                  ((cs_n | (ras_n & cas_n & we_n)) ^ 1)))
+            {
+                dqm_pipe[0] = dqm_pipe[1];
+                dqm_pipe[1] = dqm;
+            }
+            else
+            {
+                eval_edge(ts, cs_n, ras_n, cas_n, we_n, ba, addr, dqm, dq_in, dq_out);
+            }
+        }
+        // Cycle evaluate, rising edge on clock
+        void eval_edge(vluint64_t ts,
+                       vluint8_t  cs_n,  vluint8_t ras_n,  vluint8_t  cas_n, vluint8_t we_n,
+                       vluint8_t  ba,    vluint16_t addr,
+                       vluint8_t  dqm,   vluint64_t dq_in, vluint64_t &dq_out);
+        vluint64_t burst_addr(int bank, int col);
         // Memory reading functions (to speedup access)
-        vluint8_t  (SDRAM::*read_u8_priv)(vluint32_t);
-        vluint16_t (SDRAM::*read_u16_priv)(vluint32_t);
-        vluint32_t (SDRAM::*read_u32_priv)(vluint32_t);
-        vluint64_t (SDRAM::*read_u64_priv)(vluint32_t);
-        vluint8_t  read_u8_i(vluint32_t addr);
-        vluint16_t read_u16_i_be(vluint32_t addr);
-        vluint16_t read_u16_i_le(vluint32_t addr);
-        vluint32_t read_u32_i_be(vluint32_t addr);
-        vluint32_t read_u32_i_le(vluint32_t addr);
-        vluint64_t read_u64_i_be(vluint32_t addr);
-        vluint64_t read_u64_i_le(vluint32_t addr);
-        vluint8_t  read_u8_c(vluint32_t addr);
-        vluint16_t read_u16_c_be(vluint32_t addr);
-        vluint16_t read_u16_c_le(vluint32_t addr);
-        vluint32_t read_u32_c_be(vluint32_t addr);
-        vluint32_t read_u32_c_le(vluint32_t addr);
-        vluint64_t read_u64_c_be(vluint32_t addr);
-        vluint64_t read_u64_c_le(vluint32_t addr);
+        vluint8_t  (SDRAM::*read_u8_priv)(vluint64_t);
+        vluint16_t (SDRAM::*read_u16_priv)(vluint64_t);
+        vluint32_t (SDRAM::*read_u32_priv)(vluint64_t);
+        vluint64_t (SDRAM::*read_u64_priv)(vluint64_t);
+        vluint8_t  read_u8_i(vluint64_t addr);
+        vluint16_t read_u16_i_be(vluint64_t addr);
+        vluint16_t read_u16_i_le(vluint64_t addr);
+        vluint32_t read_u32_i_be(vluint64_t addr);
+        vluint32_t read_u32_i_le(vluint64_t addr);
+        vluint64_t read_u64_i_be(vluint64_t addr);
+        vluint64_t read_u64_i_le(vluint64_t addr);
+        vluint8_t  read_u8_c(vluint64_t addr);
+        vluint16_t read_u16_c_be(vluint64_t addr);
+        vluint16_t read_u16_c_le(vluint64_t addr);
+        vluint32_t read_u32_c_be(vluint64_t addr);
+        vluint32_t read_u32_c_le(vluint64_t addr);
+        vluint64_t read_u64_c_be(vluint64_t addr);
+        vluint64_t read_u64_c_le(vluint64_t addr);
         // Memory writing functions (to speedup access)
-        void (SDRAM::*write_u8_priv)(vluint32_t, vluint8_t);
-        void (SDRAM::*write_u16_priv)(vluint32_t, vluint16_t);
-        void (SDRAM::*write_u32_priv)(vluint32_t, vluint32_t);
-        void (SDRAM::*write_u64_priv)(vluint32_t, vluint64_t);
-        void write_u8_i(vluint32_t addr, vluint8_t data);
-        void write_u16_i_be(vluint32_t addr, vluint16_t data);
-        void write_u16_i_le(vluint32_t addr, vluint16_t data);
-        void write_u32_i_be(vluint32_t addr, vluint32_t data);
-        void write_u32_i_le(vluint32_t addr, vluint32_t data);
-        void write_u64_i_be(vluint32_t addr, vluint64_t data);
-        void write_u64_i_le(vluint32_t addr, vluint64_t data);
-        void write_u8_c(vluint32_t addr, vluint8_t data);
-        void write_u16_c_be(vluint32_t addr, vluint16_t data);
-        void write_u16_c_le(vluint32_t addr, vluint16_t data);
-        void write_u32_c_be(vluint32_t addr, vluint32_t data);
-        void write_u32_c_le(vluint32_t addr, vluint32_t data);
-        void write_u64_c_be(vluint32_t addr, vluint64_t data);
-        void write_u64_c_le(vluint32_t addr, vluint64_t data);
+        void (SDRAM::*write_u8_priv)(vluint64_t, vluint8_t);
+        void (SDRAM::*write_u16_priv)(vluint64_t, vluint16_t);
+        void (SDRAM::*write_u32_priv)(vluint64_t, vluint32_t);
+        void (SDRAM::*write_u64_priv)(vluint64_t, vluint64_t);
+        void write_u8_i(vluint64_t addr, vluint8_t data);
+        void write_u16_i_be(vluint64_t addr, vluint16_t data);
+        void write_u16_i_le(vluint64_t addr, vluint16_t data);
+        void write_u32_i_be(vluint64_t addr, vluint32_t data);
+        void write_u32_i_le(vluint64_t addr, vluint32_t data);
+        void write_u64_i_be(vluint64_t addr, vluint64_t data);
+        void write_u64_i_le(vluint64_t addr, vluint64_t data);
+        void write_u8_c(vluint64_t addr, vluint8_t data);
+        void write_u16_c_be(vluint64_t addr, vluint16_t data);
+        void write_u16_c_le(vluint64_t addr, vluint16_t data);
+        void write_u32_c_be(vluint64_t addr, vluint32_t data);
+        void write_u32_c_le(vluint64_t addr, vluint32_t data);
+        void write_u64_c_be(vluint64_t addr, vluint64_t data);
+        void write_u64_c_le(vluint64_t addr, vluint64_t data);
         // SDRAM capacity
         int        bus_mask;                     // Data bus width (bytes - 1)
         int        bus_log2;                     // Data bus width (log2(bytes))
@@ -145,9 +310,55 @@ class SDRAM
         int        num_cols;                     // Number of columns
         int        bit_rows;                     // Number of rows (log 2)
         int        bit_cols;                     // Number of columns (log 2)
-        vluint32_t mask_bank;                    // Bit mask for banks
-        vluint32_t mask_rows;                    // Bit mask for rows
-        vluint32_t mask_cols;                    // Bit mask for columns
+        vluint64_t mask_bank;                    // Bit mask for banks
+        vluint64_t mask_rows;                    // Bit mask for rows
+        vluint64_t mask_cols;                    // Bit mask for columns
+        // Backing store
+        enum fill_t
+        {
+            FILL_ZERO    = 0,
+            FILL_RANDOM  = 1,
+            FILL_PATTERN = 2
+        };
+        void       fill_range(vluint8_t *ptr, vluint64_t size);
+        void       fill_copy(vluint8_t *ptr, vluint64_t offs, vluint64_t size);
+        void       fill_all(void);
+        void       fault_enter(void);
+        void       fault_leave(void);
+        bool       page_init(vluint64_t p_beg, vluint64_t p_end, vluint64_t skip_beg, vluint64_t skip_end,
+                             int prot, vluint8_t state);
+        bool       page_fault(vluint64_t page);
+        void       map_range(vluint64_t offs, vluint64_t size, bool write);
+        int        register_inst(void);
+        void       unregister_inst(void);
+        vluint64_t image_offs(vluint64_t addr);
+        vluint64_t image_addr(vluint64_t offs);
+        bool       block_check(vluint64_t addr, vluint64_t size);
+        void       image_copy(vluint8_t *img, vluint64_t addr, vluint64_t size, bool load);
+        void       image_copy_mt(vluint8_t *img, vluint64_t addr, vluint64_t size, bool load);
+        void       image_part(vluint8_t *img, vluint64_t addr, vluint64_t size, bool load);
+        void       image_prepare(vluint64_t addr, vluint64_t size, bool write);
+        void       image_peek(vluint8_t *img, vluint64_t addr, vluint64_t size,
+                              vluint8_t *pbuf, vluint64_t &pb_page);
+        int        image_threads(vluint64_t size, vluint64_t align, vluint64_t &part);
+        void       image_hash(vluint64_t addr, vluint64_t size, vluint64_t *hash);
+        void       image_diff(const vluint8_t *img, vluint64_t addr, vluint64_t size, int max_diffs,
+                              std::vector<vluint64_t> *d_addr, std::vector<vluint64_t> *d_size, bool *full);
+        static void fault_handler(int sig, siginfo_t *info, void *uctx);
+        vluint8_t  *mem_base;                     // All banks (one mapping)
+        vluint8_t  *init_base;                    // Second view, pages initialization (sparse mode)
+        int        mem_fd;                       // Memory object (sparse mode)
+        vluint64_t map_size;                     // Mapping size (bytes)
+        int        page_log2;                    // Page size (log2)
+        vluint64_t num_pages;                    // Number of pages
+        vluint8_t  *page_state;                   // Page state (sparse mode, snapshot)
+        int        fault_lock;                   // Page faults from several threads
+        bool       sparse_on;                    // Sparse mode
+        fill_t     fill_mode;                    // Initialization mode
+        vluint64_t fill_value;                   // Initialization pattern
+        vluint64_t fill_seed;                    // Random generator seed
+        vluint8_t  *snap_base;                    // Snapshot copies (written pages)
+        bool       snap_on;                      // Snapshot taken
         // Memory arrays
         vluint8_t  *array_u8[SDRAM_NUM_BANKS];   // 8-bit access
         vluint16_t *array_u16[SDRAM_NUM_BANKS];  // 16-bit access
@@ -164,8 +375,10 @@ class SDRAM
         bool       dbg_on;
         // Special memory flags
         vluint8_t  mem_flags;
+        int        lane_xor;                     // Byte lanes swap (bus_mask or 0)
         // Internal variables
         vluint8_t  prev_clk;                     // Previous clock state
+        vluint8_t  prev_cke;                     // Previous clock enable state
         pipe_u8_t  cmd_pipe;                     // Command pipeline
         pipe_u16_t col_pipe;                     // Column address pipeline
         pipe_u8_t  ba_pipe;                      // Bank address pipeline
@@ -185,6 +398,393 @@ class SDRAM
         FILE      *fh_log;
         char      *log_buf;
         int        log_size;
+        // Binary log file
+        inline void blog_put(vluint64_t ts, vluint8_t type, int bank, vluint64_t addr,
+                             vluint8_t flags, vluint8_t dqm, vluint64_t data)
+        {
+            sdram_log_rec_t *rec = blog_buf[blog_cur] + blog_pos;
+
+            rec->ts    = ts;
+            rec->data  = data;
+            rec->addr  = addr;
+            rec->type  = type;
+            rec->bank  = (vluint8_t)bank;
+            rec->dqm   = dqm;
+            rec->flags = flags;
+            if (++blog_pos == SDRAM_LOG_BUF_LEN) blog_swap();
+        }
+        void       blog_swap(void);
+        void       blog_thread(void);
+        bool       blog_on;                      // Binary log active
+        FILE      *blog_fh;                      // Binary log file
+        sdram_log_rec_t *blog_buf[2];            // Double buffer
+        int        blog_cur;                     // Buffer being filled
+        int        blog_pos;                     // Records in this buffer
+        int        blog_len;                     // Records to write (other buffer)
+        bool       blog_stop;                    // Writer thread exit
+        std::thread *blog_thr;                   // Writer thread
+        std::mutex   blog_mtx;
+        std::condition_variable blog_cv;
+        // Performance counters
+        typedef struct
+        {
+            vluint64_t act;                      // Activates
+            vluint64_t pre;                      // Precharges (explicit)
+            vluint64_t ap;                       // Auto-precharges
+            vluint64_t rd_cmd;                   // Read commands
+            vluint64_t wr_cmd;                   // Write commands
+            vluint64_t rd_beat;                  // Read data beats
+            vluint64_t wr_beat;                  // Write data beats
+            vluint64_t row_hit;                  // Accesses to an opened row
+            vluint64_t row_miss;                 // First accesses after activate
+            vluint64_t open_cyc;                 // Cycles with an opened row
+        } bank_stats_t;
+        // Energy breakdown (pJ)
+        typedef struct
+        {
+            double     background;               // Standby (active or precharged)
+            double     activate;                 // Activate - precharge pairs
+            double     read;                     // Read bursts
+            double     write;                    // Write bursts
+            double     refresh;                  // Auto refreshes
+            double     power_down;               // Power-down (active or precharged)
+            double     self_refresh;             // Self refresh
+            double     total;
+            double     bank[SDRAM_NUM_BANKS];    // Activate, read and write per bank
+        } energy_t;
+        inline void stats_busy(void);
+        void       stats_cmd(vluint8_t cmd, vluint8_t ba, vluint16_t a10);
+        void       stats_beat(int dir);
+        void       stats_row(int b, bool open);
+        void       stats_cke(vluint64_t ts, vluint8_t cke, vluint8_t cs_n,
+                             vluint8_t ras_n, vluint8_t cas_n, vluint8_t we_n);
+        void       stats_win_size(vluint64_t w);
+        void       stats_open_add(vluint64_t beg, vluint64_t end, std::vector<vluint32_t> &win);
+        void       stats_energy(energy_t &e, std::vector<double> *win);
+        bool       stats_on;                     // Counters active
+        char      *st_name;                      // Saved at destruction
+        vluint64_t st_cyc;                       // Rising edges (always counted)
+        vluint64_t st_base;                      // Rising edges at reset
+        vluint64_t st_busy;                      // Cycles with a command or data
+        vluint64_t st_last;                      // Last busy cycle
+        vluint64_t st_ref;                       // Auto refreshes
+        vluint64_t st_turn;                      // Bus turnaround cycles
+        vluint64_t st_switch;                    // Bus direction changes
+        int        st_dir;                       // Last data direction
+        vluint64_t st_beat_cyc;                  // Last data cycle
+        bool       st_new_row[SDRAM_NUM_BANKS];  // Row activated, not accessed
+        bank_stats_t st_bank[SDRAM_NUM_BANKS];
+        vluint32_t *st_hist;                      // Row histogram (optional)
+        vluint64_t st_window;                    // Bandwidth window (cycles)
+        std::vector<vluint32_t> st_bw_rd;        // Read bytes per window
+        std::vector<vluint32_t> st_bw_wr;        // Write bytes per window
+        std::vector<vluint32_t> st_win_act;      // Activates per window
+        std::vector<vluint32_t> st_win_ref;      // Auto refreshes per window
+        std::vector<vluint32_t> st_win_open;     // Cycles with an opened row per window
+        // Energy estimation (counters only, computed when reported)
+        sdram_power_t pw;                        // Datasheet parameters
+        int        st_open_n;                    // Opened rows
+        vluint64_t st_open_at[SDRAM_NUM_BANKS];  // Row opening cycle (per bank)
+        vluint64_t st_any_at;                    // First row opening cycle
+        vluint64_t st_open_cyc;                  // Cycles with an opened row
+        vluint64_t st_cke_ts;                    // CKE falling edge time (ps)
+        int        st_cke_mode;                  // 0 : precharge PD, 1 : active PD, 2 : self refresh
+        vluint64_t st_pd_ps[3];                  // Residency per mode (ps)
+        // Watchpoints
+        typedef struct
+        {
+            vluint64_t addr;                     // First byte
+            vluint64_t size;                     // Size (bytes)
+            int        mode;                     // SDRAM_WATCH_xx
+            int        id;                       // Returned by add_watch
+        } watch_t;
+        // Accesses are aligned on their size : one bitmap bit per access
+        inline bool watch_test(vluint64_t addr)
+        {
+            addr &= map_size - 1;
+            return (watch_map[addr >> (SDRAM_WATCH_LOG2 + 6)] >> ((addr >> SDRAM_WATCH_LOG2) & 63)) & 1;
+        }
+        void       watch_check(vluint64_t addr, int size, int mode, vluint64_t data);
+        void       watch_build(void);
+        bool       watch_on;                     // At least one watchpoint
+        vluint64_t *watch_map;                    // Watched pages bitmap
+        std::vector<watch_t> watch_list;         // Sorted by address
+        sdram_watch_cb_t watch_cb;               // Hits call-back
+        void      *watch_user;                   // Call-back parameter
+        vluint64_t watch_hits;                   // Number of hits
+        vluint64_t watch_ts;                     // Last clock edge
+        int        watch_id;                     // Next watchpoint id
+};
+
+// Multi-chip SDRAM array :
+// -------------------------
+//  - "chips" devices on the same chip select form one rank : their data buses
+//    are merged in one array (one access per beat for the whole rank)
+//  - One rank per chip select, sharing the command, address and data pins
+//  - Clock edges are detected once, unselected ranks stay on the idle path
+//  - Direct accesses : ranks are stacked (rank number above the rank size)
+//  - Usage : SDRAMArray sdram(2, 4, 13, 9, FLAG_DATA_WIDTH_16, NULL);
+//            (2 ranks of 4 x16 chips : 64-bit data bus, cs_n[1:0])
+class SDRAMArray
+{
+    public:
+        // "flags" gives the data bus width of one chip
+        // (logfile : one file per rank, suffixed with ".csN" for several ranks)
+        SDRAMArray(int ranks, int chips, vluint8_t log2_rows, vluint8_t log2_cols,
+                   vluint8_t flags, const char *logfile, vluint64_t seed = 0);
+        ~SDRAMArray();
+        // Cycle evaluate (cs_n : one bit per rank)
+        inline void eval(vluint64_t ts,    vluint8_t clk,    vluint8_t  cke,
+                         vluint8_t  cs_n,  vluint8_t ras_n,  vluint8_t  cas_n, vluint8_t we_n,
+                         vluint8_t  ba,    vluint16_t addr,
+                         vluint8_t  dqm,   vluint64_t dq_in, vluint64_t &dq_out)
+        {
+            // Power-down and self refresh residency
+            if (cke ^ prev_cke)
+            {
+                for (int r = 0; r < num_ranks; r++)
+                {
+                    rank_mem[r]->stats_cke(ts, cke, (cs_n >> r) & 1, ras_n, cas_n, we_n);
+                }
+                prev_cke = cke;
+            }
+            // Clock enabled, rising edge on clock
+            if (cke & clk & (prev_clk ^ 1))
+            {
+                for (int r = 0; r < num_ranks; r++)
+                {
+                    rank_mem[r]->eval_rise(ts, (cs_n >> r) & 1, ras_n, cas_n, we_n,
+                                           ba, addr, dqm, dq_in, dq_out);
+                }
+            }
+            // For edge detection (clock disabled : cleared)
+            prev_clk = clk & cke;
+        }
+        // One rank (for the SDRAM methods : load, save, snapshot, stats...)
+        inline SDRAM *rank(int r) { return rank_mem[r]; }
+        inline int    get_ranks(void) { return num_ranks; }
+        // Direct memory read access
+        vluint8_t  read_byte(vluint64_t addr);
+        vluint16_t read_word(vluint64_t addr);
+        vluint32_t read_long(vluint64_t addr);
+        vluint64_t read_quad(vluint64_t addr);
+        // Direct memory write access
+        void write_byte(vluint64_t addr, vluint8_t  data);
+        void write_word(vluint64_t addr, vluint16_t data);
+        void write_long(vluint64_t addr, vluint32_t data);
+        void write_quad(vluint64_t addr, vluint64_t data);
+        // No command nor burst in progress on any rank
+        bool is_idle(void);
+        // Memory size (in bytes, all ranks)
+        vluint64_t mem_size;
+    private:
+        inline SDRAM *rank_of(vluint64_t &addr)
+        {
+            SDRAM *mem = rank_mem[(addr >> rank_log2) & (num_ranks - 1)];
+
+            addr &= rank_mask;
+            return mem;
+        }
+        int        num_ranks;                    // Number of chip selects
+        int        rank_log2;                    // Rank size (log2(bytes))
+        vluint64_t rank_mask;                    // Rank size - 1
+        vluint8_t  prev_clk;                     // Previous clock state
+        vluint8_t  prev_cke;                     // Previous clock enable state
+        SDRAM     *rank_mem[SDRAM_MAX_RANKS];    // One model per rank
+};
+
+// DPI-C block transfers (sdr_sdram_dpi.cpp)
+// Returns the handle to pass to the sdram_*_block() functions
+int sdram_dpi_attach(SDRAM *mem);
+
+// Compile-time specialized SDRAM :
+// ---------------------------------
+//  - Same command state machine and backing store as the SDRAM class
+//  - Address decomposition and byte swapping are known at compile time :
+//    the direct accesses are inlined in the DPI shortcuts
+//  - read_xxx / write_xxx : same results as the SDRAM ones (not virtual,
+//    an SDRAM pointer to the object calls the SDRAM ones)
+//  - read_img_xxx / write_img_xxx access the image bytes in host order, for
+//    any access width (same as read_xxx when the access width is the data
+//    bus width)
+//  - Usage : SDRAMT<1, false, false, 13, 9> sdram(FLAG_RANDOM_FILLED, NULL);
+template <int BUS_LOG2, bool INTERLEAVED, bool BIG_END, int ROWS_LOG2, int COLS_LOG2>
+class SDRAMT : public SDRAM
+{
+    public:
+        // Only FLAG_RANDOM_FILLED, FLAG_SPARSE_MEMORY and FLAG_HUGE_PAGES are taken from "flags"
+        SDRAMT(vluint8_t flags, const char *logfile, vluint64_t seed = 0) :
+            SDRAM((vluint8_t)ROWS_LOG2, (vluint8_t)COLS_LOG2,
+                  c_flags | (flags & (FLAG_RANDOM_FILLED | FLAG_SPARSE_MEMORY | FLAG_HUGE_PAGES)),
+                  logfile, seed)
+        {
+        }
+        // Direct memory read access
+        inline vluint8_t  read_byte(vluint64_t addr) { return read_a<vluint8_t>(addr);  }
+        inline vluint16_t read_word(vluint64_t addr) { return read_a<vluint16_t>(addr); }
+        inline vluint32_t read_long(vluint64_t addr) { return read_a<vluint32_t>(addr); }
+        inline vluint64_t read_quad(vluint64_t addr) { return read_a<vluint64_t>(addr); }
+        // Direct memory write access
+        inline void write_byte(vluint64_t addr, vluint8_t  data) { write_a<vluint8_t>(addr, data);  }
+        inline void write_word(vluint64_t addr, vluint16_t data) { write_a<vluint16_t>(addr, data); }
+        inline void write_long(vluint64_t addr, vluint32_t data) { write_a<vluint32_t>(addr, data); }
+        inline void write_quad(vluint64_t addr, vluint64_t data) { write_a<vluint64_t>(addr, data); }
+        // Direct memory read access (image layout)
+        inline vluint8_t  read_img_byte(vluint64_t addr) { return read_t<vluint8_t>(addr);  }
+        inline vluint16_t read_img_word(vluint64_t addr) { return read_t<vluint16_t>(addr); }
+        inline vluint32_t read_img_long(vluint64_t addr) { return read_t<vluint32_t>(addr); }
+        inline vluint64_t read_img_quad(vluint64_t addr) { return read_t<vluint64_t>(addr); }
+        // Direct memory write access (image layout)
+        inline void write_img_byte(vluint64_t addr, vluint8_t  data) { write_t<vluint8_t>(addr, data);  }
+        inline void write_img_word(vluint64_t addr, vluint16_t data) { write_t<vluint16_t>(addr, data); }
+        inline void write_img_long(vluint64_t addr, vluint32_t data) { write_t<vluint32_t>(addr, data); }
+        inline void write_img_quad(vluint64_t addr, vluint64_t data) { write_t<vluint64_t>(addr, data); }
+    private:
+        static_assert((BUS_LOG2 >= 0) && (BUS_LOG2 <= 3), "8/16/32/64-bit data bus only");
+        // Geometry
+        static const int        c_bus_size = 1 << BUS_LOG2;
+        static const int        c_row_log2 = COLS_LOG2 + BUS_LOG2;
+        static const int        c_bnk_log2 = ROWS_LOG2 + c_row_log2;
+        static const vluint64_t c_mem_mask = ((vluint64_t)1 << (c_bnk_log2 + SDRAM_BIT_BANKS)) - 1;
+        static const vluint8_t  c_flags    = (vluint8_t)(c_bus_size - 1)
+                                           | (INTERLEAVED ? FLAG_BANK_INTERLEAVING : 0)
+                                           | (BIG_END ? FLAG_BIG_ENDIAN : 0);
+        // Byte lanes are swapped when the memory and the host endianness differ
+#if BYTE_ORDER == LITTLE_ENDIAN
+        static const bool       c_swap     = BIG_END && (BUS_LOG2 > 0);
+#else
+        static const bool       c_swap     = !BIG_END && (BUS_LOG2 > 0);
+#endif
+        static inline vluint8_t  bswap(vluint8_t  v) { return v; }
+        static inline vluint16_t bswap(vluint16_t v) { return __builtin_bswap16(v); }
+        static inline vluint32_t bswap(vluint32_t v) { return __builtin_bswap32(v); }
+        static inline vluint64_t bswap(vluint64_t v) { return __builtin_bswap64(v); }
+        // Memory offset of a byte address
+        static inline vluint64_t offs(vluint64_t addr)
+        {
+            addr &= c_mem_mask;
+            if (INTERLEAVED)
+            {
+                // |      rows       |  banks  |     columns     |
+                vluint64_t col = addr & (((vluint64_t)1 << c_row_log2) - 1);
+                vluint64_t bnk = (addr >> c_row_log2) & (SDRAM_NUM_BANKS - 1);
+                vluint64_t row = addr >> (c_row_log2 + SDRAM_BIT_BANKS);
+
+                return (bnk << c_bnk_log2) | (row << c_row_log2) | col;
+            }
+            else
+            {
+                // |  banks  |      rows       |     columns     |
+                return addr;
+            }
+        }
+        // Memory offset of an access (like SDRAM::read_uxx_x : one array element
+        // per column, the access width sets the element size)
+        template <typename T> static inline vluint64_t offs_a(vluint64_t addr)
+        {
+            const int t_log2 = (sizeof(T) == 8) ? 3 : (sizeof(T) == 4) ? 2 : (sizeof(T) == 2) ? 1 : 0;
+            vluint64_t bnk;
+            vluint64_t idx;
+
+            addr >>= t_log2;
+            if (INTERLEAVED)
+            {
+                // |      rows       |  banks  |     columns     |
+                bnk = (addr >> COLS_LOG2) & (SDRAM_NUM_BANKS - 1);
+                idx = (addr & (((vluint64_t)1 << COLS_LOG2) - 1))
+                    | (((addr >> (COLS_LOG2 + SDRAM_BIT_BANKS)) & (((vluint64_t)1 << ROWS_LOG2) - 1)) << COLS_LOG2);
+            }
+            else
+            {
+                // |  banks  |      rows       |     columns     |
+                bnk = (addr >> (COLS_LOG2 + ROWS_LOG2)) & (SDRAM_NUM_BANKS - 1);
+                idx = addr & (((vluint64_t)1 << (COLS_LOG2 + ROWS_LOG2)) - 1);
+            }
+            return (bnk << c_bnk_log2) | (idx << t_log2);
+        }
+        // Memory and host endianness differ : the whole access is swapped
+        template <typename T> static inline T swap_a(T v)
+        {
+#if BYTE_ORDER == LITTLE_ENDIAN
+            return (BIG_END) ? bswap(v) : v;
+#else
+            return (BIG_END) ? v : bswap(v);
+#endif
+        }
+        template <typename T> inline T read_a(vluint64_t addr)
+        {
+            T v;
+
+            memcpy((void *)&v, (const void *)(mem_base + offs_a<T>(addr)), sizeof(T));
+            v = swap_a<T>(v);
+            if ((watch_on) && (watch_test(addr)))
+                watch_check(addr, (int)sizeof(T), SDRAM_WATCH_RD, (vluint64_t)v);
+            return v;
+        }
+        template <typename T> inline void write_a(vluint64_t addr, T v)
+        {
+            if ((watch_on) && (watch_test(addr)))
+                watch_check(addr, (int)sizeof(T), SDRAM_WATCH_WR, (vluint64_t)v);
+            v = swap_a<T>(v);
+            memcpy((void *)(mem_base + offs_a<T>(addr)), (const void *)&v, sizeof(T));
+        }
+        template <typename T> inline T read_t(vluint64_t addr)
+        {
+            T v;
+
+            addr &= ~(vluint64_t)(sizeof(T) - 1);
+            if (!c_swap)
+            {
+                memcpy((void *)&v, (const void *)(mem_base + offs(addr)), sizeof(T));
+            }
+            else if ((int)sizeof(T) <= c_bus_size)
+            {
+                // Inside one data bus word : one byte swap
+                memcpy((void *)&v, (const void *)(mem_base + (offs(addr) ^ (c_bus_size - sizeof(T)))), sizeof(T));
+                v = bswap(v);
+            }
+            else
+            {
+                // Several data bus words : byte per byte
+                vluint8_t buf[sizeof(T)];
+
+                for (int i = 0; i < (int)sizeof(T); i++)
+                {
+                    buf[i] = mem_base[offs(addr + i) ^ (c_bus_size - 1)];
+                }
+                memcpy((void *)&v, (const void *)buf, sizeof(T));
+            }
+            if ((watch_on) && (watch_test(addr)))
+                watch_check(addr, (int)sizeof(T), SDRAM_WATCH_RD, (vluint64_t)v);
+            return v;
+        }
+        template <typename T> inline void write_t(vluint64_t addr, T v)
+        {
+            addr &= ~(vluint64_t)(sizeof(T) - 1);
+            if ((watch_on) && (watch_test(addr)))
+                watch_check(addr, (int)sizeof(T), SDRAM_WATCH_WR, (vluint64_t)v);
+            if (!c_swap)
+            {
+                memcpy((void *)(mem_base + offs(addr)), (const void *)&v, sizeof(T));
+            }
+            else if ((int)sizeof(T) <= c_bus_size)
+            {
+                // Inside one data bus word : one byte swap
+                v = bswap(v);
+                memcpy((void *)(mem_base + (offs(addr) ^ (c_bus_size - sizeof(T)))), (const void *)&v, sizeof(T));
+            }
+            else
+            {
+                // Several data bus words : byte per byte
+                vluint8_t buf[sizeof(T)];
+
+                memcpy((void *)buf, (const void *)&v, sizeof(T));
+                for (int i = 0; i < (int)sizeof(T); i++)
+                {
+                    mem_base[offs(addr + i) ^ (c_bus_size - 1)] = buf[i];
+                }
+            }
+        }
 };
 
 #endif /* _SDR_SDRAM_H_ */
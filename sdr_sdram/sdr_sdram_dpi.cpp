@@ -0,0 +1,178 @@
+// Copyright 2013-2022 Frederic Requin
+//
+// License: BSD
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions 
+// are met:
+//   - Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//   - Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer 
+//     in the documentation and/or other materials provided with the 
+//     distribution.
+//   - Neither the name of the author nor the names of its contributors 
+//     may be used to endorse or promote products derived from this 
+//     software without specific prior written permission.
+//
+// SDRAM DPI-C backdoor:
+// ---------------------
+//  - Block transfers between SystemVerilog byte arrays and an SDRAM model
+//  - The C++ testbench attaches the model : hdl = sdram_dpi_attach(sdram);
+//  - SystemVerilog declarations :
+//
+//    import "DPI-C" function void sdram_read_block
+//      (input int hdl, input longint unsigned addr, output byte unsigned data[]);
+//    import "DPI-C" function void sdram_write_block
+//      (input int hdl, input longint unsigned addr, input byte unsigned data[]);
+//    import "DPI-C" function void sdram_fill_block
+//      (input int hdl, input longint unsigned addr, input byte unsigned data, input int unsigned size);
+//    import "DPI-C" function longint sdram_compare_block
+//      (input int hdl, input longint unsigned addr, input byte unsigned data[]);
+//    (returns -1 if identical, -2 on error, otherwise the first different address)
+//
+//  - Transaction level bursts for a controller stub (data bus words, DQM) :
+//
+//    import "DPI-C" function void sdram_tlm_read
+//      (input int hdl, input longint unsigned addr, output longint unsigned data[]);
+//    import "DPI-C" function void sdram_tlm_write
+//      (input int hdl, input longint unsigned addr, input longint unsigned data[],
+//       input byte unsigned dqm[]);
+//    (an empty dqm[] array writes all the bytes, a dqm[] shorter than data[] writes nothing)
+//
+
+#include "svdpi.h"
+#include "verilated.h"
+#include "sdr_sdram.h"
+#include <stdio.h>
+
+#define SDRAM_MAX_DPI (8)
+
+static SDRAM *s_dpi_mem[SDRAM_MAX_DPI];
+static int    s_dpi_num = 0;
+
+// Attach an SDRAM model, returns its handle (-1 : table full)
+int sdram_dpi_attach(SDRAM *mem)
+{
+    if (s_dpi_num == SDRAM_MAX_DPI)
+    {
+        printf("Too many SDRAM models attached to DPI !!\n");
+        return -1;
+    }
+    s_dpi_mem[s_dpi_num] = mem;
+    return s_dpi_num++;
+}
+
+// Model from handle
+static SDRAM *dpi_mem(int hdl)
+{
+    if ((hdl < 0) || (hdl >= s_dpi_num))
+    {
+        printf("Invalid SDRAM DPI handle %d !!\n", hdl);
+        return (SDRAM *)NULL;
+    }
+    return s_dpi_mem[hdl];
+}
+
+// Open array data (NULL : not a contiguous array)
+static void *dpi_ptr(const svOpenArrayHandle data)
+{
+    void *ptr = svGetArrayPtr(data);
+
+    if ((!ptr) && (svSize(data, 1) > 0))
+    {
+        printf("SDRAM DPI array is not contiguous !!\n");
+    }
+    return ptr;
+}
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void sdram_read_block(int hdl, unsigned long long addr, const svOpenArrayHandle data)
+{
+    SDRAM     *mem = dpi_mem(hdl);
+    vluint8_t *ptr = (vluint8_t *)dpi_ptr(data);
+
+    if ((mem) && (ptr))
+    {
+        mem->read_block((vluint64_t)addr, ptr, (vluint64_t)svSize(data, 1));
+    }
+}
+
+void sdram_write_block(int hdl, unsigned long long addr, const svOpenArrayHandle data)
+{
+    SDRAM           *mem = dpi_mem(hdl);
+    const vluint8_t *ptr = (const vluint8_t *)dpi_ptr(data);
+
+    if ((mem) && (ptr))
+    {
+        mem->write_block((vluint64_t)addr, ptr, (vluint64_t)svSize(data, 1));
+    }
+}
+
+void sdram_fill_block(int hdl, unsigned long long addr, unsigned char data, unsigned int size)
+{
+    SDRAM *mem = dpi_mem(hdl);
+
+    if (mem)
+    {
+        mem->fill_block((vluint64_t)addr, (vluint8_t)data, (vluint64_t)size);
+    }
+}
+
+long long sdram_compare_block(int hdl, unsigned long long addr, const svOpenArrayHandle data)
+{
+    SDRAM           *mem = dpi_mem(hdl);
+    const vluint8_t *ptr = (const vluint8_t *)dpi_ptr(data);
+
+    if (!mem) return -2LL;
+    // Empty array : nothing to compare
+    if (!svSize(data, 1)) return -1LL;
+    if (!ptr) return -2LL;
+
+    return (long long)mem->compare_block((vluint64_t)addr, ptr, (vluint64_t)svSize(data, 1));
+}
+
+void sdram_tlm_read(int hdl, unsigned long long addr, const svOpenArrayHandle data)
+{
+    SDRAM      *mem = dpi_mem(hdl);
+    vluint64_t *ptr = (vluint64_t *)dpi_ptr(data);
+
+    if ((mem) && (ptr))
+    {
+        mem->tlm_read((vluint64_t)addr, svSize(data, 1), ptr);
+    }
+}
+
+void sdram_tlm_write(int hdl, unsigned long long addr, const svOpenArrayHandle data, const svOpenArrayHandle dqm)
+{
+    SDRAM            *mem = dpi_mem(hdl);
+    const vluint64_t *ptr = (const vluint64_t *)dpi_ptr(data);
+
+    if ((mem) && (ptr))
+    {
+        int beats = svSize(data, 1);
+
+        if (!svSize(dqm, 1))
+        {
+            // No byte mask
+            mem->tlm_write((vluint64_t)addr, beats, ptr, (const vluint8_t *)NULL);
+        }
+        else if (svSize(dqm, 1) < beats)
+        {
+            printf("SDRAM DPI byte mask is shorter than the burst (%d < %d) !!\n", svSize(dqm, 1), beats);
+        }
+        else
+        {
+            const vluint8_t *msk = (const vluint8_t *)dpi_ptr(dqm);
+
+            if (msk) mem->tlm_write((vluint64_t)addr, beats, ptr, msk);
+        }
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
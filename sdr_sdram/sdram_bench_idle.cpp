@@ -0,0 +1,162 @@
+// Copyright 2013-2022 Frederic Requin
+//
+// License: BSD
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//   - Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//   - Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer
+//     in the documentation and/or other materials provided with the
+//     distribution.
+//   - Neither the name of the author nor the names of its contributors
+//     may be used to endorse or promote products derived from this
+//     software without specific prior written permission.
+//
+// SDRAM idle cycles benchmark:
+// ----------------------------
+//  - 16-bit SDRAM driven at the pins, two eval() calls per clock cycle
+//  - One ACT / WR-AP / ACT / RD-AP sequence every "period" cycles,
+//    NOP cycles in between (a mostly idle controller)
+//  - Reports the time per clock cycle and a read data checksum
+//  - Standalone : g++ -O2 -I$VERILATOR_ROOT/include -o sdram_bench_idle sdram_bench_idle.cpp sdr_sdram.cpp -lpthread
+//
+// Usage : sdram_bench_idle [+cycles=<num>] [+period=<num>]
+//
+
+#include "verilated.h"
+#include "sdr_sdram.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctime>
+
+// SDRAM commands (RAS_n, CAS_n, WE_n)
+#define CMD_LMR  (0)
+#define CMD_REF  (1)
+#define CMD_PRE  (2)
+#define CMD_ACT  (3)
+#define CMD_WR   (4)
+#define CMD_RD   (5)
+#define CMD_NOP  (7)
+
+// Clock period (ps) : 100 MHz
+#define CLK_HALF (5000)
+
+// SDRAM model (global)
+SDRAM *sdr;
+// Simulation time
+vluint64_t tb_time;
+// Read data checksum
+vluint64_t chk_sum;
+
+// Value of a "+name=<num>" argument (NULL : not found)
+static const char *plus_arg(int argc, char **argv, const char *name)
+{
+    size_t len = strlen(name);
+
+    for (int i = 1; i < argc; i++)
+    {
+        if ((argv[i][0] == '+') && (!strncmp(argv[i] + 1, name, len))) return argv[i] + 1 + len;
+    }
+    return (const char *)NULL;
+}
+
+// One clock cycle : falling edge then rising edge
+static void ClockCycle(int cmd, vluint8_t ba, vluint16_t addr, vluint64_t dq_in)
+{
+    vluint64_t dq_out = 0;
+
+    sdr->eval(tb_time, 0, 1, 0, (cmd >> 2) & 1, (cmd >> 1) & 1, cmd & 1, ba, addr, 0, dq_in, dq_out);
+    tb_time += CLK_HALF;
+    sdr->eval(tb_time, 1, 1, 0, (cmd >> 2) & 1, (cmd >> 1) & 1, cmd & 1, ba, addr, 0, dq_in, dq_out);
+    tb_time += CLK_HALF;
+
+    chk_sum = (chk_sum << 1 | chk_sum >> 63) ^ dq_out;
+}
+
+int main(int argc, char **argv, char **env)
+{
+    // Benchmark duration
+    clock_t beg, end;
+    double secs;
+    // Clock cycles
+    vluint64_t cyc;
+    vluint64_t max_cyc;
+    vluint64_t period;
+    // Testbench configuration
+    const char *arg;
+
+    // Default : 10 million cycles
+    max_cyc = (vluint64_t)10000000;
+
+    // Benchmark duration : +cycles=<num>
+    arg = plus_arg(argc, argv, "cycles=");
+    if ((arg) && (arg[0]))
+    {
+        max_cyc = (vluint64_t)atoll(arg);
+    }
+
+    // Default : one access sequence every 1000 cycles
+    period = (vluint64_t)1000;
+
+    // Access period : +period=<num> (at least 16 cycles, one sequence)
+    arg = plus_arg(argc, argv, "period=");
+    if ((arg) && (arg[0]))
+    {
+        period = (vluint64_t)atoll(arg);
+        period = (period < 16) ? 16 : period;
+    }
+
+    // 16 MB, 16-bit : 4 banks x 4096 rows x 512 cols
+    sdr = new SDRAM(12, 9, FLAG_DATA_WIDTH_16, NULL, 1);
+    tb_time = (vluint64_t)0;
+    chk_sum = (vluint64_t)0;
+
+    // Precharge all, CAS latency 2, burst of 4
+    ClockCycle(CMD_PRE, 0, 0x400, 0);
+    ClockCycle(CMD_NOP, 0, 0x000, 0);
+    ClockCycle(CMD_LMR, 0, 0x022, 0);
+    ClockCycle(CMD_NOP, 0, 0x000, 0);
+
+    beg = clock();
+
+    for (cyc = 0; cyc < max_cyc; cyc += period)
+    {
+        vluint8_t  ba  = (vluint8_t)((cyc / period) & 3);
+        vluint16_t row = (vluint16_t)((cyc / period) & 4095);
+
+        // Write burst with auto precharge (4 beats)
+        ClockCycle(CMD_ACT, ba, row,   0);
+        ClockCycle(CMD_NOP, 0,  0,     0);
+        ClockCycle(CMD_WR,  ba, 0x400, cyc);
+        ClockCycle(CMD_NOP, 0,  0,     cyc + 1);
+        ClockCycle(CMD_NOP, 0,  0,     cyc + 2);
+        ClockCycle(CMD_NOP, 0,  0,     cyc + 3);
+        ClockCycle(CMD_NOP, 0,  0,     0);
+        ClockCycle(CMD_NOP, 0,  0,     0);
+        // Read burst with auto precharge (4 beats)
+        ClockCycle(CMD_ACT, ba, row,   0);
+        ClockCycle(CMD_NOP, 0,  0,     0);
+        ClockCycle(CMD_RD,  ba, 0x400, 0);
+        for (vluint64_t i = 11; i < period; i++)
+        {
+            ClockCycle(CMD_NOP, 0, 0, 0);
+        }
+    }
+
+    end  = clock();
+    secs = (double)(end - beg) / CLOCKS_PER_SEC;
+
+    printf("Clock cycles : %llu, one access sequence every %llu cycles\n",
+           (unsigned long long)cyc, (unsigned long long)period);
+    printf("Read data checksum : %016llX\n", (unsigned long long)chk_sum);
+    printf("Time per clock cycle : %5.2f ns\n", secs * 1e9 / (double)cyc);
+    printf("Seconds elapsed : %5.3f\n", secs);
+
+    delete sdr;
+
+    exit(0);
+}
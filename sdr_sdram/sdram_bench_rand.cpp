@@ -0,0 +1,138 @@
+// Copyright 2013-2022 Frederic Requin
+//
+// License: BSD
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//   - Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//   - Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer
+//     in the documentation and/or other materials provided with the
+//     distribution.
+//   - Neither the name of the author nor the names of its contributors
+//     may be used to endorse or promote products derived from this
+//     software without specific prior written permission.
+//
+// SDRAM random backdoor reads benchmark:
+// --------------------------------------
+//  - 64-bit SDRAM with interleaved banks, 1 GB by default
+//  - Random read_quad() accesses over the whole array (TLB bound)
+//  - Array backing : transparent huge pages (default), reserved huge pages
+//    (+huge, FLAG_HUGE_PAGES) or 4 KB pages (+sparse, FLAG_SPARSE_MEMORY)
+//  - Reports the time per read and a read data checksum
+//  - Standalone : g++ -O2 -I$VERILATOR_ROOT/include -o sdram_bench_rand sdram_bench_rand.cpp sdr_sdram.cpp -lpthread
+//
+// Usage : sdram_bench_rand [+mbytes=<num>] [+reads=<num>] [+huge] [+sparse]
+//
+
+#include "verilated.h"
+#include "sdr_sdram.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctime>
+
+// Columns per row (log2) and data bus width (log2, bytes)
+#define COLS_LOG2 (12)
+#define BUS_LOG2  (3)
+
+// Value of a "+name" or "+name=<num>" argument (NULL : not found)
+static const char *plus_arg(int argc, char **argv, const char *name)
+{
+    size_t len = strlen(name);
+
+    for (int i = 1; i < argc; i++)
+    {
+        if ((argv[i][0] == '+') && (!strncmp(argv[i] + 1, name, len))) return argv[i] + 1 + len;
+    }
+    return (const char *)NULL;
+}
+
+int main(int argc, char **argv, char **env)
+{
+    // Benchmark duration
+    clock_t beg, end;
+    double secs;
+    // SDRAM model
+    SDRAM *sdr;
+    vluint8_t flags;
+    int rows_log2;
+    vluint64_t size;
+    // Random reads
+    vluint64_t num;
+    vluint64_t rnd;
+    vluint64_t chk_sum;
+    // Testbench configuration
+    const char *arg;
+
+    // Default : 1 GB (8192 rows)
+    rows_log2 = 13;
+
+    // Array size : +mbytes=<num> (rounded down to a power of two, 1 MB to 8 GB)
+    arg = plus_arg(argc, argv, "mbytes=");
+    if ((arg) && (arg[0]))
+    {
+        vluint64_t mb = (vluint64_t)atoll(arg);
+
+        rows_log2 = 20 - COLS_LOG2 - BUS_LOG2 - SDRAM_BIT_BANKS;
+        while ((mb > 1) && (rows_log2 < 16))
+        {
+            mb >>= 1;
+            rows_log2++;
+        }
+    }
+
+    // Default : 20 million reads
+    num = (vluint64_t)20000000;
+
+    // Number of reads : +reads=<num>
+    arg = plus_arg(argc, argv, "reads=");
+    if ((arg) && (arg[0]))
+    {
+        num = (vluint64_t)atoll(arg);
+    }
+
+    // Array backing : +huge, +sparse
+    flags = FLAG_DATA_WIDTH_64 | FLAG_BANK_INTERLEAVING;
+    if (plus_arg(argc, argv, "huge"))   flags |= FLAG_HUGE_PAGES;
+    if (plus_arg(argc, argv, "sparse")) flags |= FLAG_SPARSE_MEMORY;
+
+    sdr  = new SDRAM((vluint8_t)rows_log2, (vluint8_t)COLS_LOG2, flags, NULL, 1);
+    size = (vluint64_t)SDRAM_NUM_BANKS << (rows_log2 + COLS_LOG2 + BUS_LOG2);
+
+    // Every page mapped before the measure
+    sdr->fill_block(0, 0x5A, size);
+    for (vluint64_t a = 0; a < size; a += 4096)
+    {
+        sdr->write_quad(a, a);
+    }
+
+    rnd     = (vluint64_t)88172645463325252ULL;
+    chk_sum = (vluint64_t)0;
+
+    beg = clock();
+
+    for (vluint64_t i = 0; i < num; i++)
+    {
+        // xorshift64 : random quad word address
+        rnd ^= rnd << 13;
+        rnd ^= rnd >> 7;
+        rnd ^= rnd << 17;
+        chk_sum += sdr->read_quad(rnd & (size - 8));
+    }
+
+    end  = clock();
+    secs = (double)(end - beg) / CLOCKS_PER_SEC;
+
+    printf("Random reads : %llu over %llu MB\n",
+           (unsigned long long)num, (unsigned long long)(size >> 20));
+    printf("Read data checksum : %016llX\n", (unsigned long long)chk_sum);
+    printf("Time per read : %5.2f ns\n", secs * 1e9 / (double)num);
+    printf("Seconds elapsed : %5.3f\n", secs);
+
+    delete sdr;
+
+    exit(0);
+}
@@ -0,0 +1,74 @@
+// Copyright 2013-2022 Frederic Requin
+//
+// License: BSD
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions 
+// are met:
+//   - Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//   - Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer 
+//     in the documentation and/or other materials provided with the 
+//     distribution.
+//   - Neither the name of the author nor the names of its contributors 
+//     may be used to endorse or promote products derived from this 
+//     software without specific prior written permission.
+//
+// SDRAM binary log format:
+// ------------------------
+//  - One header followed by fixed-size records, in host byte order
+//  - Written by the SDRAM model (open_bin_log), read by "sdram_logdec"
+//  - Does not depend on Verilator, to be included by offline tools
+
+#ifndef _SDRAM_LOG_H_
+#define _SDRAM_LOG_H_
+
+#include <stdint.h>
+
+#define SDRAM_LOG_MAGIC   (0x4C524453) // "SDRL"
+#define SDRAM_LOG_VERSION (2)        // 2 : 64-bit addresses
+
+// Record types (0 - 6 : SDRAM commands, as sampled on the pins)
+#define SDRAM_LOG_LMR     (0)          // addr : mode register value
+#define SDRAM_LOG_REF     (1)
+#define SDRAM_LOG_PRE     (2)
+#define SDRAM_LOG_ACT     (3)          // addr : row address
+#define SDRAM_LOG_WR      (4)          // addr : column address
+#define SDRAM_LOG_RD      (5)          // addr : column address
+#define SDRAM_LOG_BST     (6)
+#define SDRAM_LOG_RD_BURST (8)         // addr : byte address (burst start)
+#define SDRAM_LOG_WR_BURST (9)         // addr : byte address (burst start)
+#define SDRAM_LOG_RD_BEAT (10)         // addr : array index, data, dqm
+#define SDRAM_LOG_WR_BEAT (11)         // addr : array index, data, dqm
+
+// Record flags
+#define SDRAM_LOG_A10     (0x01)       // A[10] : auto-precharge or all banks
+#define SDRAM_LOG_LAST    (0x02)       // Last beat of a burst
+
+typedef struct
+{
+    uint32_t magic;     // SDRAM_LOG_MAGIC
+    uint16_t version;   // SDRAM_LOG_VERSION
+    uint16_t rec_size;  // sizeof(sdram_log_rec_t)
+    uint8_t  bus_log2;  // Data bus width (log2(bytes))
+    uint8_t  num_banks; // Number of banks
+    uint8_t  bit_rows;  // Number of rows (log2)
+    uint8_t  bit_cols;  // Number of columns (log2)
+    uint8_t  mem_flags; // SDRAM flags (FLAG_xxx)
+    uint8_t  rsvd[3];
+} sdram_log_hdr_t;
+
+typedef struct
+{
+    uint64_t ts;        // Timestamp (ps)
+    uint64_t data;      // DQ bus (beats only)
+    uint64_t addr;      // Address (see record types)
+    uint8_t  type;      // SDRAM_LOG_xxx
+    uint8_t  bank;      // Bank number
+    uint8_t  dqm;       // DQM pins (beats only)
+    uint8_t  flags;     // SDRAM_LOG_A10, SDRAM_LOG_LAST
+    uint8_t  rsvd[4];
+} sdram_log_rec_t;
+
+#endif /* _SDRAM_LOG_H_ */
@@ -0,0 +1,302 @@
+// Copyright 2013-2022 Frederic Requin
+//
+// License: BSD
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//   - Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//   - Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer
+//     in the documentation and/or other materials provided with the
+//     distribution.
+//   - Neither the name of the author nor the names of its contributors
+//     may be used to endorse or promote products derived from this
+//     software without specific prior written permission.
+//
+// SDRAM binary log decoder:
+// -------------------------
+//  - Converts a binary log (SDRAM::open_bin_log) to the SDRAM text log format
+//  - Filters : bank, byte address range (bursts) and time window
+//  - Standalone : g++ -O2 -o sdram_logdec sdram_logdec.cpp
+//
+// Usage : sdram_logdec [-b bank] [-a lo:hi] [-t t0:t1] log.bin [log.txt]
+//
+
+#include "sdram_log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define REC_BUF_LEN (16384)
+
+// Filters
+static int      f_bank   = -1;
+static uint64_t f_addr_lo = 0;
+static uint64_t f_addr_hi = ~0ULL;
+static bool     f_addr_on = false;
+static uint64_t f_ts_lo   = 0;
+static uint64_t f_ts_hi   = ~0ULL;
+
+// Commands text (written at the end of the cycle, like the SDRAM model)
+static char     cmd_buf[4096];
+static int      cmd_size = 0;
+
+static void usage(void)
+{
+    printf("Usage : sdram_logdec [-b bank] [-a lo:hi] [-t t0:t1] log.bin [log.txt]\n");
+    printf("  -b bank  : only this bank (and the commands for all banks)\n");
+    printf("  -a lo:hi : only the bursts starting in [lo, hi[ (byte address)\n");
+    printf("  -t t0:t1 : only the records in [t0, t1[ (ps)\n");
+    exit(1);
+}
+
+static void parse_range(const char *arg, uint64_t &lo, uint64_t &hi)
+{
+    const char *sep = strchr(arg, ':');
+
+    if (!sep) usage();
+    lo = strtoull(arg, NULL, 0);
+    hi = (sep[1]) ? strtoull(sep + 1, NULL, 0) : ~0ULL;
+}
+
+// Mode register, as described by the SDRAM model
+static void decode_lmr(const sdram_log_hdr_t &hdr, const sdram_log_rec_t &rec)
+{
+    int bst_len_rd;
+
+    cmd_size += sprintf(cmd_buf + cmd_size, "%15llu ps : Load Std Mode Register\n", (unsigned long long)rec.ts);
+
+    // CAS latency
+    switch ((rec.addr >> 4) & 7)
+    {
+        case 2  : cmd_size += sprintf(cmd_buf + cmd_size, "                     CAS latency        = 2 cycles\n"); break;
+        case 3  : cmd_size += sprintf(cmd_buf + cmd_size, "                     CAS latency        = 3 cycles\n"); break;
+        default : cmd_size += sprintf(cmd_buf + cmd_size, "                     CAS latency        = ???\n");
+    }
+
+    // Burst length
+    switch (rec.addr & 0xF)
+    {
+        case 0x8 :
+        case 0x0 :
+            cmd_size += sprintf(cmd_buf + cmd_size, "                     Read burst length  = 1 word\n");
+            bst_len_rd = 1;
+            break;
+        case 0x9 :
+        case 0x1 :
+            cmd_size += sprintf(cmd_buf + cmd_size, "                     Read burst length  = 2 words\n");
+            bst_len_rd = 2;
+            break;
+        case 0xA :
+        case 0x2 :
+            cmd_size += sprintf(cmd_buf + cmd_size, "                     Read burst length  = 4 words\n");
+            bst_len_rd = 4;
+            break;
+        case 0xB :
+        case 0x3 :
+            cmd_size += sprintf(cmd_buf + cmd_size, "                     Read burst length  = 8 words\n");
+            bst_len_rd = 8;
+            break;
+        case 0x7 :
+            cmd_size += sprintf(cmd_buf + cmd_size, "                     Read burst length  = continuous\n");
+            bst_len_rd = 1 << hdr.bit_cols;
+            break;
+        default :
+            cmd_size += sprintf(cmd_buf + cmd_size, "                     Read burst length  = ???\n");
+            bst_len_rd = 0;
+    }
+
+    // Burst type
+    if (rec.addr & 8)
+        cmd_size += sprintf(cmd_buf + cmd_size, "                     Burst type         = interleaved\n");
+    else
+        cmd_size += sprintf(cmd_buf + cmd_size, "                     Burst type         = sequential\n");
+
+    // Write burst
+    if (rec.addr & 0x0200)
+        cmd_size += sprintf(cmd_buf + cmd_size, "                     Write burst length = 1\n");
+    else if (!bst_len_rd)
+        cmd_size += sprintf(cmd_buf + cmd_size, "                     Write burst length = ???\n");
+    else if (bst_len_rd <= 8)
+        cmd_size += sprintf(cmd_buf + cmd_size, "                     Write burst length = %d word(s)\n", bst_len_rd);
+    else
+        cmd_size += sprintf(cmd_buf + cmd_size, "                     Write burst length = continuous\n");
+}
+
+int main(int argc, char **argv)
+{
+    const char      *in_name  = NULL;
+    const char      *out_name = NULL;
+    FILE            *fh_in;
+    FILE            *fh_out;
+    sdram_log_hdr_t  hdr;
+    sdram_log_rec_t *recs;
+    uint64_t         prev_ts  = 0;
+    bool             burst_on = false; // Current burst is displayed
+    size_t           len;
+
+    // Command line
+    for (int i = 1; i < argc; i++)
+    {
+        if ((!strcmp(argv[i], "-b")) && (i + 1 < argc))
+        {
+            f_bank = atoi(argv[++i]);
+        }
+        else if ((!strcmp(argv[i], "-a")) && (i + 1 < argc))
+        {
+            parse_range(argv[++i], f_addr_lo, f_addr_hi);
+            f_addr_on = true;
+        }
+        else if ((!strcmp(argv[i], "-t")) && (i + 1 < argc))
+        {
+            parse_range(argv[++i], f_ts_lo, f_ts_hi);
+        }
+        else if (argv[i][0] == '-')
+        {
+            usage();
+        }
+        else if (!in_name)
+        {
+            in_name = argv[i];
+        }
+        else
+        {
+            out_name = argv[i];
+        }
+    }
+    if (!in_name) usage();
+
+    fh_in = fopen(in_name, "rb");
+    if (!fh_in)
+    {
+        printf("Cannot open binary log file \"%s\" !!\n", in_name);
+        return 1;
+    }
+    if ((fread((void *)&hdr, sizeof(hdr), 1, fh_in) != 1) ||
+        (hdr.magic != SDRAM_LOG_MAGIC) || (hdr.version != SDRAM_LOG_VERSION) ||
+        (hdr.rec_size != sizeof(sdram_log_rec_t)))
+    {
+        printf("\"%s\" is not an SDRAM binary log file !!\n", in_name);
+        fclose(fh_in);
+        return 1;
+    }
+    fh_out = (out_name) ? fopen(out_name, "w") : stdout;
+    if (!fh_out)
+    {
+        printf("Cannot create text log file \"%s\" !!\n", out_name);
+        fclose(fh_in);
+        return 1;
+    }
+
+    recs = new sdram_log_rec_t[REC_BUF_LEN];
+    while ((len = fread((void *)recs, sizeof(sdram_log_rec_t), REC_BUF_LEN, fh_in)) > 0)
+    {
+        for (size_t i = 0; i < len; i++)
+        {
+            const sdram_log_rec_t &rec = recs[i];
+            bool  in_time = (rec.ts >= f_ts_lo) && (rec.ts < f_ts_hi);
+            bool  in_bank = (f_bank < 0) || (rec.bank == (uint8_t)f_bank);
+
+            // New cycle : commands of the previous one
+            if ((rec.ts != prev_ts) && (cmd_size))
+            {
+                fputs(cmd_buf, fh_out);
+                cmd_size = 0;
+            }
+            prev_ts = rec.ts;
+
+            switch (rec.type)
+            {
+                // Commands
+                case SDRAM_LOG_LMR :
+                case SDRAM_LOG_REF :
+                case SDRAM_LOG_PRE :
+                case SDRAM_LOG_ACT :
+                case SDRAM_LOG_WR  :
+                case SDRAM_LOG_RD  :
+                case SDRAM_LOG_BST :
+                {
+                    bool all_banks = (rec.type == SDRAM_LOG_LMR) || (rec.type == SDRAM_LOG_REF) ||
+                                     ((rec.type == SDRAM_LOG_PRE) && (rec.flags & SDRAM_LOG_A10));
+
+                    if ((!in_time) || (f_addr_on) || ((!in_bank) && (!all_banks))) break;
+
+                    switch (rec.type)
+                    {
+                        case SDRAM_LOG_LMR :
+                            decode_lmr(hdr, rec);
+                            break;
+                        case SDRAM_LOG_REF :
+                            cmd_size += sprintf(cmd_buf + cmd_size, "%15llu ps : Auto Refresh\n",
+                                                (unsigned long long)rec.ts);
+                            break;
+                        case SDRAM_LOG_PRE :
+                            if (rec.flags & SDRAM_LOG_A10)
+                                cmd_size += sprintf(cmd_buf + cmd_size, "%15llu ps : Precharge all banks\n",
+                                                    (unsigned long long)rec.ts);
+                            else
+                                cmd_size += sprintf(cmd_buf + cmd_size, "%15llu ps : Precharge bank #%d\n",
+                                                    (unsigned long long)rec.ts, rec.bank);
+                            break;
+                        case SDRAM_LOG_ACT :
+                            cmd_size += sprintf(cmd_buf + cmd_size, "%15llu ps : Activate bank #%d, row #%d\n",
+                                                (unsigned long long)rec.ts, rec.bank, (int)rec.addr);
+                            break;
+                        case SDRAM_LOG_WR :
+                        case SDRAM_LOG_RD :
+                            cmd_size += sprintf(cmd_buf + cmd_size, "%15llu ps : %s%s bank #%d, col #%d\n",
+                                                (unsigned long long)rec.ts,
+                                                (rec.type == SDRAM_LOG_WR) ? "Write" : "Read",
+                                                (rec.flags & SDRAM_LOG_A10) ? "(AP)" : "", rec.bank,
+                                                (int)(rec.addr & ((1U << hdr.bit_cols) - 1)));
+                            break;
+                        default :
+                            cmd_size += sprintf(cmd_buf + cmd_size, "%15llu ps : Burst Stop bank #%d\n",
+                                                (unsigned long long)rec.ts, rec.bank);
+                    }
+                    break;
+                }
+                // Burst start
+                case SDRAM_LOG_RD_BURST :
+                case SDRAM_LOG_WR_BURST :
+                {
+                    burst_on = in_time && in_bank &&
+                               ((!f_addr_on) || ((rec.addr >= f_addr_lo) && (rec.addr < f_addr_hi)));
+                    if (burst_on)
+                    {
+                        fprintf(fh_out, "   %s @ 0x%08llX :",
+                                (rec.type == SDRAM_LOG_WR_BURST) ? "Wr" : "Rd", (unsigned long long)rec.addr);
+                    }
+                    break;
+                }
+                // Burst data
+                case SDRAM_LOG_RD_BEAT :
+                case SDRAM_LOG_WR_BEAT :
+                {
+                    if (!burst_on) break;
+
+                    fputc(' ', fh_out);
+                    for (int l = (1 << hdr.bus_log2) - 1; l >= 0; l--)
+                    {
+                        if ((rec.dqm >> l) & 1)
+                            fputs("XX", fh_out);
+                        else
+                            fprintf(fh_out, "%02X", (unsigned)(rec.data >> (l * 8)) & 0xFF);
+                    }
+                    if (rec.flags & SDRAM_LOG_LAST) fputs("\n", fh_out);
+                    break;
+                }
+                default : ;
+            }
+        }
+    }
+    if (cmd_size) fputs(cmd_buf, fh_out);
+
+    delete[] recs;
+    fclose(fh_in);
+    if (fh_out != stdout) fclose(fh_out);
+
+    return 0;
+}
@@ -30,20 +30,82 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#ifdef __SSE4_2__
+#include <nmmintrin.h>
+#endif
+
+// Frame store alignment (cache line)
+#define FRM_ALIGN (64)
+#define BMP_HDR_SIZE (sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER))
+
+// Frame store allocation : one cache line for the headers + pixels
+static vluint8_t *frame_alloc(int size)
+{
+    return (vluint8_t *)aligned_alloc(FRM_ALIGN, (FRM_ALIGN + size + FRM_ALIGN - 1) & ~(FRM_ALIGN - 1));
+}
+
+// CRC32C (Castagnoli) table for the software path
+static vluint32_t crc32c_table[256];
+static bool       crc32c_init = false;
+
+static void crc32c_make_table(void)
+{
+    for (int i = 0; i < 256; i++)
+    {
+        vluint32_t crc = (vluint32_t)i;
+        
+        for (int j = 0; j < 8; j++)
+        {
+            crc = (crc >> 1) ^ ((crc & 1) ? 0x82F63B78 : 0);
+        }
+        crc32c_table[i] = crc;
+    }
+    crc32c_init = true;
+}
+
+// CRC32C update (SSE4.2 instruction when available)
+static vluint32_t crc32c_update(vluint32_t crc, const vluint8_t *buf, int len)
+{
+#ifdef __SSE4_2__
+    vluint64_t crc64 = (vluint64_t)crc;
+    
+    while (len >= 8)
+    {
+        vluint64_t val;
+        
+        memcpy(&val, buf, 8);
+        crc64 = _mm_crc32_u64(crc64, val);
+        buf += 8;
+        len -= 8;
+    }
+    crc = (vluint32_t)crc64;
+    while (len--)
+    {
+        crc = _mm_crc32_u8(crc, *buf++);
+    }
+#else
+    while (len--)
+    {
+        crc = (crc >> 8) ^ crc32c_table[(crc ^ *buf++) & 0xFF];
+    }
+#endif
+    return crc;
+}
 
 // Constructor
 VideoOut::VideoOut(vluint8_t debug, vluint8_t depth, vluint8_t polarity, vluint16_t hoffset, vluint16_t hactive, vluint16_t voffset, vluint16_t vactive, const char *file)
 {
     // color depth
-    if (depth <= 8)
+    if ((depth >= 1) && (depth <= 8))
     {
-        bit_mask  = (1 << depth) - 1;
-        bit_shift = (int)(8 - depth);
+        bit_depth = (int)depth;
     }
     else
     {
-        bit_mask  = (vluint8_t)0xFF;
-        bit_shift = (int)0;
+        bit_depth = (int)8;
     }
     // synchros polarities
     hs_pol              = (polarity & HS_POS_POL) ? (vluint8_t)1 : (vluint8_t)2;
@@ -56,11 +118,21 @@ VideoOut::VideoOut(vluint8_t debug, vluint8_t depth, vluint8_t polarity, vluint1
     // debug mode
     dbg_on              = (debug) ? true : false;
     cycle_ctr           = (vluint64_t)0;
+    // capture kernels
+    eval_rgb444_hv      = select_eval<SYNC_HV, FMT_RGB444>(bit_depth, dbg_on);
+    eval_rgb444_de      = select_eval<SYNC_DE, FMT_RGB444>(bit_depth, dbg_on);
+    eval_yuv444_hv      = select_eval<SYNC_HV, FMT_YUV444>(bit_depth, dbg_on);
+    eval_yuv444_de      = select_eval<SYNC_DE, FMT_YUV444>(bit_depth, dbg_on);
+    eval_yuv422_hv      = select_eval<SYNC_HV, FMT_YUV422>(bit_depth, dbg_on);
+    eval_yuv422_de      = select_eval<SYNC_DE, FMT_YUV422>(bit_depth, dbg_on);
+    eval_yuv420_de      = select_eval<SYNC_DE, FMT_YUV420>(bit_depth, dbg_on);
+    // BMP rows are 4-byte aligned
+    row_size            = ((int)hactive * 3 + 3) & ~3;
     // initialize BMP headers
     bih.biSize          = sizeof(BITMAPINFOHEADER);
     bih.biWidth         = (vluint32_t)hactive;
     bih.biHeight        = (vluint32_t)vactive;
-    bih.biSizeImage     = (vluint32_t)hactive * vactive * 3;
+    bih.biSizeImage     = (vluint32_t)row_size * vactive;
     bih.biPlanes        = (vluint16_t)1;
     bih.biBitCount      = (vluint16_t)24;
     bih.biCompression   = 0; // BI_RGB
@@ -77,14 +149,23 @@ VideoOut::VideoOut(vluint8_t debug, vluint8_t depth, vluint8_t polarity, vluint1
     bfh.bfReserved2     = (vluint16_t)0;
     bfh.bfOffBits       = sizeof(BITMAPFILEHEADER)
                         + sizeof(BITMAPINFOHEADER);
-    // allocate pixels
+    // allocate the frame store : BMP headers just before the aligned pixels
+    frm_buf = frame_alloc(bih.biSizeImage);
+    frm_hdr = frm_buf + FRM_ALIGN - BMP_HDR_SIZE;
+    memcpy(frm_hdr, &bfh, sizeof(BITMAPFILEHEADER));
+    memcpy(frm_hdr + sizeof(BITMAPFILEHEADER), &bih, sizeof(BITMAPINFOHEADER));
+    memset(frm_buf + FRM_ALIGN, 0, bih.biSizeImage);
     img = new vluint8_t *[vactive];
-    for (int i = 0; i < vactive; i++)
-    {
-        img[i] = new vluint8_t[hactive * 3];
-    }
-    row_e = img[0];
-    row_o = img[1];
+    set_rows(frm_buf + FRM_ALIGN, vactive);
+    // no mmap'd file
+    map_ptr     = (vluint8_t *)NULL;
+    map_name[0] = (char)0;
+    map_on      = false;
+    // no shared memory
+    shm_ptr     = (video_shm_t *)NULL;
+    shm_back    = (vluint8_t *)NULL;
+    shm_size    = 0;
+    shm_name[0] = (char)0;
     // copy the filename
     strncpy(filename, file, 255);
     // internal variables cleared
@@ -99,6 +180,21 @@ VideoOut::VideoOut(vluint8_t debug, vluint8_t depth, vluint8_t polarity, vluint1
     prev_vs     = (vluint8_t)0;
     first_vs    = false;
     dump_ctr    = 0;
+    // frame hashing disabled
+    hash_mode   = 0;
+    line_crc    = (vluint32_t)0xFFFFFFFF;
+    curr_crc    = (vluint32_t)0;
+    prev_crc    = (vluint32_t)0;
+    crc_errors  = 0;
+    crc_checks  = 0;
+    hash_fh     = (FILE *)NULL;
+    if (!crc32c_init) crc32c_make_table();
+    // no call-backs
+    line_cb      = (line_cback_t)NULL;
+    frame_beg_cb = (frame_cback_t)NULL;
+    frame_end_cb = (frame_cback_t)NULL;
+    line_ctx     = NULL;
+    frame_ctx    = NULL;
     // initialize YUV to RGB tables
     for (int i = 0; i < 256; i++)
     {
@@ -119,17 +215,25 @@ VideoOut::VideoOut(vluint8_t debug, vluint8_t depth, vluint8_t polarity, vluint1
 // Destructor
 VideoOut::~VideoOut()
 {
+    if (hash_fh)
+    {
+        fclose(hash_fh);
+    }
+    if (golden_crc.size())
+    {
+        printf(" %d frame(s) checked, %d CRC mismatch(es)\n", crc_checks, crc_errors);
+    }
     for (int i = 0; i < 2; i++)
     {
         delete [] y_buf[i];
         delete [] y_buf[i+2];
         delete [] c_buf[i];
     }
-    for (int i = 0; i < ver_size; i++)
-    {
-        delete img[i];
-    }
-    delete img;
+    // incomplete frame is not kept
+    if (map_ptr) unmap_frame(false);
+    close_shm();
+    free(frm_buf);
+    delete [] img;
 }
 
 // Cycle evaluate : RGB444 with synchros
@@ -146,64 +250,7 @@ bool VideoOut::eval_RGB444_HV
     vluint8_t  blue
 )
 {
-    bool ret = false;
-    
-    // Rising edge on clock
-    if (clk && !prev_clk)
-    {
-        // Grab active area
-        if ((vcount >= 0) && (vcount < ver_size) &&
-            (hcount >= 0) && (hcount < hor_size) &&
-            (first_vs))
-        {
-            *row_e++ = (blue  & bit_mask) << bit_shift;
-            *row_e++ = (green & bit_mask) << bit_shift;
-            *row_e++ = (red   & bit_mask) << bit_shift;
-            hcount++;
-        }
-        else
-        {
-            // Rising edge on VS
-            if ((vs | prev_vs) == vs_pol)
-            {
-                if (dbg_on) printf(" Rising edge on VS @ cycle #%llu\n", cycle_ctr);
-                vcount = -ver_offs;
-                hcount = -hor_offs;
-                row_e  = img[0];
-                
-                if (first_vs)
-                {
-                    write_bmp();
-                    ret = true;
-                }
-                first_vs = true;
-            }
-            
-            // Rising edge on HS
-            if ((hs | prev_hs) == hs_pol)
-            {
-                if (dbg_on) printf(" Rising edge on HS @ cycle #%llu (vcount = %d)\n", cycle_ctr, vcount);
-                if (hcount >= 0)
-                {
-                    vcount++;
-                    if ((vcount >= 0) && (vcount < ver_size)) row_e = img[vcount];
-                }
-                hcount = -hor_offs;
-            }
-            else
-            {
-                hcount++;
-            }
-            
-            // Delayed HS and VS
-            prev_vs = vs << 1;
-            prev_hs = hs << 1;
-        }
-        if (dbg_on) cycle_ctr++;
-    }
-    prev_clk = clk;
-    
-    return ret;
+    return (this->*eval_rgb444_hv)(clk, vs, hs, red, green, blue);
 }
 
 // Cycle evaluate : RGB444 with data enable
@@ -219,41 +266,7 @@ bool VideoOut::eval_RGB444_DE
     vluint8_t  blue
 )
 {
-    bool ret = false;
-    
-    // Rising edge on clock
-    if (clk && !prev_clk)
-    {
-        // Grab active area
-        if (de)
-        {
-            *row_e++ = (blue  & bit_mask) << bit_shift;
-            *row_e++ = (green & bit_mask) << bit_shift;
-            *row_e++ = (red   & bit_mask) << bit_shift;
-            
-            hcount++;
-            if (hcount == hor_size)
-            {
-                if (dbg_on) printf(" Rising edge on HS @ cycle #%llu (vcount = %d)\n", cycle_ctr, vcount);
-                hcount = 0;
-                
-                vcount++;
-                if (vcount == ver_size)
-                {
-                    if (dbg_on) printf(" Rising edge on VS @ cycle #%llu\n", cycle_ctr);
-                    vcount = 0;
-                    
-                    write_bmp();
-                    ret = true;
-                }
-                row_e = img[vcount];
-            }
-        }
-        if (dbg_on) cycle_ctr++;
-    }
-    prev_clk = clk;
-    
-    return ret;
+    return (this->*eval_rgb444_de)(clk, de, (vluint8_t)0, red, green, blue);
 }
 
 // Cycle evaluate : YUV444 with synchros
@@ -270,63 +283,7 @@ bool VideoOut::eval_YUV444_HV
     vluint8_t  cr
 )
 {
-    bool ret = false;
-    
-    // Rising edge on clock
-    if (clk && !prev_clk)
-    {
-        // Grab active area
-        if ((vcount >= 0) && (vcount < ver_size) &&
-            (hcount >= 0) && (hcount < hor_size) &&
-            (first_vs))
-        {
-            yuv2rgb(luma, cb, cr, row_e);
-            row_e += 3;
-            hcount++;
-        }
-        else
-        {
-            // Rising edge on VS
-            if ((vs | prev_vs) == vs_pol)
-            {
-                if (dbg_on) printf(" Rising edge on VS @ cycle #%llu\n", cycle_ctr);
-                vcount = -ver_offs;
-                hcount = -hor_offs;
-                row_e  = img[0];
-                
-                if (first_vs)
-                {
-                    write_bmp();
-                    ret = true;
-                }
-                first_vs = true;
-            }
-            
-            // Rising edge on HS
-            if ((hs | prev_hs) == hs_pol)
-            {
-                if (dbg_on) printf(" Rising edge on HS @ cycle #%llu (vcount = %d)\n", cycle_ctr, vcount);
-                if (hcount >= 0)
-                {
-                    vcount++;
-                    if ((vcount >= 0) && (vcount < ver_size)) row_e = img[vcount];
-                }
-                hcount = -hor_offs;
-            }
-            else
-            {
-                hcount++;
-            }
-            
-            // Delayed HS and VS
-            prev_vs = vs << 1;
-            prev_hs = hs << 1;
-        }
-        if (dbg_on) cycle_ctr++;
-    }
-    prev_clk = clk;
-    
-    return ret;
+    return (this->*eval_yuv444_hv)(clk, vs, hs, luma, cb, cr);
 }
 
 // Cycle evaluate : YUV444 with data enable
@@ -342,40 +299,7 @@ bool VideoOut::eval_YUV444_DE
     vluint8_t  cr
 )
 {
-    bool ret = false;
-    
-    // Rising edge on clock
-    if (clk && !prev_clk)
-    {
-        // Grab active area
-        if (de)
-        {
-            yuv2rgb(luma, cb, cr, row_e);
-            row_e += 3;
-            
-            hcount++;
-            if (hcount == hor_size)
-            {
-                if (dbg_on) printf(" Rising edge on HS @ cycle #%llu (vcount = %d)\n", cycle_ctr, vcount);
-                hcount = 0;
-                
-                vcount++;
-                if (vcount == ver_size)
-                {
-                    if (dbg_on) printf(" Rising edge on VS @ cycle #%llu\n", cycle_ctr);
-                    vcount = 0;
-                    
-                    write_bmp();
-                    ret = true;
-                }
-                row_e = img[vcount];
-            }
-        }
-        if (dbg_on) cycle_ctr++;
-    }
-    prev_clk = clk;
-    
-    return ret;
+    return (this->*eval_yuv444_de)(clk, de, (vluint8_t)0, luma, cb, cr);
 }
 
 // Cycle evaluate : YUV422 with synchros
@@ -391,83 +315,123 @@ bool VideoOut::eval_YUV422_HV
     vluint8_t  chroma
 )
 {
-    bool ret = false;
+    return (this->*eval_yuv422_hv)(clk, vs, hs, luma, chroma, (vluint8_t)0);
+}
+
+// Cycle evaluate : YUV422 with data enable
+bool VideoOut::eval_YUV422_DE
+(
+    // Clock
+    vluint8_t  clk,
+    // Data enable
+    vluint8_t  de,
+    // YUV colors
+    vluint8_t  luma,
+    vluint8_t  chroma
+)
+{
+    return (this->*eval_yuv422_de)(clk, de, (vluint8_t)0, luma, chroma, (vluint8_t)0);
+}
+
+// Cycle evaluate : YUV420 with data enables
+bool VideoOut::eval_YUV420_DE
+(
+    // Clock
+    vluint8_t  clk,
+    // Data enables
+    vluint8_t  de_y,
+    vluint8_t  de_c,
+    // YUV colors
+    vluint8_t  luma,
+    vluint8_t  chroma
+)
+{
+    return (this->*eval_yuv420_de)(clk, de_y, de_c, luma, chroma, (vluint8_t)0);
+}
+
+// Capture kernel selection : color depth
+template <int SYNC, int FMT, bool DBG>
+VideoOut::eval_t VideoOut::select_depth(int depth)
+{
+    switch (depth)
+    {
+        case 1  : return &VideoOut::eval_core<SYNC, FMT, 1, DBG>;
+        case 2  : return &VideoOut::eval_core<SYNC, FMT, 2, DBG>;
+        case 3  : return &VideoOut::eval_core<SYNC, FMT, 3, DBG>;
+        case 4  : return &VideoOut::eval_core<SYNC, FMT, 4, DBG>;
+        case 5  : return &VideoOut::eval_core<SYNC, FMT, 5, DBG>;
+        case 6  : return &VideoOut::eval_core<SYNC, FMT, 6, DBG>;
+        case 7  : return &VideoOut::eval_core<SYNC, FMT, 7, DBG>;
+        default : return &VideoOut::eval_core<SYNC, FMT, 8, DBG>;
+    }
+}
+
+// Capture kernel selection : debug mode
+template <int SYNC, int FMT>
+VideoOut::eval_t VideoOut::select_eval(int depth, bool debug)
+{
+    return (debug) ? select_depth<SYNC, FMT, true>(depth)
+                   : select_depth<SYNC, FMT, false>(depth);
+}
+
+// Store one pixel (RGB444, YUV444 and YUV422)
+template <int FMT, int DEPTH>
+inline void VideoOut::put_pixel
+(
+    vluint8_t  comp0,
+    vluint8_t  comp1,
+    vluint8_t  comp2
+)
+{
+    const vluint8_t bit_mask  = (vluint8_t)((1 << DEPTH) - 1);
+    const int       bit_shift = 8 - DEPTH;
     
-    // Rising edge on clock
-    if (clk && !prev_clk)
+    if (FMT == FMT_RGB444)
+    {
+        // comp0 = red, comp1 = green, comp2 = blue
+        row_e[0] = (comp2 & bit_mask) << bit_shift;
+        row_e[1] = (comp1 & bit_mask) << bit_shift;
+        row_e[2] = (comp0 & bit_mask) << bit_shift;
+        row_e   += 3;
+    }
+    else if (FMT == FMT_YUV444)
+    {
+        // comp0 = luma, comp1 = cb, comp2 = cr
+        yuv2rgb<DEPTH>(comp0, comp1, comp2, row_e);
+        row_e += 3;
+    }
+    else
     {
-        // Grab active area
-        if ((vcount >= 0) && (vcount < ver_size) &&
-            (hcount >= 0) && (hcount < hor_size) &&
-            (first_vs))
+        // comp0 = luma, comp1 = chroma
+        if (hcount & 1)
         {
-            if (hcount & 1)
-            {
-                // Odd pixel
-                yuv2rgb(y0, u0, chroma, row_e);
-                row_e += 3;
-                yuv2rgb(luma, u0, chroma, row_e);
-                row_e += 3;
-            }
-            else
-            {
-                // Even pixel
-                y0 = luma;
-                u0 = chroma;
-            }
-            hcount++;
+            // Odd pixel
+            yuv2rgb<DEPTH>(y0, u0, comp1, row_e);
+            yuv2rgb<DEPTH>(comp0, u0, comp1, row_e + 3);
+            row_e += 6;
         }
         else
         {
-            // Rising edge on VS
-            if ((vs == vs_pol) && (prev_vs != vs_pol))
-            {
-                if (dbg_on) printf(" Rising edge on VS @ cycle #%llu\n", cycle_ctr);
-                vcount = -ver_offs;
-                hcount = -hor_offs;
-                row_e  = img[0];
-                
-                if (first_vs)
-                {
-                    write_bmp();
-                    ret = true;
-                }
-                first_vs = true;
-            }
-            
-            // Rising edge on HS
-            if ((hs == hs_pol) && (prev_hs != hs_pol))
-            {
-                if (dbg_on) printf(" Rising edge on HS @ cycle #%llu (vcount = %d)\n", cycle_ctr, vcount);
-                if (hcount > 4) row_e = img[++vcount];
-                hcount = -hor_offs;
-            }
-            else
-            {
-                hcount++;
-            }
-            
-            // Delayed HS and VS
-            prev_vs = vs << 1;
-            prev_hs = hs << 1;
+            // Even pixel
+            y0 = comp0;
+            u0 = comp1;
         }
-        if (dbg_on) cycle_ctr++;
     }
-    prev_clk = clk;
-    
-    return ret;
 }
 
-// Cycle evaluate : YUV422 with data enable
-bool VideoOut::eval_YUV422_DE
+// Capture kernel : one instance per synchro mode, colorspace, depth and debug
+template <int SYNC, int FMT, int DEPTH, bool DBG>
+bool VideoOut::eval_core
 (
     // Clock
     vluint8_t  clk,
-    // Data enable
-    vluint8_t  de,
-    // YUV colors
-    vluint8_t  luma,
-    vluint8_t  chroma
+    // Synchros : (vs, hs), (de, -) or (de_y, de_c)
+    vluint8_t  sync0,
+    vluint8_t  sync1,
+    // Color components
+    vluint8_t  comp0,
+    vluint8_t  comp1,
+    vluint8_t  comp2
 )
 {
     bool ret = false;
@@ -475,54 +439,102 @@ bool VideoOut::eval_YUV422_DE
     // Rising edge on clock
     if (clk && !prev_clk)
     {
-        // Grab active area
-        if (de)
+        if (FMT == FMT_YUV420)
+        {
+            ret = grab_yuv420<DEPTH, DBG>(sync0, sync1, comp0, comp1);
+        }
+        else if (SYNC == SYNC_HV)
         {
-            if (hcount & 1)
+            // Grab active area
+            if ((vcount >= 0) && (vcount < ver_size) &&
+                (hcount >= 0) && (hcount < hor_size) &&
+                (first_vs))
             {
-                // Odd pixel
-                yuv2rgb(y0, u0, chroma, row_e);
-                row_e += 3;
-                yuv2rgb(luma, u0, chroma, row_e);
-                row_e += 3;
+                // Start of line 0
+                if ((hcount == 0) && (vcount == 0) && (frame_beg_cb)) (*frame_beg_cb)(frame_ctx, dump_ctr);
+                put_pixel<FMT, DEPTH>(comp0, comp1, comp2);
+                hcount++;
+                if (hcount == hor_size) line_done(vcount);
             }
             else
             {
-                // Even pixel
-                y0 = luma;
-                u0 = chroma;
+                // Rising edge on VS
+                if ((sync0 | prev_vs) == vs_pol)
+                {
+                    if (DBG) printf(" Rising edge on VS @ cycle #%llu\n", cycle_ctr);
+                    vcount = -ver_offs;
+                    hcount = -hor_offs;
+                    
+                    if (first_vs)
+                    {
+                        frame_done();
+                        ret = true;
+                    }
+                    first_vs = true;
+                    row_e = img[0];
+                }
+                
+                // Rising edge on HS
+                if ((sync1 | prev_hs) == hs_pol)
+                {
+                    if (DBG) printf(" Rising edge on HS @ cycle #%llu (vcount = %d)\n", cycle_ctr, vcount);
+                    if (hcount >= 0)
+                    {
+                        vcount++;
+                        if ((vcount >= 0) && (vcount < ver_size)) row_e = img[vcount];
+                    }
+                    hcount = -hor_offs;
+                }
+                else
+                {
+                    hcount++;
+                }
+                
+                // Delayed HS and VS
+                prev_vs = sync0 << 1;
+                prev_hs = sync1 << 1;
             }
-            
-            hcount++;
-            if (hcount == hor_size)
+        }
+        else
+        {
+            // Grab active area
+            if (sync0)
             {
-                if (dbg_on) printf(" Rising edge on HS @ cycle #%llu (vcount = %d)\n", cycle_ctr, vcount);
-                hcount = 0;
+                // Start of line 0
+                if ((hcount == 0) && (vcount == 0) && (frame_beg_cb)) (*frame_beg_cb)(frame_ctx, dump_ctr);
+                put_pixel<FMT, DEPTH>(comp0, comp1, comp2);
                 
-                vcount++;
-                if (vcount == ver_size)
+                hcount++;
+                if (hcount == hor_size)
                 {
-                    if (dbg_on) printf(" Rising edge on VS @ cycle #%llu\n", cycle_ctr);
-                    vcount = 0;
+                    if (DBG) printf(" Rising edge on HS @ cycle #%llu (vcount = %d)\n", cycle_ctr, vcount);
+                    line_done(vcount);
+                    hcount = 0;
                     
-                    write_bmp();
-                    ret = true;
+                    vcount++;
+                    if (vcount == ver_size)
+                    {
+                        if (DBG) printf(" Rising edge on VS @ cycle #%llu\n", cycle_ctr);
+                        vcount = 0;
+                        
+                        frame_done();
+                        ret = true;
+                    }
+                    row_e = img[vcount];
                 }
-                row_e = img[vcount];
             }
         }
-        if (dbg_on) cycle_ctr++;
+        if (DBG) cycle_ctr++;
     }
     prev_clk = clk;
     
     return ret;
 }
 
-// Cycle evaluate : YUV420 with data enables
-bool VideoOut::eval_YUV420_DE
+// YUV420 capture (two lines of pixels at a time)
+template <int DEPTH, bool DBG>
+inline bool VideoOut::grab_yuv420
 (
-    // Clock
-    vluint8_t  clk,
     // Data enables
     vluint8_t  de_y,
     vluint8_t  de_c,
@@ -533,80 +545,79 @@ bool VideoOut::eval_YUV420_DE
 {
     bool ret = false;
     
-    // Rising edge on clock
-    if (clk && !prev_clk)
+    // Grab active area
+    if (de_y)
     {
-        // Grab active area
-        if (de_y)
+        y_buf[vcount1 & 3][hcount1] = luma;
+        hcount1 ++;
+        if (hcount1 == hor_size)
         {
-            y_buf[vcount1 & 3][hcount1] = luma;
-            hcount1 ++;
-            if (hcount1 == hor_size)
-            {
-                hcount1 = 0;
-                vcount1 ++;
-            }
+            hcount1 = 0;
+            vcount1 ++;
         }
-        if (de_c)
+    }
+    if (de_c)
+    {
+        c_buf[vcount2 & 1][hcount2] = chroma;
+        hcount2 ++;
+        if (hcount2 == hor_size)
         {
-            c_buf[vcount2 & 1][hcount2] = chroma;
-            hcount2 ++;
-            if (hcount2 == hor_size)
-            {
-                hcount2 = 0;
-                vcount2 ++;
-            }
+            hcount2 = 0;
+            vcount2 ++;
         }
+    }
+    
+    // 2 lines of pixel are ready
+    if (((vcount1 - vcount) >= 2) && ((vcount2 * 2 - vcount) >= 2))
+    {
+        vluint8_t y, u, v;
+        
+        // Lines 0 and 1 are about to be written
+        if ((vcount == 0) && (frame_beg_cb)) (*frame_beg_cb)(frame_ctx, dump_ctr);
         
-        // 2 lines of pixel are ready
-        if (((vcount1 - vcount) >= 2) && ((vcount2 * 2 - vcount) >= 2))
+        // YUV420 to RGB444 conversion
+        for (int i = 0; i < hor_size; i = i + 2)
         {
-            vluint8_t y, u, v;
+            u = c_buf[(vcount2 & 1) ^ 1][i];
+            v = c_buf[(vcount2 & 1) ^ 1][i+1];
             
-            // YUV420 to RGB444 conversion
-            for (int i = 0; i < hor_size; i = i + 2)
-            {
-                u = c_buf[(vcount2 & 1) ^ 1][i];
-                v = c_buf[(vcount2 & 1) ^ 1][i+1];
-                
-                y = y_buf[(vcount1 & 2) ^ 2][i];
-                yuv2rgb(y, u, v, row_e);
-                row_e += 3;
-                
-                y = y_buf[(vcount1 & 2) ^ 2][i+1];
-                yuv2rgb(y, u, v, row_e);
-                row_e += 3;
-                
-                y = y_buf[(vcount1 & 2) ^ 3][i];
-                yuv2rgb(y, u, v, row_o);
-                row_o += 3;
-                
-                y = y_buf[(vcount1 & 2) ^ 3][i+1];
-                yuv2rgb(y, u, v, row_o);
-                row_o += 3;
-            }
+            y = y_buf[(vcount1 & 2) ^ 2][i];
+            yuv2rgb<DEPTH>(y, u, v, row_e);
+            row_e += 3;
             
-            if (dbg_on) printf(" Rising edge on HS @ cycle #%llu (vcount = %d)\n", cycle_ctr, vcount);
+            y = y_buf[(vcount1 & 2) ^ 2][i+1];
+            yuv2rgb<DEPTH>(y, u, v, row_e);
+            row_e += 3;
             
-            vcount += 2;
+            y = y_buf[(vcount1 & 2) ^ 3][i];
+            yuv2rgb<DEPTH>(y, u, v, row_o);
+            row_o += 3;
             
-            if (vcount == ver_size)
-            {
-                if (dbg_on) printf(" Rising edge on VS @ cycle #%llu\n", cycle_ctr);
-                
-                vcount   = 0;
-                vcount1 -= ver_size;
-                vcount2 -= ver_size / 2;
-                
-                write_bmp();
-                ret = true;
-            }
-            row_e = img[vcount];
-            row_o = img[vcount+1];
+            y = y_buf[(vcount1 & 2) ^ 3][i+1];
+            yuv2rgb<DEPTH>(y, u, v, row_o);
+            row_o += 3;
+        }
+        
+        if (DBG) printf(" Rising edge on HS @ cycle #%llu (vcount = %d)\n", cycle_ctr, vcount);
+        line_done(vcount);
+        line_done(vcount + 1);
+        
+        vcount += 2;
+        
+        if (vcount == ver_size)
+        {
+            if (DBG) printf(" Rising edge on VS @ cycle #%llu\n", cycle_ctr);
+            
+            vcount   = 0;
+            vcount1 -= ver_size;
+            vcount2 -= ver_size / 2;
+            
+            frame_done();
+            ret = true;
         }
-        if (dbg_on) cycle_ctr++;
+        row_e = img[vcount];
+        row_o = img[vcount+1];
     }
-    prev_clk = clk;
     
     return ret;
 }
@@ -621,24 +632,349 @@ int VideoOut::get_vcount()
     return vcount;
 }
 
+// Set the frame hashing mode (FRAME_HASH_ON, FRAME_SKIP_DUP, FRAME_NO_BMP, FRAME_STOP_ERR)
+void VideoOut::set_hash_mode(int mode)
+{
+    // Skipping duplicates or checking only need the CRC
+    if (mode & (FRAME_SKIP_DUP | FRAME_NO_BMP)) mode |= FRAME_HASH_ON;
+    hash_mode = mode;
+}
+
+// Load the golden CRC list (one hexadecimal CRC per line)
+// Frames beyond the end of the list are mismatches
+int VideoOut::load_golden(const char *name)
+{
+    FILE *fh;
+    unsigned int crc;
+    
+    fh = fopen(name, "r");
+    if (!fh)
+    {
+        printf(" Cannot load golden CRC file \"%s\" !!!\n", name);
+        return -1;
+    }
+    golden_crc.clear();
+    while (fscanf(fh, "%x", &crc) == 1)
+    {
+        golden_crc.push_back((vluint32_t)crc);
+    }
+    fclose(fh);
+    printf(" %d golden CRC(s) loaded from file \"%s\"\n", (int)golden_crc.size(), name);
+    // Golden checking needs the CRC
+    hash_mode |= FRAME_HASH_ON;
+    
+    return 0;
+}
+
+// Log the frames' CRC (golden CRC file format)
+int VideoOut::open_hash_log(const char *name)
+{
+    if (hash_fh) fclose(hash_fh);
+    hash_fh = fopen(name, "w");
+    if (!hash_fh)
+    {
+        printf(" Cannot create CRC log file \"%s\" !!!\n", name);
+        return -1;
+    }
+    hash_mode |= FRAME_HASH_ON;
+    
+    return 0;
+}
+
+// CRC of the last completed frame
+vluint32_t VideoOut::get_frame_crc()
+{
+    return curr_crc;
+}
+
+// Number of frames not matching the golden CRC
+int VideoOut::get_crc_errors()
+{
+    return crc_errors;
+}
+
+// Install the per-line call-back
+void VideoOut::set_line_cback(line_cback_t cback, void *ctx)
+{
+    line_cb  = cback;
+    line_ctx = ctx;
+}
+
+// Install the frame begin/end call-backs
+// begin : first pixel of line 0, end : last line done and CRC checked
+void VideoOut::set_frame_cbacks(frame_cback_t beg_cback, frame_cback_t end_cback, void *ctx)
+{
+    frame_beg_cb = beg_cback;
+    frame_end_cb = end_cback;
+    frame_ctx    = ctx;
+}
+
+// Keep only "num" line buffers instead of a full frame (0 : full frame)
+// Lines are only available through the call-backs, BMP files are not saved
+int VideoOut::set_line_buffers(int num)
+{
+    // At least 2 lines for YUV420, no more than a frame
+    if ((num <= 0) || (num > ver_size)) num = ver_size;
+    if ((num < 2) && (ver_size >= 2)) num = 2;
+    
+    // Lines are not written to a file
+    if (map_ptr) unmap_frame(false);
+    map_on = false;
+    
+    free(frm_buf);
+    frm_buf = frame_alloc(row_size * num);
+    frm_hdr = frm_buf + FRM_ALIGN - BMP_HDR_SIZE;
+    memcpy(frm_hdr, &bfh, sizeof(BITMAPFILEHEADER));
+    memcpy(frm_hdr + sizeof(BITMAPFILEHEADER), &bih, sizeof(BITMAPINFOHEADER));
+    memset(frm_buf + FRM_ALIGN, 0, row_size * num);
+    set_rows(frm_buf + FRM_ALIGN, num);
+    if (num < ver_size)
+    {
+        printf(" Video capture with %d line buffers (no BMP files)\n", num);
+    }
+    
+    return num;
+}
+
+// Save the frames directly into mmap'd BMP files
+int VideoOut::set_mmap_mode(bool on)
+{
+    // Needs a full frame
+    if ((on) && (img_rows < ver_size)) return -1;
+    
+    if ((on) && (!map_on))
+    {
+        map_on = true;
+        if (map_frame()) return -1;
+    }
+    else if ((!on) && (map_on))
+    {
+        // Current frame is captured in memory again
+        if (map_ptr) unmap_frame(false);
+        map_on = false;
+        set_rows(frm_buf + FRM_ALIGN, ver_size);
+    }
+    
+    return 0;
+}
+
+// Publish the frames in a POSIX shared memory (name : "/xxx")
+int VideoOut::open_shm(const char *name)
+{
+    int fd;
+    void *ptr;
+    size_t buf_size;
+    
+    close_shm();
+    
+    // Header + 2 frame buffers
+    buf_size = ((size_t)row_size * ver_size + 4095) & ~(size_t)4095;
+    shm_size = VIDEO_SHM_HDR_LEN + 2 * buf_size;
+    
+    fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        printf(" Cannot create shared memory \"%s\" !!!\n", name);
+        return -1;
+    }
+    ptr = MAP_FAILED;
+    if (!ftruncate(fd, shm_size))
+    {
+        ptr = mmap(NULL, shm_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (ptr == MAP_FAILED)
+    {
+        printf(" Cannot map shared memory \"%s\" !!!\n", name);
+        shm_unlink(name);
+        return -1;
+    }
+    strncpy(shm_name, name, 255);
+    shm_name[255] = (char)0;
+    
+    // Header (pages are zero filled : seq = 0, no frame yet)
+    shm_ptr = (video_shm_t *)ptr;
+    shm_ptr->magic       = VIDEO_SHM_MAGIC;
+    shm_ptr->version     = VIDEO_SHM_VERSION;
+    shm_ptr->width       = (vluint32_t)hor_size;
+    shm_ptr->height      = (vluint32_t)ver_size;
+    shm_ptr->row_size    = (vluint32_t)row_size;
+    shm_ptr->buf_size    = (vluint32_t)row_size * ver_size;
+    shm_ptr->buf_offs[0] = (vluint32_t)VIDEO_SHM_HDR_LEN;
+    shm_ptr->buf_offs[1] = (vluint32_t)(VIDEO_SHM_HDR_LEN + buf_size);
+    shm_ptr->front       = (vluint32_t)0;
+    shm_back = (vluint8_t *)shm_ptr + shm_ptr->buf_offs[1];
+    printf(" Live frames published in shared memory \"%s\"\n", shm_name);
+    
+    return 0;
+}
+
+// Stop publishing the frames
+void VideoOut::close_shm()
+{
+    if (shm_ptr)
+    {
+        munmap((void *)shm_ptr, shm_size);
+        // Viewers keep their mapping
+        shm_unlink(shm_name);
+        shm_ptr  = (video_shm_t *)NULL;
+        shm_back = (vluint8_t *)NULL;
+    }
+}
+
+// Frame rows pointers : bottom-up order (full frame) or ring of lines
+void VideoOut::set_rows(vluint8_t *pix, int num)
+{
+    for (int i = 0; i < ver_size; i++)
+    {
+        if (num == ver_size)
+            img[i] = pix + (ver_size - 1 - i) * row_size;
+        else
+            img[i] = pix + (i % num) * row_size;
+    }
+    img_rows = num;
+    // Capture restarts from the first line
+    row_e = img[0];
+    row_o = img[(ver_size > 1) ? 1 : 0];
+}
+
+// Create and map the BMP file for the current frame
+int VideoOut::map_frame()
+{
+    int fd;
+    void *ptr;
+    
+    snprintf(map_name, sizeof(map_name), "%s_%04d.bmp", filename, dump_ctr);
+    fd = ::open(map_name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        printf(" Cannot create file \"%s\" !!!\n", map_name);
+        map_on = false;
+        set_rows(frm_buf + FRM_ALIGN, ver_size);
+        return -1;
+    }
+    ptr = MAP_FAILED;
+    if (!ftruncate(fd, bfh.bfSize))
+    {
+        ptr = mmap(NULL, bfh.bfSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (ptr == MAP_FAILED)
+    {
+        printf(" Cannot map file \"%s\" !!!\n", map_name);
+        unlink(map_name);
+        map_on = false;
+        set_rows(frm_buf + FRM_ALIGN, ver_size);
+        return -1;
+    }
+    // Headers are pre-filled, pixels are written in place
+    map_ptr = (vluint8_t *)ptr;
+    memcpy(map_ptr, frm_hdr, BMP_HDR_SIZE);
+    set_rows(map_ptr + BMP_HDR_SIZE, ver_size);
+    
+    return 0;
+}
+
+// Release the current BMP file
+void VideoOut::unmap_frame(bool keep)
+{
+    munmap(map_ptr, bfh.bfSize);
+    map_ptr = (vluint8_t *)NULL;
+    if (keep)
+    {
+        printf(" Save snapshot in file \"%s\"\n", map_name);
+    }
+    else
+    {
+        unlink(map_name);
+    }
+}
+
+// End of line : hash and stream
+inline void VideoOut::line_done(int line)
+{
+    const vluint8_t *pix = img[line];
+    
+    if (hash_mode & FRAME_HASH_ON) line_crc = crc32c_update(line_crc, pix, hor_size * 3);
+    if (line_cb) (*line_cb)(line_ctx, dump_ctr, line, pix, hor_size * 3);
+    if (shm_ptr) memcpy(shm_back + (ver_size - 1 - line) * row_size, pix, hor_size * 3);
+}
+
+// End of frame : hash, check and save
+void VideoOut::frame_done()
+{
+    bool save = ((hash_mode & FRAME_NO_BMP) || (img_rows < ver_size)) ? false : true;
+    
+    if (hash_mode & FRAME_HASH_ON)
+    {
+        prev_crc = curr_crc;
+        curr_crc = ~line_crc;
+        line_crc = (vluint32_t)0xFFFFFFFF;
+        
+        if (hash_fh) fprintf(hash_fh, "%08X\n", curr_crc);
+        
+        // Compare with the golden list
+        if (golden_crc.size()) crc_checks++;
+        if ((golden_crc.size()) &&
+            ((dump_ctr >= (int)golden_crc.size()) || (curr_crc != golden_crc[dump_ctr])))
+        {
+            printf("!!! FRAME CRC MISMATCH !!!\n");
+            if (dump_ctr < (int)golden_crc.size())
+                printf("Frame #%d : %08X, Golden : %08X\n", dump_ctr, curr_crc, golden_crc[dump_ctr]);
+            else
+                printf("Frame #%d : %08X, Golden : none (%d frames)\n", dump_ctr, curr_crc, (int)golden_crc.size());
+            crc_errors++;
+            // Keep the faulty frame for inspection
+            if (img_rows == ver_size) save = true;
+            // Fail fast
+            if (hash_mode & FRAME_STOP_ERR) Verilated::gotFinish(true);
+        }
+        // Unchanged frame
+        else if ((hash_mode & FRAME_SKIP_DUP) && (dump_ctr) && (curr_crc == prev_crc))
+        {
+            save = false;
+        }
+    }
+    if (frame_end_cb) (*frame_end_cb)(frame_ctx, dump_ctr);
+    if (shm_ptr)
+    {
+        vluint32_t back = shm_ptr->front ^ 1;
+        
+        // Publish the back buffer : sequence counter is odd during the update
+        __atomic_store_n(&shm_ptr->seq, shm_ptr->seq + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        shm_ptr->front = back;
+        shm_ptr->frame = (vluint32_t)dump_ctr;
+        shm_ptr->crc   = (hash_mode & FRAME_HASH_ON) ? curr_crc : (vluint32_t)0;
+        __atomic_store_n(&shm_ptr->seq, shm_ptr->seq + 1, __ATOMIC_RELEASE);
+        // Next frame goes to the other buffer
+        shm_back = (vluint8_t *)shm_ptr + shm_ptr->buf_offs[back ^ 1];
+    }
+    if (map_ptr)
+    {
+        // Frame is already in the file
+        unmap_frame(save);
+        dump_ctr++;
+        map_frame();
+    }
+    else
+    {
+        if (save) write_bmp();
+        dump_ctr++;
+    }
+}
+
 void VideoOut::write_bmp()
 {
     char tmp[264];
     FILE *fh;
     
     sprintf(tmp, "%s_%04d.bmp", filename, dump_ctr);
-    dump_ctr++;
     fh = fopen (tmp, "wb");
     if (fh)
     {
-        int y = ver_size;
-        
-        fwrite (&bfh, sizeof(BITMAPFILEHEADER), 1, fh);
-        fwrite (&bih, sizeof(BITMAPINFOHEADER), 1, fh);
-        while (y--)
-        {
-            fwrite (img[y], hor_size * 3, 1, fh);
-        }
+        // Headers and bottom-up pixels in one block
+        fwrite (frm_hdr, bfh.bfSize, 1, fh);
         fclose (fh);
         printf(" Save snapshot in file \"%s\"\n", tmp);
     }
@@ -648,7 +984,8 @@ void VideoOut::write_bmp()
     }
 }
 
-void VideoOut::yuv2rgb
+template <int DEPTH>
+inline void VideoOut::yuv2rgb
 (
     vluint8_t  lum,
     vluint8_t  cb,
@@ -656,6 +993,8 @@ void VideoOut::yuv2rgb
     vluint8_t *buf
 )
 {
+    const int bit_mask  = (1 << DEPTH) - 1;
+    const int bit_shift = 8 - DEPTH;
     int y, u, v;
     int r, g, b;
     
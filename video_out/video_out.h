@@ -24,17 +24,34 @@
 //  - HS/VS or DE based scanning
 //  - BMP files are saved on VS edge
 //  - Support for RGB444, YUV444, YUV422 and YUV420 colorspaces
+//  - Capture kernels specialized at compile time (sync, colorspace, depth)
+//  - Per-frame CRC32C, duplicate frames skipping and golden CRC checking
+//  - Per-line and per-frame call-backs, optional line buffers only mode
+//  - Contiguous bottom-up frame store, optional mmap'd BMP output files
+//  - Live frames published in a POSIX shared memory (see video_shm.h)
 
 #ifndef _VIDEO_OUT_H_
 #define _VIDEO_OUT_H_
 
 #include "verilated.h"
+#include "video_shm.h"
+#include <stdio.h>
+#include <vector>
 
 #define HS_POS_POL (1)
 #define HS_NEG_POL (0)
 #define VS_POS_POL (2)
 #define VS_NEG_POL (0)
 
+#define FRAME_HASH_ON  (1) // Compute a CRC32C per frame
+#define FRAME_SKIP_DUP (2) // Do not save frames identical to the previous one
+#define FRAME_NO_BMP   (4) // Do not save any frame (CRC checking only)
+#define FRAME_STOP_ERR (8) // Stop the simulation on the first golden CRC mismatch
+
+// Call-backs : user context, frame number, line number, pixels (BGR), size (bytes)
+typedef void (*line_cback_t)(void *ctx, int frame, int line, const vluint8_t *pix, int size);
+typedef void (*frame_cback_t)(void *ctx, int frame);
+
 class VideoOut
 {
     public:
@@ -51,6 +68,21 @@ class VideoOut
         bool eval_YUV420_DE(vluint8_t clk, vluint8_t de_y, vluint8_t de_c, vluint8_t luma, vluint8_t chroma);
         int  get_hcount();
         int  get_vcount();
+        // Frame hashing
+        void set_hash_mode(int mode);
+        int  load_golden(const char *name);
+        int  open_hash_log(const char *name);
+        vluint32_t get_frame_crc();
+        int  get_crc_errors();
+        // Streaming
+        void set_line_cback(line_cback_t cback, void *ctx);
+        void set_frame_cbacks(frame_cback_t beg_cback, frame_cback_t end_cback, void *ctx);
+        int  set_line_buffers(int num);
+        // Direct BMP output through mmap'd files
+        int  set_mmap_mode(bool on);
+        // Live frames in shared memory
+        int  open_shm(const char *name);
+        void close_shm();
     private:
         // BMP file format
         #pragma pack(push, 1)
@@ -77,8 +109,48 @@ class VideoOut
             vluint32_t biClrImportant;
         } BITMAPINFOHEADER;
         #pragma pack(pop)
-        void        write_bmp();
+        // Synchro modes
+        enum sync_t
+        {
+            SYNC_HV = 0,
+            SYNC_DE = 1
+        };
+        // Colorspaces
+        enum fmt_t
+        {
+            FMT_RGB444 = 0,
+            FMT_YUV444 = 1,
+            FMT_YUV422 = 2,
+            FMT_YUV420 = 3
+        };
+        // Capture kernel : (clk, vs/de/de_y, hs/de_c, comp0, comp1, comp2)
+        typedef bool (VideoOut::*eval_t)(vluint8_t, vluint8_t, vluint8_t, vluint8_t, vluint8_t, vluint8_t);
+        template <int SYNC, int FMT, int DEPTH, bool DBG>
+        bool        eval_core(vluint8_t clk, vluint8_t sync0, vluint8_t sync1, vluint8_t comp0, vluint8_t comp1, vluint8_t comp2);
+        template <int SYNC, int FMT, bool DBG>
+        eval_t      select_depth(int depth);
+        template <int SYNC, int FMT>
+        eval_t      select_eval(int depth, bool debug);
+        template <int FMT, int DEPTH>
+        void        put_pixel(vluint8_t comp0, vluint8_t comp1, vluint8_t comp2);
+        template <int DEPTH, bool DBG>
+        bool        grab_yuv420(vluint8_t de_y, vluint8_t de_c, vluint8_t luma, vluint8_t chroma);
+        template <int DEPTH>
         void        yuv2rgb(vluint8_t lum, vluint8_t cb, vluint8_t cr, vluint8_t *buf);
+        void        line_done(int line);
+        void        frame_done();
+        void        set_rows(vluint8_t *pix, int num);
+        int         map_frame();
+        void        unmap_frame(bool keep);
+        void        write_bmp();
+        // Capture kernels (selected by the constructor)
+        eval_t      eval_rgb444_hv;
+        eval_t      eval_rgb444_de;
+        eval_t      eval_yuv444_hv;
+        eval_t      eval_yuv444_de;
+        eval_t      eval_yuv422_hv;
+        eval_t      eval_yuv422_de;
+        eval_t      eval_yuv420_de;
         // YUV to RGB tables
         int         u_to_g[256];
         int         u_to_b[256];
@@ -96,9 +168,38 @@ class VideoOut
         vluint8_t  *row_e;
         vluint8_t  *row_o;
         vluint8_t **img;
+        int         img_rows; // Allocated rows (img[y] = img[y % img_rows])
+        int         row_size; // Row size in bytes (4-byte aligned)
+        // Frame store : headers + pixels (pixels are cache line aligned)
+        vluint8_t  *frm_buf;
+        vluint8_t  *frm_hdr;
+        // mmap'd BMP file
+        vluint8_t  *map_ptr;
+        char        map_name[272]; // filename + "_%04d.bmp" (any frame number)
+        bool        map_on;
+        // Shared memory framebuffer
+        video_shm_t *shm_ptr;
+        vluint8_t  *shm_back;
+        size_t      shm_size;
+        char        shm_name[256];
+        // Streaming call-backs
+        line_cback_t  line_cb;
+        frame_cback_t frame_beg_cb;
+        frame_cback_t frame_end_cb;
+        void       *line_ctx;
+        void       *frame_ctx;
         // BMP file name
         char        filename[256];
         int         dump_ctr;
+        // Frame hashing
+        int         hash_mode;
+        vluint32_t  line_crc;
+        vluint32_t  curr_crc;
+        vluint32_t  prev_crc;
+        int         crc_errors;
+        int         crc_checks;
+        std::vector<vluint32_t> golden_crc;
+        FILE       *hash_fh;
         // Image format
         int         hor_offs;
         int         ver_offs;
@@ -111,9 +212,8 @@ class VideoOut
         int         hcount2;
         int         vcount1;
         int         vcount2;
-        // Color depth
-        int         bit_shift;
-        vluint8_t   bit_mask;
+        // Color depth (1 - 8 bits)
+        int         bit_depth;
         // Previous signal state
         vluint8_t   prev_clk;
         vluint8_t   prev_hs;
@@ -0,0 +1,79 @@
+// Copyright 2013-2022 Frederic Requin
+//
+// License: BSD
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//   - Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//   - Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer
+//     in the documentation and/or other materials provided with the
+//     distribution.
+//   - Neither the name of the author nor the names of its contributors
+//     may be used to endorse or promote products derived from this
+//     software without specific prior written permission.
+//
+// Video output shared memory:
+// ---------------------------
+//  - Layout of the POSIX shared memory framebuffer published by VideoOut
+//  - Header followed by two frame buffers (24-bit BGR, bottom-up, BMP rows)
+//  - Protected by a sequence counter : the producer never waits
+//  - Does not depend on Verilator, to be included by a viewer process
+
+#ifndef _VIDEO_SHM_H_
+#define _VIDEO_SHM_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#define VIDEO_SHM_MAGIC   (0x54554F56) // "VOUT"
+#define VIDEO_SHM_VERSION (1)
+#define VIDEO_SHM_HDR_LEN (4096)       // Frame buffers are page aligned
+
+typedef struct
+{
+    uint32_t magic;       // VIDEO_SHM_MAGIC
+    uint32_t version;     // VIDEO_SHM_VERSION
+    uint32_t width;       // Active width (pixels)
+    uint32_t height;      // Active height (lines)
+    uint32_t row_size;    // Row size (bytes, 4-byte aligned)
+    uint32_t buf_size;    // Frame buffer size (bytes)
+    uint32_t buf_offs[2]; // Frame buffers offsets (from the header)
+    uint32_t seq;         // Sequence counter (odd : update in progress)
+    uint32_t front;       // Last completed frame buffer (0 or 1)
+    uint32_t frame;       // Last completed frame number
+    uint32_t crc;         // Last completed frame CRC32C (0 : not computed)
+} video_shm_t;
+
+// Copy the last completed frame (buf_size bytes) into "dst"
+// Returns the frame number, or -1 if no frame was published yet
+static inline int video_shm_read(const video_shm_t *shm, uint8_t *dst)
+{
+    uint32_t seq1, seq2, front, frame;
+
+    do
+    {
+        // Wait for the end of an update
+        do
+        {
+            seq1 = __atomic_load_n(&shm->seq, __ATOMIC_ACQUIRE);
+        }
+        while (seq1 & 1);
+        if (!seq1) return -1;
+
+        front = shm->front;
+        frame = shm->frame;
+        memcpy(dst, (const uint8_t *)shm + shm->buf_offs[front], shm->buf_size);
+
+        // Buffer was recycled while being copied : retry
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        seq2 = __atomic_load_n(&shm->seq, __ATOMIC_RELAXED);
+    }
+    while (seq1 != seq2);
+
+    return (int)frame;
+}
+
+#endif /* _VIDEO_SHM_H_ */